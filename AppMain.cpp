@@ -1,38 +1,185 @@
 #include "AppMain.h"
 #include "FrameMain.h"
 #include "Resources.h"
+#include "Batch.h"
 #include "wx/cmdline.h"
 #include <wx/image.h>
+#include <wx/init.h>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
 
-wxIMPLEMENT_APP(AppMain);
+wxIMPLEMENT_APP_NO_MAIN(AppMain);
 
 namespace {
+    //As close to the start of the process as static initialisation gets, for --startup-time
+    const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+    void describe(wxCmdLineParser& parser);
+    batch::Options batchOptions(const wxCmdLineParser& parser);
+    int runBatch(const batch::Options& options, const wxCmdLineParser& parser);
     void initWindows();
     void cleanupWindows();
+    void attachConsole();
+}
+
+//The tools that draw nothing run here under wxBase alone, before any GUI is set up, so they work with no display.
+//Everything else, PNG export included, goes on to AppMain.
+int main(int argc, char** argv) {
+    {
+        wxApp::SetInstance(new wxAppConsole{});
+        wxInitializer initializer{argc, argv};
+        if(!initializer.IsOk()) return 1;
+        wxAppConsole* app = wxAppConsole::GetInstance();
+        wxCmdLineParser parser{app->argc, app->argv};
+        describe(parser);
+        if(int parsed = parser.Parse(); parsed != 0) return parsed == -1 ? 0 : 1; //-1 after --help
+        batch::Options options = batchOptions(parser);
+        if(parser.Found("mesh-times")) {
+            attachConsole();
+            double tolerance = IterativeSolver::Options{}.tolerance;
+            if(parser.Found("tolerance", &tolerance) && !(tolerance > 0 && tolerance < 1)) {
+                std::cerr << "--tolerance takes a number between 0 and 1" << std::endl;
+                return 2;
+            }
+            return batch::meshTimes(options.jobs, tolerance);
+        }
+        if(batch::wanted(options) && options.imageFormat != "png") {
+            attachConsole();
+            return runBatch(options, parser);
+        }
+    }
+    return wxEntry(argc, argv);
 }
 
 bool AppMain::OnInit() {
     wxInitAllImageHandlers();
-    initWindows();
     wxCmdLineParser parser{argc, argv};
-    parser.AddParam("File", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL);
-    parser.Parse();
+    describe(parser);
+    if(parser.Parse() != 0) return false;
+
+    //PNG export draws with wx, so it needs the GUI and a display but still opens no frame and registers nothing
+    batch::Options options = batchOptions(parser);
+    if(batch::wanted(options)) {
+        attachConsole();
+        headless = true;
+        exitCode = runBatch(options, parser);
+        return true;
+    }
+
+    initWindows();
     FrameMain* frame; //Note: wxWidgets takes care of deleting classes descending from wxWindow and wxSizer.
-    if(parser.GetParamCount() == 1) {
+    if(parser.GetParamCount() >= 1) {
         frame = new FrameMain(parser.GetParam(0).ToStdWstring());
     } else {
         frame = new FrameMain();
     }
     frame->Show(true);
+    if(parser.Found("startup-time")) {
+        attachConsole();
+        auto milliseconds = [] {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart).count();
+        };
+        double shown = milliseconds();
+        //The first paint comes with the events queued by showing the frame, and idle events follow until it has
+        Bind(wxEVT_IDLE, [frame, shown, milliseconds, done = false](wxIdleEvent& event) mutable {
+            if(done) return;
+            if(frame->framesDrawn() == 0) {
+                event.RequestMore();
+                return;
+            }
+            done = true;
+            std::cout << std::fixed << std::setprecision(1) << "shown " << shown << " ms, first paint " << milliseconds() << " ms, glyphs drawn "
+                      << resources::cachedBytes() / 1024.0 << " KiB" << std::endl;
+            frame->Destroy();
+        });
+    }
+    wxString value;
+    if(parser.Found("replay", &value)) {
+        //Once the frame is up, play the log, print the timings and quit
+        attachConsole();
+        std::filesystem::path log = value.ToStdWstring();
+        WindowGrid::Renderer renderer = WindowGrid::Renderer::batched;
+        if(parser.Found("renderer", &value)) {
+            if(value == "per-cell") renderer = WindowGrid::Renderer::per_cell;
+            else if(value == "software") renderer = WindowGrid::Renderer::software;
+        }
+        frame->CallAfter([this, frame, log, renderer] {
+            try {
+                std::cout << frame->replay(input::Log::load(log), renderer) << std::flush;
+            } catch(std::runtime_error& e) {
+                std::cerr << e.what() << std::endl;
+                exitCode = 1;
+            }
+            frame->Destroy();
+        });
+    }
     return true;
 }
 
+int AppMain::OnRun() {
+    if(headless) return exitCode;
+    int code = wxApp::OnRun();
+    return exitCode != 0 ? exitCode : code;
+}
+
 int AppMain::OnExit() {
-    cleanupWindows();
+    if(!headless) cleanupWindows();
     return 0;
 }
 
 namespace {
+    void describe(wxCmdLineParser& parser) {
+        parser.AddOption("", "export", "Write an image of each file, png or svg");
+        parser.AddOption("", "cell-size", "Pixels per cell in exported images, 32 by default", wxCMD_LINE_VAL_NUMBER);
+        parser.AddSwitch("", "netlist", "Write a SPICE netlist of each file");
+        parser.AddSwitch("", "stats", "Print the size and contents of each file");
+        parser.AddSwitch("", "memory", "Print the memory each file takes once loaded");
+        parser.AddSwitch("", "convert", "Save each file again in the current format");
+        parser.AddSwitch("", "load-times", "Print how long each file takes to load on 1, 2, 4... threads");
+        parser.AddSwitch("", "sweep-times", "Print how long a 1000 point sweep of each file takes on 1, 2, 4... threads");
+        parser.AddSwitch("", "item-layout", "Compare the memory and paint pass time of each file's items packed and unpacked");
+        parser.AddSwitch("", "mesh-times", "Print how long resistor meshes of growing size take each solver, then quit");
+        parser.AddOption("", "tolerance", "With --mesh-times, the residual conjugate gradient stops at, 1e-10 by default", wxCMD_LINE_VAL_DOUBLE);
+        parser.AddOption("", "diff", "Count the cells each file adds, removes and changes since this one");
+        parser.AddOption("", "out", "Directory to write to instead of next to each file");
+        parser.AddOption("", "replay", "Play back an input log against the file and print how long the editor took", wxCMD_LINE_VAL_STRING);
+        parser.AddOption("", "renderer", "With --replay, draw the grid with per-cell, batched (the default) or software", wxCMD_LINE_VAL_STRING);
+        parser.AddSwitch("", "startup-time", "Open the editor, print how long it took to show and first paint, then quit");
+        parser.AddOption("", "jobs", "Files to process at once, one per core by default", wxCMD_LINE_VAL_NUMBER);
+        parser.AddParam("File", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL | wxCMD_LINE_PARAM_MULTIPLE);
+    }
+
+    batch::Options batchOptions(const wxCmdLineParser& parser) {
+        batch::Options options{};
+        wxString value;
+        long number;
+        if(parser.Found("export", &value)) options.imageFormat = value.Lower().ToStdString();
+        if(parser.Found("cell-size", &number)) options.cellSize = static_cast<int>(number);
+        if(parser.Found("out", &value)) options.outputDirectory = value.ToStdWstring();
+        if(parser.Found("diff", &value)) options.diffBase = value.ToStdWstring();
+        if(parser.Found("jobs", &number) && number > 0) options.jobs = static_cast<unsigned>(number);
+        options.netlist = parser.Found("netlist");
+        options.stats = parser.Found("stats");
+        options.memory = parser.Found("memory");
+        options.convert = parser.Found("convert");
+        options.loadTimes = parser.Found("load-times");
+        options.sweepTimes = parser.Found("sweep-times");
+        options.itemLayout = parser.Found("item-layout");
+        return options;
+    }
+
+    int runBatch(const batch::Options& options, const wxCmdLineParser& parser) {
+        if(!options.imageFormat.empty() && options.imageFormat != "png" && options.imageFormat != "svg") {
+            std::cerr << "--export takes png or svg" << std::endl;
+            return 2;
+        }
+        std::vector<std::filesystem::path> inputs{};
+        for(size_t i = 0; i < parser.GetParamCount(); i ++) {
+            inputs.emplace_back(parser.GetParam(i).ToStdWstring());
+        }
+        return batch::run(options, inputs);
+    }
+
 #ifdef _WIN32
 #include <ShlObj_core.h>
     void initWindows() {
@@ -43,12 +190,9 @@ namespace {
         std::wstring pathStr = path.generic_wstring();
         //Despite almost everything in windows allowing both / and \, this particular case ONLY allows \. Took me way too long to figure out.
         std::replace(pathStr.begin(), pathStr.end(), L'/', L'\\');
-        std::filesystem::current_path(path.parent_path());
         std::filesystem::path name = path.filename();
         std::wstring pathWithArg = std::wstring{L"\""} + pathStr + L"\" \"%1\"";
-        std::filesystem::path icoPath{path.parent_path() / "res/resistor-multires.ico"};
-        std::wstring icoPathStr = icoPath.generic_wstring();
-        std::replace(icoPathStr.begin(), icoPathStr.end(), L'/', L'\\');
+        std::wstring icoPathStr = pathStr + L",0"; //the icon schematic.rc compiles in
         //Register app and file type
         RegSetKeyValueW(HKEY_CURRENT_USER, L"Software\\Classes\\Schematic.app", nullptr, REG_SZ, reinterpret_cast<const BYTE *>(L"Schematic"), 20);
         RegSetKeyValueW(HKEY_CURRENT_USER, L"Software\\Classes\\Schematic.app\\shell\\open\\command", nullptr, REG_SZ,reinterpret_cast<const BYTE *>(pathWithArg.c_str()), pathWithArg.size() * 2 + 2);
@@ -93,7 +237,7 @@ namespace {
         IShellLinkW* shortcut;
         if(CoCreateInstance(CLSID_ShellLink, nullptr, CLSCTX_INPROC_SERVER, IID_IShellLinkW, reinterpret_cast<LPVOID *>(&shortcut)) != 0) return;
         shortcut->SetDescription(L"Electrical schematic editor");
-        shortcut->SetIconLocation(icoPathStr.c_str(), 0);
+        shortcut->SetIconLocation(pathStr.c_str(), 0);
         shortcut->SetPath(pathStr.c_str());
         IPersistFile* shortcutFile;
         if(shortcut->QueryInterface(IID_IPersistFile, reinterpret_cast<LPVOID *>(&shortcutFile)) == 0) {
@@ -105,8 +249,17 @@ namespace {
     void cleanupWindows() {
         CoUninitialize();
     }
+    //The app is built for the windows subsystem, so it has no console unless it borrows the one it was started from
+    void attachConsole() {
+        if(AttachConsole(ATTACH_PARENT_PROCESS)) {
+            FILE* stream;
+            freopen_s(&stream, "CONOUT$", "w", stdout);
+            freopen_s(&stream, "CONOUT$", "w", stderr);
+        }
+    }
 #else
     void initWindows() {}
     void cleanupWindows() {}
+    void attachConsole() {}
 #endif
 }
\ No newline at end of file
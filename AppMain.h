@@ -4,5 +4,9 @@
 class AppMain : public wxApp {
 public:
     bool OnInit() override;
+    int OnRun() override;
     int OnExit() override;
+private:
+    bool headless{false}; //running a command line tool instead of the editor
+    int exitCode{0};
 };
\ No newline at end of file
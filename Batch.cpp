@@ -0,0 +1,504 @@
+#include "Batch.h"
+#include "WindowGrid.h"
+#include "Netlist.h"
+#include "Components.h"
+#include "SpiceExport.h"
+#include "ImageExport.h"
+#include "ThreadPool.h"
+#include "Sweep.h"
+#include "IterativeSolver.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <bit>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    std::filesystem::path outputPath(const batch::Options& options, const std::filesystem::path& input, const char* extension) {
+        std::filesystem::path path = options.outputDirectory.empty() ? input : options.outputDirectory / input.filename();
+        return path.replace_extension(extension);
+    }
+
+    std::ofstream openOutput(const std::filesystem::path& path) {
+        std::ofstream ofstream{path, std::ios_base::binary};
+        if(ofstream.fail()) {
+            throw std::runtime_error{"Could not write " + path.string()};
+        }
+        return ofstream;
+    }
+
+    WindowGrid::LoadStruct loadFile(const std::filesystem::path& input, unsigned threads) {
+        std::ifstream ifstream{input, std::ios_base::binary};
+        if(ifstream.fail()) {
+            throw std::runtime_error{"Could not open file"};
+        }
+        return WindowGrid::load(ifstream, threads);
+    }
+
+    //Best of three loads on each thread count, in milliseconds
+    std::string loadTimes(const std::filesystem::path& input, unsigned maxThreads) {
+        std::ostringstream line{};
+        line << " load ms by threads";
+        for(unsigned threads = 1;; threads = std::min(2 * threads, maxThreads)) {
+            double best = 0;
+            for(int i = 0; i < 3; i ++) {
+                auto start = std::chrono::steady_clock::now();
+                loadFile(input, threads);
+                std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+                best = i == 0 ? time.count() : std::min(best, time.count());
+            }
+            line << ' ' << threads << ':' << std::fixed << std::setprecision(1) << best << std::defaultfloat;
+            if(threads == maxThreads) break;
+        }
+        return line.str();
+    }
+
+    //Best of three sweeps of the first element's value, from half to one and a half times what it is, on each thread
+    //count, in milliseconds. The symbolic analysis every point shares is done once, outside the times.
+    std::string sweepTimes(const Grid& grid, unsigned maxThreads) {
+        constexpr size_t POINTS = 1000;
+        Netlist netlist{grid};
+        if(netlist.elements.empty()) return " nothing to sweep";
+        double value = netlist.elements[0].value;
+        std::vector<Sweep::Point> points{};
+        for(size_t i = 0; i < POINTS; i ++) {
+            points.push_back({{0, value * (0.5 + static_cast<double>(i) / POINTS)}});
+        }
+        Sweep sweep{netlist, std::move(points)};
+        std::ostringstream line{};
+        line << " sweep of " << POINTS << " points ms by threads";
+        for(unsigned threads = 1;; threads = std::min(2 * threads, maxThreads)) {
+            ThreadPool pool{threads};
+            double best = 0;
+            for(int i = 0; i < 3; i ++) {
+                auto start = std::chrono::steady_clock::now();
+                sweep.run(pool);
+                std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+                best = i == 0 ? time.count() : std::min(best, time.count());
+            }
+            line << ' ' << threads << ':' << std::fixed << std::setprecision(1) << best << std::defaultfloat;
+            if(threads == maxThreads) break;
+        }
+        return line.str();
+    }
+
+    //n x n junctions joined by 1k resistors, with a 5V source from the top left junction to ground at the bottom right.
+    //The junctions start a column in, leaving the first for the source and its ground.
+    Grid mesh(uint32_t n) {
+        Grid grid{2 * n, 2 * n - 1};
+        Block block{2, 2, {
+                {0, Item{Item::ItemType::wire, Item::UP | Item::DOWN | Item::LEFT | Item::RIGHT, 0}},
+                {1, Item{Item::ItemType::resistor, Item::HORIZONTAL, 1000}},
+                {static_cast<uint64_t>(1) << 32, Item{Item::ItemType::resistor, Item::VERTICAL, 1000}}
+        }};
+        std::vector<std::pair<uint64_t, Item>> cells{block.cells.begin(), block.cells.end()};
+        for(auto& cell : cells) {
+            cell.first += 1;
+        }
+        cells.emplace_back(0, Item{Item::ItemType::wire, Item::RIGHT | Item::DOWN, 0});
+        cells.emplace_back(static_cast<uint64_t>(1) << 32, Item{Item::ItemType::volt_source, Item::UP, 5});
+        cells.emplace_back(static_cast<uint64_t>(2) << 32, Item{Item::ItemType::wire, Item::UP, 0, L"GND"});
+        grid.apply(std::move(cells));
+        //Copies running off the right and bottom are clipped, so the last junctions have no resistors hanging off them
+        grid.replicate(block, 0, 1, n, n, 2, 2);
+        grid.set(2 * n - 2, 2 * n - 1, Item{Item::ItemType::wire, Item::UP | Item::DOWN | Item::LEFT | Item::RIGHT, 0, L"GND"});
+        return grid;
+    }
+
+    //Best of three runs of solve, in milliseconds
+    template<typename Solve>
+    double bestTime(Solve solve) {
+        double best = 0;
+        for(int i = 0; i < 3; i ++) {
+            auto start = std::chrono::steady_clock::now();
+            solve();
+            std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+            best = i == 0 ? time.count() : std::min(best, time.count());
+        }
+        return best;
+    }
+
+    //Item as it was before it was packed into 12 bytes, for --item-layout to compare with
+    struct UnpackedItem {
+        Item::ItemType type;
+        int shape;
+        double value;
+        std::wstring extraData;
+    };
+
+    //An 8x8 tile of cells as GridVersion keeps them, items in bit order
+    template<typename T>
+    struct LayoutTile {
+        uint64_t occupied{0};
+        std::vector<T> items{};
+    };
+    template<typename T>
+    using LayoutTiles = std::unordered_map<uint64_t, LayoutTile<T>>; //by the key of the top left cell
+
+    template<typename T, typename Convert>
+    LayoutTiles<T> layoutTiles(const std::vector<std::pair<uint64_t, const Item*>>& cells, Convert convert) {
+        LayoutTiles<T> tiles{};
+        for(const auto& [key, item] : cells) {
+            LayoutTile<T>& tile = tiles[key & ~((static_cast<uint64_t>(7) << 32) | 7)];
+            tile.occupied |= static_cast<uint64_t>(1) << (((key >> 32) & 7) * 8 + (key & 7));
+            tile.items.push_back(convert(*item));
+        }
+        return tiles;
+    }
+
+    //Hardware cache misses of the calling thread from construction, where the platform lets them be counted
+    class CacheMisses {
+    public:
+        CacheMisses() {
+#ifdef __linux__
+            perf_event_attr attributes{};
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.size = sizeof(attributes);
+            attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            descriptor = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+            if(descriptor != -1) ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+#endif
+        }
+        ~CacheMisses() {
+#ifdef __linux__
+            if(descriptor != -1) close(descriptor);
+#endif
+        }
+        CacheMisses(const CacheMisses&) = delete;
+        CacheMisses& operator=(const CacheMisses&) = delete;
+        //-1 if they are not being counted
+        int64_t read() const {
+            int64_t count = -1;
+#ifdef __linux__
+            if(descriptor != -1 && ::read(descriptor, &count, sizeof(count)) != sizeof(count)) count = -1;
+#endif
+            return count;
+        }
+    private:
+        int descriptor{-1};
+    };
+
+    //Reads what drawing reads of each occupied cell of the window, a row at a time and a tile at a time along it, as
+    //the paint loop looks cells up. Returns the best of three times in milliseconds and the fewest cache misses.
+    template<typename T>
+    std::pair<double, int64_t> paintPass(const LayoutTiles<T>& tiles, uint64_t top, uint64_t left, uint64_t rows, uint64_t cols, uint64_t& checksum) {
+        double best = 0;
+        int64_t fewest = -1;
+        for(int i = 0; i < 3; i ++) {
+            auto start = std::chrono::steady_clock::now();
+            CacheMisses misses{};
+            for(uint64_t row = top; row < top + rows; row ++) {
+                for(uint64_t tileCol = left & ~static_cast<uint64_t>(7); tileCol < left + cols; tileCol += 8) {
+                    auto tile = tiles.find(((row & ~static_cast<uint64_t>(7)) << 32) | tileCol);
+                    if(tile == tiles.end()) continue;
+                    uint64_t occupied = tile->second.occupied >> ((row & 7) * 8);
+                    for(uint64_t col = 0; col < 8; col ++) {
+                        if(!((occupied >> col) & 1)) continue;
+                        const T& item = tile->second.items[std::popcount(tile->second.occupied & ((static_cast<uint64_t>(1) << ((row & 7) * 8 + col)) - 1))];
+                        checksum += static_cast<uint64_t>(item.type) + item.shape + std::bit_cast<uint64_t>(static_cast<double>(item.value)) + item.extraData.empty();
+                    }
+                }
+            }
+            int64_t missed = misses.read();
+            std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+            best = i == 0 ? time.count() : std::min(best, time.count());
+            if(missed != -1) fewest = fewest == -1 ? missed : std::min(fewest, missed);
+        }
+        return {best, fewest};
+    }
+
+    //Bytes per occupied cell of the items alone, tiles and index aside, packed and unpacked, and the time and cache
+    //misses of a paint pass over them. The pass covers at most 4096 x 4096 cells from the top left occupied corner.
+    std::string itemLayout(const Grid& grid) {
+        std::vector<std::pair<uint64_t, const Item*>> cells{};
+        uint64_t top = UINT32_MAX, left = UINT32_MAX, bottom = 0, right = 0;
+        for(const auto& [key, item] : grid.gridMap) {
+            cells.emplace_back(key, &item);
+            top = std::min(top, key >> 32);
+            left = std::min(left, key & UINT32_MAX);
+            bottom = std::max(bottom, (key >> 32) + 1);
+            right = std::max(right, (key & UINT32_MAX) + 1);
+        }
+        if(cells.empty()) return " no items";
+        //Items of a tile go in bit order, which is key order within it
+        auto tileOf = [](uint64_t key) {return key & ~((static_cast<uint64_t>(7) << 32) | 7);};
+        std::sort(cells.begin(), cells.end(), [&tileOf](const auto& a, const auto& b) {
+            return tileOf(a.first) != tileOf(b.first) ? tileOf(a.first) < tileOf(b.first) : a.first < b.first;
+        });
+        LayoutTiles<Item> packed = layoutTiles<Item>(cells, [](const Item& item) {return item;});
+        LayoutTiles<UnpackedItem> unpacked = layoutTiles<UnpackedItem>(cells, [](const Item& item) {
+            return UnpackedItem{item.type, item.shape, item.value, item.extraData};
+        });
+        size_t tables = 0;
+        std::unordered_set<uint64_t> entries{};
+        for(const auto& [key, item] : cells) {
+            tables += item->tableBytes(entries);
+        }
+        size_t text = 0;
+        for(const auto& pair : unpacked) {
+            for(const UnpackedItem& item : pair.second.items) {
+                text += memory::heapBytes(item.extraData);
+            }
+        }
+        uint64_t rows = std::min<uint64_t>(bottom - top, 4096);
+        uint64_t cols = std::min<uint64_t>(right - left, 4096);
+        uint64_t checksum = 0;
+        auto [packedTime, packedMisses] = paintPass(packed, top, left, rows, cols, checksum);
+        auto [unpackedTime, unpackedMisses] = paintPass(unpacked, top, left, rows, cols, checksum);
+        auto perCell = [&cells](size_t bytes) {return static_cast<double>(bytes) / static_cast<double>(cells.size());};
+        auto missed = [](int64_t misses) {return misses == -1 ? std::string{"misses not counted"} : std::to_string(misses) + " cache misses";};
+        std::ostringstream line{};
+        line << std::fixed << std::setprecision(1) << " items packed " << sizeof(Item) << " + " << perCell(tables) << " bytes per cell, unpacked "
+             << sizeof(UnpackedItem) << " + " << perCell(text) << "; paint pass over " << rows << 'x' << cols << " cells packed " << packedTime << " ms ("
+             << missed(packedMisses) << "), unpacked " << unpackedTime << " ms (" << missed(unpackedMisses) << ')' << std::defaultfloat;
+        if(checksum == 1) line << ' '; //keeps the passes from being optimised away
+        return line.str();
+    }
+
+    //A file's line so far, and the file itself if its PNG is still to be drawn. PNGs are drawn with wx, which is only safe
+    //on the main thread, so workers hand them over rather than drawing them.
+    struct Processed {
+        std::string line;
+        std::unique_ptr<WindowGrid::LoadStruct> image;
+    };
+
+    void writePng(const batch::Options& options, const std::filesystem::path& input, const WindowGrid::LoadStruct& load, ThreadPool& pool) {
+        std::ofstream ofstream = openOutput(outputPath(options, input, ".png"));
+        ImageExport image{load.grid, ImageExport::Options{options.cellSize, load.dotSize, load.rotatedText, load.shadedBackground}};
+        image.writePng(ofstream, pool);
+    }
+
+    Processed process(const batch::Options& options, const std::filesystem::path& input, unsigned threads, const Grid* base) {
+        WindowGrid::LoadStruct load = loadFile(input, threads);
+        const Grid& grid = load.grid;
+        std::ostringstream line{};
+        line << input.string() << ':';
+        if(options.stats) {
+            size_t counts[256]{};
+            for(const auto& pair : grid.gridMap) {
+                counts[static_cast<uint8_t>(pair.second.type)] ++;
+            }
+            Netlist netlist{grid};
+            line << ' ' << grid.getWidth() << 'x' << grid.getHeight() << " cells, " << grid.gridMap.size() << " items ("
+                 << counts[static_cast<int>(Item::ItemType::wire)] << " wires, ";
+            for(const components::Component& part : components::all()) {
+                line << counts[static_cast<int>(part.type)] << ' ' << wxString{part.plural}.utf8_string() << ", ";
+            }
+            line << counts[static_cast<int>(Item::ItemType::instance)] << " instances of " << grid.subCircuits.size() << " sub-circuits), "
+                 << netlist.elements.size() << " elements, " << netlist.nodeCount() << " nodes";
+        }
+        if(options.memory) {
+            memory::Report report = grid.memoryUsage();
+            auto mebibytes = [](size_t bytes) {return bytes / 1048576.0;};
+            line << std::fixed << std::setprecision(2) << " memory " << mebibytes(report.total()) << " MiB (cells "
+                 << mebibytes(report.cells) << ", labels " << mebibytes(report.labels) << ", index " << mebibytes(report.index)
+                 << ", undo " << mebibytes(report.undo) << ", sub-circuits " << mebibytes(report.subCircuits) << "), "
+                 << std::setprecision(1) << report.bytesPerCell() << " bytes per cell" << std::defaultfloat;
+        }
+        if(base) {
+            //Both were loaded by this process, so their digests compare and only tiles that differ are looked in
+            size_t counts[3]{};
+            base->gridMap.diff(grid.gridMap, [&counts](uint64_t key, const Item* before, const Item* after) {
+                counts[before == nullptr ? 0 : after == nullptr ? 1 : 2] ++;
+            });
+            if(counts[0] + counts[1] + counts[2] == 0) {
+                line << " same cells as " << options.diffBase.filename().string();
+            } else {
+                line << ' ' << counts[0] << " cells added, " << counts[1] << " removed and " << counts[2] << " changed since " << options.diffBase.filename().string();
+            }
+        }
+        if(options.netlist) {
+            std::ofstream ofstream = openOutput(outputPath(options, input, ".cir"));
+            spice::write(ofstream, Netlist{grid}, "* " + input.stem().string());
+            if(!ofstream.flush()) {
+                throw std::runtime_error{"Could not write netlist"};
+            }
+            line << " netlist written";
+        }
+        if(options.imageFormat == "svg") {
+            std::ofstream ofstream = openOutput(outputPath(options, input, ".svg"));
+            ImageExport image{grid, ImageExport::Options{options.cellSize, load.dotSize, load.rotatedText, load.shadedBackground}};
+            image.writeSvg(ofstream);
+            line << " svg written";
+        }
+        if(options.convert) {
+            //Written beside the target first, so a failure never leaves a half written schematic
+            std::filesystem::path target = outputPath(options, input, ".schematic");
+            std::filesystem::path temporary = target;
+            temporary += ".tmp";
+            {
+                std::ofstream ofstream = openOutput(temporary);
+                WindowGrid::save(ofstream, grid, load.zoom, load.xScroll, load.yScroll, load.dotSize, load.rotatedText, load.shadedBackground);
+                if(!ofstream.flush()) {
+                    throw std::runtime_error{"Could not write schematic"};
+                }
+            }
+            std::filesystem::rename(temporary, target);
+            line << " converted";
+        }
+        if(options.loadTimes) {
+            line << loadTimes(input, threads);
+        }
+        if(options.sweepTimes) {
+            line << sweepTimes(grid, threads);
+        }
+        if(options.itemLayout) {
+            line << itemLayout(grid);
+        }
+        Processed processed{line.str(), nullptr};
+        if(options.imageFormat == "png") processed.image = std::make_unique<WindowGrid::LoadStruct>(std::move(load));
+        return processed;
+    }
+}
+
+bool batch::wanted(const Options& options) {
+    return !options.imageFormat.empty() || options.netlist || options.stats || options.memory || options.convert || options.loadTimes ||
+           options.sweepTimes || options.itemLayout || !options.diffBase.empty();
+}
+
+int batch::run(const Options& options, const std::vector<std::filesystem::path>& inputs) {
+    std::vector<std::filesystem::path> files{};
+    for(const auto& input : inputs) {
+        std::error_code error{};
+        if(std::filesystem::is_directory(input, error)) {
+            for(const auto& entry : std::filesystem::recursive_directory_iterator{input, error}) {
+                if(entry.is_regular_file() && entry.path().extension() == ".schematic") files.push_back(entry.path());
+            }
+        } else {
+            files.push_back(input);
+        }
+    }
+    if(files.empty()) {
+        std::cerr << "No schematic files given" << std::endl;
+        return 2;
+    }
+    if(!options.outputDirectory.empty()) {
+        std::filesystem::create_directories(options.outputDirectory);
+    }
+    std::unique_ptr<Grid> base{};
+    if(!options.diffBase.empty()) {
+        try {
+            base = std::make_unique<Grid>(loadFile(options.diffBase, std::max(1u, options.jobs)).grid);
+        } catch(std::exception& e) {
+            std::cerr << options.diffBase.string() << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    //Files are the unit of parallelism. With fewer files than cores, what is left over goes to loading and drawing
+    //images. Timings are taken a file at a time, so every thread count has the cores to itself.
+    auto start = std::chrono::steady_clock::now();
+    unsigned jobs = options.loadTimes || options.sweepTimes || options.itemLayout ? 1 : std::max(1u, std::min<unsigned>(options.jobs, static_cast<unsigned>(files.size())));
+    unsigned threads = std::max(1u, options.jobs / jobs);
+    //Guards the output and the hand over of PNGs to this thread, which draws them while the workers go on with other files
+    std::mutex mutex{};
+    std::condition_variable changed{};
+    std::deque<std::pair<std::filesystem::path, Processed>> images{};
+    size_t done = 0;
+    size_t failed = 0;
+    ThreadPool pool{jobs};
+    for(const auto& file : files) {
+        pool.submit([&, file] {
+            try {
+                Processed processed = process(options, file, threads, base.get());
+                std::unique_lock lock{mutex};
+                if(processed.image) {
+                    //At most a file per worker waits, so loaded files do not pile up behind slow images
+                    changed.wait(lock, [&] {return images.size() < jobs;});
+                    images.emplace_back(file, std::move(processed));
+                } else {
+                    std::cout << processed.line << std::endl;
+                    done ++;
+                }
+            } catch(std::exception& e) {
+                std::lock_guard lock{mutex};
+                std::cerr << file.string() << ": " << e.what() << std::endl;
+                failed ++;
+                done ++;
+            }
+            changed.notify_all();
+        });
+    }
+    std::unique_ptr<ThreadPool> imagePool{};
+    while(true) {
+        std::unique_lock lock{mutex};
+        changed.wait(lock, [&] {return !images.empty() || done == files.size();});
+        if(images.empty()) break;
+        auto [file, processed] = std::move(images.front());
+        images.pop_front();
+        lock.unlock();
+        changed.notify_all();
+        std::string error{};
+        try {
+            if(!imagePool) imagePool = std::make_unique<ThreadPool>(threads);
+            writePng(options, file, *processed.image, *imagePool);
+            processed.line += " png written";
+        } catch(std::exception& e) {
+            error = e.what();
+        }
+        processed.image.reset();
+        lock.lock();
+        if(error.empty()) {
+            std::cout << processed.line << std::endl;
+        } else {
+            std::cerr << file.string() << ": " << error << std::endl;
+            failed ++;
+        }
+        done ++;
+    }
+    pool.wait();
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    std::cerr << files.size() - failed << " of " << files.size() << " files done in " << time.count() << " s" << std::endl;
+    if(options.memory) {
+        //Each file counts only its own entries, the tables hold those of every file so far
+        std::cerr << std::fixed << std::setprecision(2) << "label and value tables " << Item::internedBytes() / 1048576.0
+                  << " MiB for all files" << std::defaultfloat << std::endl;
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+int batch::meshTimes(unsigned threads, double tolerance) {
+    //Times include each backend's set up, as a design is solved once per change to how it is wired
+    for(uint32_t n = 16; n <= 256; n *= 2) {
+        try {
+            Netlist netlist{mesh(n)};
+            std::cout << "mesh " << n << 'x' << n << ": " << netlist.nodeCount() << " nodes, " << netlist.elements.size() << " elements, direct "
+                      << std::fixed << std::setprecision(1) << bestTime([&netlist] {Solver{netlist}.solve();}) << " ms";
+            const std::pair<const char*, IterativeSolver::Preconditioner> preconditioners[] {
+                    {"jacobi", IterativeSolver::Preconditioner::jacobi},
+                    {"ic0", IterativeSolver::Preconditioner::incomplete_cholesky}
+            };
+            for(const auto& [name, preconditioner] : preconditioners) {
+                IterativeSolver::Options options{};
+                options.preconditioner = preconditioner;
+                options.tolerance = tolerance;
+                options.threads = threads;
+                IterativeSolver::Statistics statistics{};
+                double time = bestTime([&] {IterativeSolver{netlist, options}.solve({}, statistics);});
+                std::cout << ", cg " << name << ' ' << std::setprecision(1) << time << " ms (" << statistics.iterations << " iterations, residual "
+                          << std::scientific << std::setprecision(1) << statistics.residual << std::fixed << (statistics.converged ? "" : ", did not converge") << ')';
+            }
+            std::cout << std::defaultfloat << std::endl;
+        } catch(std::exception& e) {
+            std::cout << std::defaultfloat << std::endl;
+            std::cerr << "mesh " << n << 'x' << n << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <filesystem>
+
+//The command line tools. They run without a window: each input file is handled on its own core and gets every
+//requested output, written next to it or into outputDirectory.
+namespace batch {
+    struct Options {
+        std::string imageFormat; //png or svg, empty for no image
+        int cellSize = 32; //pixels per cell in images
+        bool netlist = false; //SPICE deck
+        bool stats = false; //one line per file on stdout
+        bool memory = false; //bytes each file takes once loaded, on the same line
+        bool convert = false; //save again in the current file format
+        bool loadTimes = false; //time loading each file on 1, 2, 4... threads up to jobs, one file at a time
+        bool sweepTimes = false; //time a parameter sweep of each file the same way
+        bool itemLayout = false; //compare memory and a paint pass of each file's items packed and as they were before
+        std::filesystem::path diffBase{}; //count the cells that differ from this file, none if empty
+        std::filesystem::path outputDirectory{};
+        unsigned jobs = std::thread::hardware_concurrency();
+    };
+    //Whether options ask for any of the tools
+    bool wanted(const Options& options);
+    //Inputs may be .schematic files or directories, which are searched recursively for them. PNGs are drawn on the
+    //calling thread, which must be the main thread, while the other files go on being processed.
+    //Returns 0 if every file succeeded, 1 if any failed and 2 if there was nothing to do.
+    int run(const Options& options, const std::vector<std::filesystem::path>& inputs);
+    //Solves N x N resistor meshes of growing N with the direct solver and with conjugate gradient under each
+    //preconditioner on threads threads, stopping CG at tolerance, and prints the best of three times, and CG's iterations
+    //and residual, for each
+    int meshTimes(unsigned threads, double tolerance);
+}
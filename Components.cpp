@@ -0,0 +1,263 @@
+#include "Components.h"
+#include "Resources.h"
+#include <charconv>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+    struct Table {
+        std::vector<components::Component> parts;
+        const components::Component* byType[256]{};
+        size_t limit{0};
+    };
+
+    const std::pair<const char*, Item::ItemType> models[] {
+            {"resistor", Item::ItemType::resistor},
+            {"capacitor", Item::ItemType::capacitor},
+            {"volt_source", Item::ItemType::volt_source},
+            {"amp_source", Item::ItemType::amp_source},
+            {"toggle", Item::ItemType::toggle}
+    };
+
+    class Parser {
+    public:
+        explicit Parser(std::string_view text) : text{text} {}
+        Table parse();
+    private:
+        [[noreturn]] void fail(const std::string& message) const {
+            throw std::runtime_error{"components.txt line " + std::to_string(lineNumber) + ": " + message};
+        }
+        double number(const std::string& word) const;
+        std::wstring wide(const std::string& text) const;
+        void finish(Table& table);
+        void line(components::Component& part, std::istringstream& words, const std::string& keyword, components::When when);
+        std::string_view text;
+        int lineNumber{0};
+    };
+
+    //Decimals, or fractions of them, read the same whatever the locale
+    double Parser::number(const std::string& word) const {
+        size_t slash = word.find('/');
+        auto read = [this, &word](size_t begin, size_t end) {
+            double value;
+            auto [at, error] = std::from_chars(word.data() + begin, word.data() + end, value);
+            if(error != std::errc{} || at != word.data() + end) fail("not a number: " + word);
+            return value;
+        };
+        if(slash == std::string::npos) return read(0, word.size());
+        return read(0, slash) / read(slash + 1, word.size());
+    }
+
+    std::wstring Parser::wide(const std::string& text) const {
+        return wxString::FromUTF8(text.data(), text.size()).ToStdWstring();
+    }
+
+    void Parser::line(components::Component& part, std::istringstream& words, const std::string& keyword, components::When when) {
+        std::string word;
+        if(keyword == "line" || keyword == "circle") {
+            std::vector<double> numbers{};
+            while(words >> word) numbers.push_back(number(word));
+            components::Stroke stroke{when, keyword == "circle", 0, {}};
+            if(stroke.circle) {
+                if(numbers.size() != 3) fail("a circle takes x, y and radius");
+                stroke.radius = numbers[2];
+                numbers.pop_back();
+            } else if(numbers.size() < 4 || numbers.size() % 2 != 0) {
+                fail("a line takes two or more points");
+            }
+            for(size_t i = 0; i < numbers.size(); i += 2) {
+                stroke.points.push_back({numbers[i], numbers[i + 1]});
+            }
+            part.strokes.push_back(std::move(stroke));
+            return;
+        }
+        if(keyword != "label") fail("unknown keyword " + keyword);
+        std::string place;
+        std::vector<double> numbers{};
+        words >> place;
+        while(words >> word) numbers.push_back(number(word));
+        for(int state = 0; state < 2; state ++) {
+            if(when == (state == 0 ? components::When::set : components::When::clear)) continue;
+            components::Anchor& anchor = part.anchors[state];
+            if(place == "below" && numbers.size() == 1) {
+                anchor.below = numbers[0];
+            } else if(place == "rotated" && numbers.size() == 1) {
+                anchor.rotated = numbers[0];
+            } else if(place == "beside" && numbers.size() == 3) {
+                anchor.beside = numbers[0];
+                anchor.height = numbers[1];
+                anchor.split = static_cast<int>(numbers[2]);
+            } else {
+                fail("a label goes below <y>, rotated <x> or beside <x> <height> <split>");
+            }
+        }
+    }
+
+    void Parser::finish(Table& table) {
+        if(table.parts.empty()) return;
+        const components::Component& part = table.parts.back();
+        if(part.title.empty() || part.plural.empty()) fail("part " + part.name + " needs a title and plural");
+        bool sourceModel = part.model == Item::ItemType::volt_source || part.model == Item::ItemType::amp_source;
+        //Overlay and SPICE export take the polarity of sources from the way they face
+        if(sourceModel != (part.terminals == components::Terminals::four_way)) {
+            fail("part " + part.name + " must be four way if and only if it is a source");
+        }
+    }
+
+    Table Parser::parse() {
+        Table table{};
+        const uint8_t reserved[] = {static_cast<uint8_t>(Item::ItemType::none), static_cast<uint8_t>(Item::ItemType::wire),
+                                    static_cast<uint8_t>(Item::ItemType::instance)};
+        std::istringstream lines{std::string{text}};
+        std::string line;
+        while(std::getline(lines, line)) {
+            lineNumber ++;
+            if(!line.empty() && line.back() == '\r') line.pop_back();
+            std::istringstream words{line};
+            std::string keyword;
+            if(!(words >> keyword) || keyword[0] == '#') continue;
+            if(keyword == "part") {
+                finish(table);
+                int type;
+                std::string name;
+                if(!(words >> type >> name) || type <= 0 || type > 255) fail("a part takes a type from 1 to 255 and a name");
+                if(std::find(std::begin(reserved), std::end(reserved), type) != std::end(reserved) || table.byType[type] != nullptr) {
+                    fail("type " + std::to_string(type) + " is taken");
+                }
+                table.parts.push_back(components::Component{static_cast<Item::ItemType>(type), name, {}, {}, 0, Item::ItemType::resistor,
+                                                            components::Terminals::two_way, 0, 0, 1, {}, {}});
+                table.byType[type] = &table.parts.back(); //pointed at again once every part is read
+                continue;
+            }
+            if(table.parts.empty()) fail(keyword + " before the first part");
+            components::Component& part = table.parts.back();
+            std::string rest;
+            std::getline(words >> std::ws, rest);
+            std::istringstream restWords{rest};
+            if(keyword == "title") {
+                part.title = wide(rest);
+            } else if(keyword == "plural") {
+                part.plural = wide(rest);
+            } else if(keyword == "key") {
+                std::wstring key = wide(rest);
+                if(key.size() != 1) fail("a key is one character");
+                for(const components::Component& other : table.parts) {
+                    if(other.key == key[0]) fail("key " + rest + " is taken");
+                }
+                part.key = key[0];
+            } else if(keyword == "model") {
+                auto model = std::find_if(std::begin(models), std::end(models), [&rest](const auto& model) {return rest == model.first;});
+                if(model == std::end(models)) fail("unknown model " + rest);
+                part.model = model->second;
+            } else if(keyword == "terminals") {
+                if(rest != "two_way" && rest != "four_way") fail("terminals are two_way or four_way");
+                part.terminals = rest == "two_way" ? components::Terminals::two_way : components::Terminals::four_way;
+            } else if(keyword == "unit") {
+                std::wstring unit = rest == "none" ? std::wstring{} : wide(rest);
+                if(unit.size() > 1) fail("a unit is one character, or none");
+                part.unit = unit.empty() ? 0 : unit[0];
+            } else if(keyword == "value") {
+                part.value = number(rest);
+            } else if(keyword == "icon") {
+                part.iconScale = number(rest);
+            } else if(keyword == "open" || keyword == "independent" || keyword == "closed" || keyword == "dependent") {
+                bool set = keyword == "closed" || keyword == "dependent";
+                std::string stroke;
+                restWords >> stroke;
+                this->line(part, restWords, stroke, set ? components::When::set : components::When::clear);
+            } else {
+                this->line(part, restWords, keyword, components::When::always);
+            }
+        }
+        finish(table);
+        //The vector has stopped growing, so its parts stay where they are
+        for(const components::Component& part : table.parts) {
+            auto type = static_cast<uint8_t>(part.type);
+            table.byType[type] = &part;
+            table.limit = std::max(table.limit, static_cast<size_t>(type) + 1);
+        }
+        return table;
+    }
+
+    //Read the first time any part is looked up
+    const Table& table() {
+        static const Table table = Parser{std::string_view{reinterpret_cast<const char*>(resources::components_txt.data), resources::components_txt.size}}.parse();
+        return table;
+    }
+}
+
+int components::Component::variant(int shape) const {
+    if(terminals == Terminals::two_way) {
+        return ((shape & Item::VERTICAL) ? 1 : 0) + ((shape & Item::CLOSED) ? 2 : 0);
+    }
+    int index = (shape & Item::UP) ? 0 : (shape & Item::DOWN) ? 1 : (shape & Item::RIGHT) ? 2 : 3;
+    return (shape & Item::DEPENDENT) ? index + 4 : index;
+}
+
+int components::Component::variants() const {
+    return terminals == Terminals::two_way ? 4 : 8;
+}
+
+bool components::Component::draws(const Stroke& stroke, int variant) const {
+    return stroke.when == When::always || (stroke.when == When::set) == (variant >= variants() / 2);
+}
+
+components::Point components::Component::place(Point point, int variant) const {
+    if(terminals == Terminals::two_way) {
+        return (variant & 1) ? Point{point.y, point.x} : point;
+    }
+    switch(variant & 3) {
+        case 0: //up
+            return {point.y, 1 - point.x};
+        case 1: //down
+            return {1 - point.y, point.x};
+        case 2: //right
+            return point;
+        default: //left
+            return {1 - point.x, 1 - point.y};
+    }
+}
+
+bool components::Component::horizontal(int shape) const {
+    if(terminals == Terminals::two_way) return !(shape & Item::VERTICAL);
+    return (shape & (Item::LEFT | Item::RIGHT)) != 0;
+}
+
+const components::Anchor& components::Component::anchor(int shape) const {
+    int stateBit = terminals == Terminals::two_way ? Item::CLOSED : Item::DEPENDENT;
+    return anchors[(shape & stateBit) ? 1 : 0];
+}
+
+int components::Component::rotated(int shape) const {
+    if(terminals == Terminals::two_way) return shape ^ Item::VERTICAL;
+    int turned = 0;
+    if(shape & Item::UP) turned |= Item::RIGHT;
+    if(shape & Item::RIGHT) turned |= Item::DOWN;
+    if(shape & Item::DOWN) turned |= Item::LEFT;
+    if(shape & Item::LEFT) turned |= Item::UP;
+    return (shape & Item::DEPENDENT) | turned;
+}
+
+int components::Component::placed(int direction) const {
+    if(terminals == Terminals::four_way) return direction;
+    return (direction & (Item::LEFT | Item::RIGHT)) ? Item::HORIZONTAL : Item::VERTICAL;
+}
+
+const components::Component* components::find(Item::ItemType type) {
+    return table().byType[static_cast<uint8_t>(type)];
+}
+
+const std::vector<components::Component>& components::all() {
+    return table().parts;
+}
+
+size_t components::limit() {
+    return table().limit;
+}
+
+bool components::isUnit(wchar_t symbol) {
+    if(symbol == 0) return false;
+    const std::vector<Component>& parts = table().parts;
+    return std::any_of(parts.begin(), parts.end(), [symbol](const Component& part) {return part.unit == symbol;});
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Item.h"
+
+//The parts a cell can hold besides wires and sub-circuit instances, described in res/components.txt and compiled in.
+//Drawing, netlisting and the tools look a part up here by its type rather than switching on it, so adding one is a
+//matter of describing it, and it draws from the same glyph cache at the same cost as those there already.
+namespace components {
+    //Glyphs of a part at one size, for each way it faces and then again in its other state
+    constexpr int MAX_VARIANTS = 8;
+
+    //How a part connects: across its cell left to right or top to bottom, or towards a side, its positive terminal's
+    enum class Terminals : uint8_t {
+        two_way, four_way
+    };
+    //Each part has a shape bit of its own besides those of the way it faces: CLOSED across or DEPENDENT towards a side
+    enum class When : uint8_t {
+        always, clear, set
+    };
+    struct Point {
+        double x, y;
+    };
+    //A polyline, or a circle of radius about the one point
+    struct Stroke {
+        When when;
+        bool circle;
+        double radius;
+        std::vector<Point> points;
+    };
+    //Where the value or label goes, as fractions of a cell
+    struct Anchor {
+        double below{0}; //lying flat: top of the text, centred across the cell
+        double rotated{0}; //standing up with rotated text: where the text runs down the cell, centred
+        double beside{0}; //standing up otherwise: left of the text, centred down [0, height]
+        double height{1};
+        int split{0}; //characters a line beside
+    };
+    struct Component {
+        Item::ItemType type;
+        std::string name;
+        std::wstring title;
+        std::wstring plural;
+        wchar_t key; //picks its tool when typed, 0 for none
+        Item::ItemType model; //the built-in part the solver and SPICE export take it for
+        Terminals terminals;
+        wchar_t unit; //0 if it has no value, only a label
+        double value; //given when placed
+        double iconScale; //toolbar glyph scaled about the middle of the cell by this
+        std::vector<Stroke> strokes; //lying left to right, and pointing right if four way
+        Anchor anchors[2]; //with its own shape bit clear and set
+
+        //Glyph variant of a shape, below variants: 0 and 1 across and down, or 0 to 3 up, down, right and left, then
+        //as many again with its own shape bit set
+        int variant(int shape) const;
+        int variants() const;
+        //Whether the glyph of variant has stroke
+        bool draws(const Stroke& stroke, int variant) const;
+        //Point of a stroke moved to where it goes in variant's glyph
+        Point place(Point point, int variant) const;
+        bool horizontal(int shape) const;
+        const Anchor& anchor(int shape) const;
+        //Shape turned a quarter clockwise
+        int rotated(int shape) const;
+        //Shape it is placed with when drawn towards direction, one of UP, DOWN, RIGHT and LEFT
+        int placed(int direction) const;
+    };
+
+    //Null for types that are not parts: empty cells, wires, instances and any the description does not have
+    const Component* find(Item::ItemType type);
+    //Every part, in the order described
+    const std::vector<Component>& all();
+    //One more than the largest type of a part, to size tables indexed by type
+    size_t limit();
+    //Whether symbol is the unit of a part's value
+    bool isUnit(wchar_t symbol);
+}
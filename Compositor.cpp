@@ -0,0 +1,190 @@
+#include "Compositor.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SCHEMATIC_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SCHEMATIC_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace {
+    using BlendRow = void (*)(uint32_t* destination, const uint32_t* source, int count);
+
+    //destination = source + destination * (255 - source alpha) / 255, rounded, two channels at a time in 16 bit halves
+    inline uint32_t blendPixel(uint32_t destination, uint32_t source) {
+        uint32_t inverse = 255 - (source >> 24);
+        uint32_t redBlue = (destination & 0x00FF00FF) * inverse + 0x00800080;
+        redBlue = ((redBlue + ((redBlue >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+        uint32_t greenAlpha = ((destination >> 8) & 0x00FF00FF) * inverse + 0x00800080;
+        greenAlpha = (greenAlpha + ((greenAlpha >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+        return source + (redBlue | greenAlpha);
+    }
+
+    void blendScalar(uint32_t* destination, const uint32_t* source, int count) {
+        for(int i = 0; i < count; i ++) {
+            destination[i] = blendPixel(destination[i], source[i]);
+        }
+    }
+
+#ifdef SCHEMATIC_X86
+    //The same sum as blendPixel, on pixels widened to a 16 bit lane per channel
+    inline __m128i blendWide(__m128i destination, __m128i source) {
+        const __m128i all = _mm_set1_epi16(255);
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(source, 0xFF), 0xFF);
+        __m128i product = _mm_add_epi16(_mm_mullo_epi16(destination, _mm_sub_epi16(all, alpha)), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+    }
+
+    void blendSse2(uint32_t* destination, const uint32_t* source, int count) {
+        const __m128i zero = _mm_setzero_si128();
+        int i = 0;
+        for(; i + 4 <= count; i += 4) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + i));
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+            __m128i low = blendWide(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+            __m128i high = blendWide(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_add_epi8(_mm_packus_epi16(low, high), s));
+        }
+        blendScalar(destination + i, source + i, count - i);
+    }
+
+    TARGET_AVX2 inline __m256i blendWideAvx2(__m256i destination, __m256i source) {
+        const __m256i all = _mm256_set1_epi16(255);
+        __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(source, 0xFF), 0xFF);
+        __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(destination, _mm256_sub_epi16(all, alpha)), _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+    }
+
+    //Unpacking and packing both stay within 128 bit lanes, so the pixels come back in order
+    TARGET_AVX2 void blendAvx2(uint32_t* destination, const uint32_t* source, int count) {
+        const __m256i zero = _mm256_setzero_si256();
+        int i = 0;
+        for(; i + 8 <= count; i += 8) {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i));
+            __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+            __m256i low = blendWideAvx2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero));
+            __m256i high = blendWideAvx2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_add_epi8(_mm256_packus_epi16(low, high), s));
+        }
+        blendSse2(destination + i, source + i, count - i);
+    }
+
+    bool hasAvx2() {
+#if defined(SCHEMATIC_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        bool osSaves = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSaves && (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    const std::pair<BlendRow, const char*>& blendRow() {
+#ifdef SCHEMATIC_X86
+        static const std::pair<BlendRow, const char*> chosen = hasAvx2() ? std::pair<BlendRow, const char*>{blendAvx2, "avx2"} :
+                std::pair<BlendRow, const char*>{blendSse2, "sse2"};
+#else
+        static const std::pair<BlendRow, const char*> chosen{blendScalar, "scalar"};
+#endif
+        return chosen;
+    }
+}
+
+uint32_t Compositor::pack(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha) {
+    return static_cast<uint32_t>(red) | (static_cast<uint32_t>(green) << 8) | (static_cast<uint32_t>(blue) << 16) | (static_cast<uint32_t>(alpha) << 24);
+}
+
+Compositor::Sprite Compositor::fromRgb(int width, int height, const uint8_t* rgb, const uint8_t* alpha) {
+    Sprite sprite{width, height, std::vector<uint32_t>(static_cast<size_t>(width) * height)};
+    for(size_t i = 0; i < sprite.pixels.size(); i ++) {
+        uint32_t a = alpha ? alpha[i] : 255;
+        auto premultiply = [a](uint8_t channel) {
+            return static_cast<uint8_t>((channel * a + 127) / 255);
+        };
+        sprite.pixels[i] = pack(premultiply(rgb[3 * i]), premultiply(rgb[3 * i + 1]), premultiply(rgb[3 * i + 2]), static_cast<uint8_t>(a));
+    }
+    return sprite;
+}
+
+Compositor::Sprite Compositor::disc(double radius, uint32_t colour) {
+    int size = 2 * static_cast<int>(std::ceil(radius + 0.5));
+    Sprite sprite{size, size, std::vector<uint32_t>(static_cast<size_t>(size) * size)};
+    double centre = size / 2.0;
+    for(int y = 0; y < size; y ++) {
+        for(int x = 0; x < size; x ++) {
+            //Coverage falls from 1 to 0 over the pixel that straddles the edge
+            double distance = std::hypot(x + 0.5 - centre, y + 0.5 - centre);
+            double coverage = std::clamp(radius + 0.5 - distance, 0.0, 1.0);
+            auto scale = [coverage, colour](int shift) {
+                return static_cast<uint8_t>(std::lround(((colour >> shift) & 0xFF) * coverage));
+            };
+            sprite.pixels[static_cast<size_t>(y) * size + x] = pack(scale(0), scale(8), scale(16), static_cast<uint8_t>(std::lround(255 * coverage)));
+        }
+    }
+    return sprite;
+}
+
+const char* Compositor::kernel() {
+    return blendRow().second;
+}
+
+void Compositor::resize(int width, int height) {
+    this->width = std::max(width, 0);
+    this->height = std::max(height, 0);
+    pixels.resize(static_cast<size_t>(this->width) * this->height);
+}
+
+void Compositor::clear(uint32_t colour) {
+    std::fill(pixels.begin(), pixels.end(), colour);
+}
+
+void Compositor::blend(const Sprite& sprite, int x, int y) {
+    int left = std::max(x, 0);
+    int top = std::max(y, 0);
+    int right = std::min(x + sprite.width, width);
+    int bottom = std::min(y + sprite.height, height);
+    if(left >= right || top >= bottom) return;
+    BlendRow row = blendRow().first;
+    for(int r = top; r < bottom; r ++) {
+        row(pixels.data() + static_cast<size_t>(r) * width + left, sprite.pixels.data() + static_cast<size_t>(r - y) * sprite.width + (left - x), right - left);
+    }
+}
+
+void Compositor::fill(int x, int y, int width, int height, uint32_t colour) {
+    int left = std::max(x, 0);
+    int top = std::max(y, 0);
+    int right = std::min(x + width, this->width);
+    int bottom = std::min(y + height, this->height);
+    if(left >= right || top >= bottom) return;
+    for(int r = top; r < bottom; r ++) {
+        std::fill_n(pixels.data() + static_cast<size_t>(r) * this->width + left, right - left, colour);
+    }
+}
+
+int Compositor::getWidth() const {
+    return width;
+}
+
+int Compositor::getHeight() const {
+    return height;
+}
+
+const uint32_t* Compositor::data() const {
+    return pixels.data();
+}
+
+size_t Compositor::memoryUsage() const {
+    return pixels.capacity() * sizeof(uint32_t);
+}
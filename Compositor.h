@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//Software rendering into one RGBA frame buffer, for drawing the grid without a device context call per glyph.
+//Sprites are premultiplied, so drawing one is a single blend that runs on AVX2 or SSE2 where the CPU has them.
+class Compositor {
+public:
+    //Premultiplied RGBA, a uint32_t per pixel with red in the lowest byte
+    struct Sprite {
+        int width{0};
+        int height{0};
+        std::vector<uint32_t> pixels;
+    };
+    static uint32_t pack(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha = 255);
+    //Sprite of separate rgb and alpha planes that are not premultiplied, as wxImage keeps them. Opaque if alpha is null.
+    static Sprite fromRgb(int width, int height, const uint8_t* rgb, const uint8_t* alpha);
+    //Antialiased filled circle of an opaque colour, centred on the corner between its four middle pixels
+    static Sprite disc(double radius, uint32_t colour);
+    //Name of the blend kernel in use, avx2, sse2 or scalar
+    static const char* kernel();
+
+    //Contents are left undefined
+    void resize(int width, int height);
+    void clear(uint32_t colour);
+    //Draws sprite over the buffer with its top left corner at (x, y), clipped to the buffer
+    void blend(const Sprite& sprite, int x, int y);
+    //Sets a rectangle, clipped to the buffer, to an opaque colour
+    void fill(int x, int y, int width, int height, uint32_t colour);
+    int getWidth() const;
+    int getHeight() const;
+    const uint32_t* data() const;
+    size_t memoryUsage() const;
+private:
+    int width{0};
+    int height{0};
+    std::vector<uint32_t> pixels;
+};
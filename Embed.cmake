@@ -0,0 +1,16 @@
+#Writes OUTPUT, a source defining a resources::Embedded for each of FILES that holds its bytes, named after the file
+#as a C identifier. Run at build time with cmake -P, whenever a file changes.
+set(source "#include \"Resources.h\"\n")
+foreach(file IN LISTS FILES)
+    get_filename_component(name ${file} NAME)
+    string(MAKE_C_IDENTIFIER ${name} identifier)
+    file(READ ${file} hex HEX)
+    string(LENGTH "${hex}" digits)
+    math(EXPR size "${digits} / 2")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${hex}")
+    string(REGEX REPLACE "(0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,)" "\\1\n        " bytes "${bytes}")
+    string(REGEX REPLACE "\n        $" "" bytes "${bytes}")
+    string(APPEND source "\nnamespace {\n    const unsigned char ${identifier}_data[${size}] {\n        ${bytes}\n    };\n}\n")
+    string(APPEND source "const resources::Embedded resources::${identifier}{${identifier}_data, ${size}};\n")
+endforeach()
+file(WRITE ${OUTPUT} "${source}")
@@ -0,0 +1,74 @@
+#include "FindDialog.h"
+#include "Components.h"
+#include <chrono>
+#include <cmath>
+
+FindDialog::FindDialog(wxWindow* parent, WindowGrid& grid) : wxDialog(parent, wxID_ANY, "Find"), grid{grid} {
+    wxArrayString kinds{};
+    kinds.Add("Label");
+    for(const components::Component& part : components::all()) {
+        if(part.unit == 0) continue;
+        kinds.Add(part.title);
+        valueTypes.push_back(part.type);
+    }
+    kindChoice = new wxChoice{this, wxID_ANY, wxDefaultPosition, wxDefaultSize, kinds};
+    kindChoice->SetSelection(0);
+    textCtrl = new wxTextCtrl{this, wxID_ANY, "", wxDefaultPosition, wxDefaultSize, wxTE_PROCESS_ENTER};
+    auto* findButton = new wxButton{this, wxID_FIND, "Find"};
+    auto* previousButton = new wxButton{this, wxID_BACKWARD, "Previous"};
+    auto* nextButton = new wxButton{this, wxID_FORWARD, "Next"};
+    resultText = new wxStaticText{this, wxID_ANY, ""};
+    int dip5 = FromDIP(5);
+    auto* upperSizer = new wxBoxSizer{wxHORIZONTAL};
+    upperSizer->Add(kindChoice, 0, wxLEFT | wxTOP | wxBOTTOM | wxALIGN_CENTER_VERTICAL, dip5);
+    upperSizer->Add(textCtrl, 1, wxALL | wxALIGN_CENTER_VERTICAL, dip5);
+    upperSizer->Add(findButton, 0, wxRIGHT | wxTOP | wxBOTTOM | wxALIGN_CENTER_VERTICAL, dip5);
+    auto* lowerSizer = new wxBoxSizer{wxHORIZONTAL};
+    lowerSizer->Add(resultText, 1, wxLEFT | wxBOTTOM | wxALIGN_CENTER_VERTICAL, dip5);
+    lowerSizer->Add(previousButton, 0, wxLEFT | wxBOTTOM | wxALIGN_CENTER_VERTICAL, dip5);
+    lowerSizer->Add(nextButton, 0, wxLEFT | wxRIGHT | wxBOTTOM | wxALIGN_CENTER_VERTICAL, dip5);
+    auto* mainSizer = new wxBoxSizer{wxVERTICAL};
+    mainSizer->Add(upperSizer, 0, wxEXPAND);
+    mainSizer->Add(lowerSizer, 0, wxEXPAND);
+    mainSizer->Layout();
+    SetSizerAndFit(mainSizer);
+
+    Bind(wxEVT_BUTTON, &FindDialog::onFind, this, wxID_FIND);
+    textCtrl->Bind(wxEVT_TEXT_ENTER, &FindDialog::onFind, this);
+    Bind(wxEVT_BUTTON, [this](wxCommandEvent& evt) {step(-1);}, wxID_BACKWARD);
+    Bind(wxEVT_BUTTON, [this](wxCommandEvent& evt) {step(1);}, wxID_FORWARD);
+}
+
+void FindDialog::onFind(wxCommandEvent& evt) {
+    auto start = std::chrono::steady_clock::now();
+    const GridIndex& index = grid.getGrid().getIndex();
+    std::wstring text = textCtrl->GetValue().ToStdWstring();
+    int kind = kindChoice->GetSelection();
+    if(kind <= 0) {
+        hits = index.findLabel(text);
+    } else {
+        double value;
+        if(!Item::parseValue(text, value)) {
+            resultText->SetLabel("Not a number");
+            hits.clear();
+            return;
+        }
+        double tolerance = std::abs(value) * 1e-9; //values typed as 4.7k and 4700 may differ in the last bits
+        hits = index.findValue(valueTypes[kind - 1], value - tolerance, value + tolerance);
+    }
+    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    wxLogStatus("Found %u cells in %.2f ms", static_cast<unsigned>(hits.size()), time.count());
+    current = 0;
+    if(hits.empty()) {
+        resultText->SetLabel("No matches");
+    } else {
+        step(0);
+    }
+}
+
+void FindDialog::step(int direction) {
+    if(hits.empty()) return;
+    current = (current + hits.size() + direction) % hits.size();
+    grid.showCell(static_cast<uint32_t>(hits[current] >> 32), static_cast<uint32_t>(hits[current]));
+    resultText->SetLabel(wxString::Format("%u of %u", static_cast<unsigned>(current + 1), static_cast<unsigned>(hits.size())));
+}
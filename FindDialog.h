@@ -0,0 +1,20 @@
+#pragma once
+#include <wx/wx.h>
+#include <vector>
+#include "WindowGrid.h"
+
+//Modeless search over labels and component values, stepping WindowGrid through the hits
+class FindDialog : public wxDialog {
+public:
+    FindDialog(wxWindow* parent, WindowGrid& grid);
+private:
+    void onFind(wxCommandEvent& evt);
+    void step(int direction);
+    WindowGrid& grid;
+    wxChoice* kindChoice;
+    std::vector<Item::ItemType> valueTypes; //of the choices in kindChoice after "Label"
+    wxTextCtrl* textCtrl;
+    wxStaticText* resultText;
+    std::vector<uint64_t> hits;
+    size_t current{0};
+};
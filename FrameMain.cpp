@@ -1,9 +1,16 @@
 #include "FrameMain.h"
 #include "id.h"
 #include "Resources.h"
+#include "Components.h"
 #include "NewSchematicDialog.h"
 #include "DotSizeDialog.h"
+#include "FindDialog.h"
+#include "SpiceExport.h"
+#include "Profiler.h"
+#include <wx/numdlg.h>
 #include <fstream>
+#include <algorithm>
+#include <chrono>
 
 FrameMain::FrameMain(const std::wstring& fileIn) : wxFrame(nullptr, wxID_ANY, "Schematic", wxDefaultPosition, wxDefaultSize,wxDEFAULT_FRAME_STYLE) {
     this->Maximize();
@@ -12,21 +19,47 @@ FrameMain::FrameMain(const std::wstring& fileIn) : wxFrame(nullptr, wxID_ANY, "S
     Bind(wxEVT_SIZE, &FrameMain::onSize, this);
     Bind(wxEVT_CHAR_HOOK, &FrameMain::onChar, this);
     Bind(wxEVT_TOOL, [this](wxCommandEvent& evt) {windowGrid->selectedTool = Item::ItemType::wire;}, id::tool_wire);
-    Bind(wxEVT_TOOL, [this](wxCommandEvent& evt) {windowGrid->selectedTool = Item::ItemType::resistor;}, id::tool_resistor);
-    Bind(wxEVT_TOOL, [this](wxCommandEvent& evt) {windowGrid->selectedTool = Item::ItemType::volt_source;}, id::tool_volt_source);
-    Bind(wxEVT_TOOL, [this](wxCommandEvent& evt) {windowGrid->selectedTool = Item::ItemType::amp_source;}, id::tool_amp_source);
-    Bind(wxEVT_TOOL, [this](wxCommandEvent& evt) {windowGrid->selectedTool = Item::ItemType::capacitor;}, id::tool_capacitor);
-    Bind(wxEVT_TOOL, [this](wxCommandEvent& evt) {windowGrid->selectedTool = Item::ItemType::toggle;}, id::tool_switch);
+    for(size_t i = 0; i < components::all().size(); i ++) {
+        Item::ItemType type = components::all()[i].type;
+        Bind(wxEVT_TOOL, [this, type](wxCommandEvent& evt) {windowGrid->selectedTool = type;}, id::tool_part + static_cast<int>(i));
+    }
     Bind(wxEVT_TOOL, [this](wxCommandEvent& evt) {windowGrid->selectedTool = Item::ItemType::none;}, id::tool_bin);
     Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {onSave(false);}, id::file_save);
     Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {onSave(true);}, id::file_save_as);
     Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {onLoad();}, id::file_load);
     Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {onNew();}, id::file_new);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {onExportSpice();}, id::file_export_spice);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {onExportImage();}, id::file_export_image);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {onCompare();}, id::file_compare);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {closeComparison();}, id::file_close_comparison);
+    Bind(wxEVT_UPDATE_UI, [this](wxUpdateUIEvent& evt) {evt.Enable(comparison != nullptr);}, id::file_close_comparison);
     Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {(new DotSizeDialog{this, *windowGrid})->Show();}, id::view_dot_size);
     Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->toggleRotatedText();}, id::view_rotated_text);
     Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->toggleShadedBackground();}, id::view_shaded_background);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->toggleSoftwareRendering();}, id::view_software_rendering);
+    Bind(wxEVT_UPDATE_UI, [this](wxUpdateUIEvent& evt) {evt.Check(windowGrid->renderer == WindowGrid::Renderer::software);}, id::view_software_rendering);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->toggleProfiling();}, id::view_profiling);
+    Bind(wxEVT_UPDATE_UI, [this](wxUpdateUIEvent& evt) {evt.Check(profiler::enabled());}, id::view_profiling);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {onSaveTrace();}, id::view_save_trace);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {wxMessageBox(windowGrid->memoryUsage().toString(), "Memory usage", wxOK, this);}, id::view_memory);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {onRecordInput();}, id::view_record_input);
+    Bind(wxEVT_UPDATE_UI, [this](wxUpdateUIEvent& evt) {evt.Check(recorder != nullptr);}, id::view_record_input);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->simulate();}, id::simulate_run);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->clearSimulation();}, id::simulate_clear);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->toggleIterativeSolver();}, id::simulate_iterative);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->chooseTolerance();}, id::simulate_tolerance);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->toggleLiveSimulation();}, id::simulate_live);
+    Bind(wxEVT_UPDATE_UI, [this](wxUpdateUIEvent& evt) {evt.Check(windowGrid->isLiveSimulation());}, id::simulate_live);
     Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->undo();}, wxID_UNDO);
     Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->redo();}, wxID_REDO);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->cutSelection();}, wxID_CUT);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->copySelection();}, wxID_COPY);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->paste();}, wxID_PASTE);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->deleteSelection();}, wxID_DELETE);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->replicateSelection();}, id::edit_replicate);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {(new FindDialog{this, *windowGrid})->Show();}, id::edit_find);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->makeSubCircuit();}, id::edit_make_block);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) {windowGrid->placeSubCircuit();}, id::edit_place_block);
     Bind(wxEVT_CLOSE_WINDOW, &FrameMain::onClose, this);
 
     wxIconBundle bundle = resources::getResistorIconBundle();
@@ -35,11 +68,11 @@ FrameMain::FrameMain(const std::wstring& fileIn) : wxFrame(nullptr, wxID_ANY, "S
     int dip32 = FromDIP(32);
     toolbar = wxFrame::CreateToolBar(wxTB_VERTICAL | wxTB_FLAT | wxTB_NODIVIDER, wxID_ANY);
     toolbar->AddRadioTool(id::tool_wire, "Wire", resources::getWireBitmap(dip32), wxNullBitmap, "Wire");
-    toolbar->AddRadioTool(id::tool_resistor, "Resistor", resources::getResistorBitmap(dip32, false), wxNullBitmap, "Resistor");
-    toolbar->AddRadioTool(id::tool_volt_source, "Voltage Source", resources::getVoltSourceBitmap(dip32, Item::RIGHT, true), wxNullBitmap, "Voltage Source");
-    toolbar->AddRadioTool(id::tool_amp_source, "Current Source", resources::getAmpSourceBitmap(dip32, Item::RIGHT, true), wxNullBitmap, "Current Source");
-    toolbar->AddRadioTool(id::tool_capacitor, "Capacitor", resources::getCapacitorBitmap(dip32, false), wxNullBitmap, "Capacitor");
-    toolbar->AddRadioTool(id::tool_switch, "Switch", resources::getSwitchBitmap(dip32, false, false), wxNullBitmap, "Switch");
+    for(size_t i = 0; i < components::all().size(); i ++) { //lying flat, pointing right
+        const components::Component& part = components::all()[i];
+        wxBitmap bitmap = resources::getPartBitmap(part, dip32, part.variant(part.placed(Item::RIGHT)), true);
+        toolbar->AddRadioTool(id::tool_part + static_cast<int>(i), part.title, bitmap, wxNullBitmap, part.title);
+    }
     toolbar->AddRadioTool(id::tool_bin, "Delete", resources::getBinBitmap(dip32), wxNullBitmap, "Delete");
     toolbar->Realize();
     toolbar->Fit();
@@ -49,18 +82,48 @@ FrameMain::FrameMain(const std::wstring& fileIn) : wxFrame(nullptr, wxID_ANY, "S
     fileMenu->Append(id::file_save_as, "Save As");
     fileMenu->Append(id::file_load, "Load (CTRL+L)");
     fileMenu->Append(id::file_new, "New (CTRL+N)");
+    fileMenu->AppendSeparator();
+    fileMenu->Append(id::file_export_spice, "Export SPICE netlist");
+    fileMenu->Append(id::file_export_image, "Export image");
+    fileMenu->AppendSeparator();
+    fileMenu->Append(id::file_compare, "Compare with");
+    fileMenu->Append(id::file_close_comparison, "Close comparison");
     auto* viewMenu = new wxMenu();
     viewMenu->Append(id::view_dot_size, "Set grid dot size");
     viewMenu->Append(id::view_rotated_text, "Toggle rotated text");
     viewMenu->Append(id::view_shaded_background, "Toggle shaded background");
+    viewMenu->AppendCheckItem(id::view_software_rendering, "Software rendering");
+    viewMenu->AppendSeparator();
+    viewMenu->AppendCheckItem(id::view_profiling, "Profiling");
+    viewMenu->Append(id::view_save_trace, "Save profile trace");
+    viewMenu->Append(id::view_memory, "Memory usage");
+    viewMenu->AppendCheckItem(id::view_record_input, "Record input");
     auto* editMenu = new wxMenu();
     editMenu->Append(wxID_UNDO, "Undo (CTRL+Z)");
     editMenu->Append(wxID_REDO, "Redo (CTRL+Y)");
+    editMenu->AppendSeparator();
+    editMenu->Append(wxID_CUT, "Cut (CTRL+X)");
+    editMenu->Append(wxID_COPY, "Copy (CTRL+C)");
+    editMenu->Append(wxID_PASTE, "Paste (CTRL+V)");
+    editMenu->Append(wxID_DELETE, "Delete selection (DEL)");
+    editMenu->Append(id::edit_replicate, "Replicate selection");
+    editMenu->Append(id::edit_make_block, "Make sub-circuit from selection");
+    editMenu->Append(id::edit_place_block, "Place sub-circuit");
+    editMenu->AppendSeparator();
+    editMenu->Append(id::edit_find, "Find (CTRL+F)");
+    auto* simulateMenu = new wxMenu();
+    simulateMenu->Append(id::simulate_run, "Simulate (F5)");
+    simulateMenu->Append(id::simulate_clear, "Clear results");
+    simulateMenu->Append(id::simulate_iterative, "Toggle iterative solver");
+    simulateMenu->Append(id::simulate_tolerance, "Iterative solver tolerance...");
+    simulateMenu->AppendCheckItem(id::simulate_live, "Live simulate");
     menuBar = new wxMenuBar();
     menuBar->Append(fileMenu, "File");
     menuBar->Append(viewMenu, "View");
     menuBar->Append(editMenu, "Edit");
+    menuBar->Append(simulateMenu, "Simulate");
     wxFrame::SetMenuBar(menuBar);
+    wxFrame::CreateStatusBar();
 
     if(fileIn.empty()) {
         windowGrid = new WindowGrid(this, wxID_ANY, wxDefaultPosition, GetClientSize());
@@ -75,37 +138,34 @@ FrameMain::FrameMain(const std::wstring& fileIn) : wxFrame(nullptr, wxID_ANY, "S
 }
 
 void FrameMain::onSize(wxSizeEvent& evt) {
-    if(windowGrid) {
+    if(comparison) {
+        wxSize size = GetClientSize();
+        windowGrid->SetSize(0, 0, size.x / 2, size.y);
+        comparison->SetSize(size.x / 2, 0, size.x - size.x / 2, size.y);
+    } else if(windowGrid) {
         windowGrid->SetSize(GetClientSize());
     }
 }
 
 void FrameMain::onChar(wxKeyEvent& evt) {
+    if(evt.GetKeyCode() == WXK_F5) {
+        windowGrid->simulate();
+    } else if(evt.GetKeyCode() == WXK_DELETE) {
+        windowGrid->deleteSelection();
+    } else if(evt.GetKeyCode() == WXK_ESCAPE) {
+        windowGrid->clearSelection();
+    }
+    const std::vector<components::Component>& parts = components::all();
+    auto part = std::find_if(parts.begin(), parts.end(), [&evt](const components::Component& part) {return part.key == evt.GetUnicodeKey();});
+    if(part != parts.end()) {
+        toolbar->ToggleTool(id::tool_part + static_cast<int>(part - parts.begin()), true);
+        windowGrid->selectedTool = part->type;
+    }
     switch(evt.GetUnicodeKey()) {
         case '1':
             toolbar->ToggleTool(id::tool_wire, true);
             windowGrid->selectedTool = Item::ItemType::wire;
             break;
-        case '2':
-            toolbar->ToggleTool(id::tool_resistor, true);
-            windowGrid->selectedTool = Item::ItemType::resistor;
-            break;
-        case '3':
-            toolbar->ToggleTool(id::tool_volt_source, true);
-            windowGrid->selectedTool = Item::ItemType::volt_source;
-            break;
-        case '4':
-            toolbar->ToggleTool(id::tool_amp_source, true);
-            windowGrid->selectedTool = Item::ItemType::amp_source;
-            break;
-        case '5':
-            toolbar->ToggleTool(id::tool_capacitor, true);
-            windowGrid->selectedTool = Item::ItemType::capacitor;
-            break;
-        case '6':
-            toolbar->ToggleTool(id::tool_switch, true);
-            windowGrid->selectedTool = Item::ItemType::toggle;
-            break;
         case '7':
             toolbar->ToggleTool(id::tool_bin, true);
             windowGrid->selectedTool = Item::ItemType::none;
@@ -135,6 +195,26 @@ void FrameMain::onChar(wxKeyEvent& evt) {
                 windowGrid->redo();
             }
             break;
+        case 'X':
+            if(evt.GetModifiers() == wxMOD_CONTROL) {
+                windowGrid->cutSelection();
+            }
+            break;
+        case 'C':
+            if(evt.GetModifiers() == wxMOD_CONTROL) {
+                windowGrid->copySelection();
+            }
+            break;
+        case 'V':
+            if(evt.GetModifiers() == wxMOD_CONTROL) {
+                windowGrid->paste();
+            }
+            break;
+        case 'F':
+            if(evt.GetModifiers() == wxMOD_CONTROL) {
+                (new FindDialog{this, *windowGrid})->Show();
+            }
+            break;
     }
     evt.Skip();
 }
@@ -186,6 +266,121 @@ void FrameMain::onNew() {
     }
 }
 
+void FrameMain::onExportSpice() {
+    wxFileDialog dialog{this, "Export SPICE Netlist", "", "", "SPICE netlists (*.cir)|*.cir", wxFD_SAVE | wxFD_OVERWRITE_PROMPT};
+    if(dialog.ShowModal() != wxID_OK) return;
+    std::filesystem::path path{std::wstring_view{dialog.GetPath().wc_str()}};
+    auto start = std::chrono::steady_clock::now();
+    std::ofstream ofstream{path, std::ios_base::binary};
+    if(ofstream.fail()) {
+        wxMessageDialog{this, "Could not export", "Error", wxOK | wxICON_ERROR}.ShowModal();
+        return;
+    }
+    Netlist netlist{windowGrid->getGrid()};
+    std::string title = file.empty() ? std::string{"Untitled"} : file.stem().string();
+    spice::write(ofstream, netlist, "* " + title);
+    ofstream.close();
+    if(ofstream.fail()) {
+        wxMessageDialog{this, "Could not export", "Error", wxOK | wxICON_ERROR}.ShowModal();
+        return;
+    }
+    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    wxLogStatus("Exported %zu elements in %.1f ms", netlist.elements.size(), time.count());
+}
+
+void FrameMain::onExportImage() {
+    wxFileDialog dialog{this, "Export Image", "", "", "PNG images (*.png)|*.png|SVG images (*.svg)|*.svg", wxFD_SAVE | wxFD_OVERWRITE_PROMPT};
+    if(dialog.ShowModal() != wxID_OK) return;
+    bool svg = dialog.GetFilterIndex() == 1;
+    long cellSize = wxGetNumberFromUser("Pixels per cell:", "", "Export Image", 32, 4, 1024, this);
+    if(cellSize == -1) return;
+    std::filesystem::path path{std::wstring_view{dialog.GetPath().wc_str()}};
+    std::ofstream ofstream{path, std::ios_base::binary};
+    if(ofstream.fail()) {
+        wxMessageDialog{this, "Could not export", "Error", wxOK | wxICON_ERROR}.ShowModal();
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    try {
+        wxBusyCursor busy{};
+        windowGrid->exportImage(ofstream, svg, static_cast<int>(cellSize));
+    } catch(std::runtime_error& e) {
+        wxMessageDialog{this, e.what(), "Error", wxOK | wxICON_ERROR}.ShowModal();
+        return;
+    }
+    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    wxLogStatus("Exported image in %.1f ms", time.count());
+}
+
+void FrameMain::onSaveTrace() {
+    wxFileDialog dialog{this, "Save Profile Trace", "", "", "Chrome traces (*.json)|*.json", wxFD_SAVE | wxFD_OVERWRITE_PROMPT};
+    if(dialog.ShowModal() != wxID_OK) return;
+    std::ofstream ofstream{std::filesystem::path{std::wstring_view{dialog.GetPath().wc_str()}}, std::ios_base::binary};
+    profiler::writeTrace(ofstream);
+    ofstream.close();
+    if(ofstream.fail()) {
+        wxMessageDialog{this, "Could not save trace", "Error", wxOK | wxICON_ERROR}.ShowModal();
+    }
+}
+
+void FrameMain::onRecordInput() {
+    if(!recorder) {
+        recorder = std::make_unique<input::Recorder>(*this, *windowGrid);
+        return;
+    }
+    input::Log log = recorder->getLog();
+    recorder.reset();
+    wxFileDialog dialog{this, "Save Input Log", "", "", "Input logs (*.input)|*.input", wxFD_SAVE | wxFD_OVERWRITE_PROMPT};
+    if(dialog.ShowModal() != wxID_OK) return;
+    try {
+        log.save(std::filesystem::path{std::wstring_view{dialog.GetPath().wc_str()}});
+    } catch(std::runtime_error& e) {
+        wxMessageDialog{this, e.what(), "Error", wxOK | wxICON_ERROR}.ShowModal();
+    }
+}
+
+//Shows another file beside the one being edited, as the earlier of the two, with what differs outlined in both
+void FrameMain::onCompare() {
+    wxFileDialog dialog{this, "Compare With", "", "", "Schematic files (*.schematic)|*.schematic", wxFD_OPEN | wxFD_FILE_MUST_EXIST};
+    if(dialog.ShowModal() != wxID_OK) return;
+    std::ifstream ifstream{std::filesystem::path{std::wstring_view{dialog.GetPath().wc_str()}}, std::ios_base::binary};
+    WindowGrid::LoadStruct load{};
+    try {
+        load = WindowGrid::load(ifstream);
+    } catch(std::runtime_error& e) {
+        wxMessageDialog(this, "Invalid File", "", wxOK | wxCENTRE | wxICON_WARNING).ShowModal();
+        return;
+    }
+    closeComparison();
+    comparison = new WindowGrid(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, load);
+    comparison->readOnly = true;
+    windowGrid->compare(comparison, false);
+    comparison->compare(windowGrid, true);
+    comparison->setView(windowGrid->zoomLevels, windowGrid->GetViewStart());
+    wxSizeEvent resized{};
+    onSize(resized);
+}
+
+void FrameMain::closeComparison() {
+    if(!comparison) return;
+    windowGrid->compare(nullptr, false);
+    comparison->Destroy();
+    comparison = nullptr;
+    wxSizeEvent resized{};
+    onSize(resized);
+}
+
+std::string FrameMain::replay(const input::Log& log, WindowGrid::Renderer renderer) {
+    windowGrid->renderer = renderer;
+    Maximize(false);
+    SetClientSize(log.clientSize);
+    return input::replay(log, *this, *windowGrid);
+}
+
+uint64_t FrameMain::framesDrawn() const {
+    return windowGrid->framesDrawn;
+}
+
 bool FrameMain::confirmClose(const wxString& message) {
     wxMessageDialog dialog{this, message, "Unsaved work", wxYES_NO | wxICON_WARNING};
     return dialog.ShowModal() == wxID_YES;
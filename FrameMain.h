@@ -2,20 +2,33 @@
 #include <wx/wx.h>
 #include <filesystem>
 #include "WindowGrid.h"
+#include "InputLog.h"
 
 class FrameMain : public wxFrame {
 public:
     explicit FrameMain(const std::wstring& file = {});
+    //Sizes the window as it was when log was recorded and plays it back with renderer, returning the timings
+    std::string replay(const input::Log& log, WindowGrid::Renderer renderer = WindowGrid::Renderer::batched);
+    //Times the editor's grid has painted, so startup timing can tell when the first paint is done
+    uint64_t framesDrawn() const;
 private:
     void onSize(wxSizeEvent& evt);
     void onChar(wxKeyEvent& evt);
     void onSave(bool saveAs);
     void onLoad();
     void onNew();
+    void onExportSpice();
+    void onExportImage();
+    void onSaveTrace();
+    void onRecordInput();
+    void onCompare();
+    void closeComparison();
     void onClose(wxCloseEvent& evt);
     bool confirmClose(const wxString& message);
     wxToolBar* toolbar;
     wxMenuBar* menuBar;
     WindowGrid* windowGrid;
+    WindowGrid* comparison{nullptr}; //another file shown beside windowGrid, read only
     std::filesystem::path file{};
+    std::unique_ptr<input::Recorder> recorder{};
 };
\ No newline at end of file
@@ -1,10 +1,18 @@
 #include "Grid.h"
+#include "Profiler.h"
 #include <utility>
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 
-Grid::Grid(uint32_t width, uint32_t height, std::unordered_map<uint64_t, Item> gridMap) : width{width}, height{height},
-                                                                                gridMap{std::move(gridMap)} {}
+Grid::Grid(uint32_t width, uint32_t height, GridVersion gridMap) : width{width}, height{height}, gridMap{std::move(gridMap)} {
+    //Plain wires are never indexed, so the cells in runs that come after the tiles are not visited
+    for(auto iterator = this->gridMap.begin(); !iterator.pastTiles(); ++iterator) {
+        const auto& [key, item] = *iterator;
+        index.insert(key, item);
+    }
+    published.store(this->gridMap);
+}
 
 uint32_t Grid::getWidth() const {
     return width;
@@ -14,34 +22,163 @@ uint32_t Grid::getHeight() const {
     return height;
 }
 
+const GridIndex& Grid::getIndex() const {
+    return index;
+}
+
+GridVersion Grid::snapshot() const {
+    return published.load();
+}
+
+std::vector<std::pair<uint64_t, Item>> Grid::expandInstance(uint64_t key, const Item& instance) const {
+    std::vector<std::pair<uint64_t, Item>> cells{};
+    expandInto(key, instance, cells, 0);
+    return cells;
+}
+
+void Grid::expandInto(uint64_t key, const Item& instance, std::vector<std::pair<uint64_t, Item>>& cells, int depth) const {
+    constexpr int MAX_NESTING = 16; //also stops a sub-circuit that contains itself
+    auto iterator = subCircuits.find(instance.extraData);
+    if(iterator == subCircuits.end() || depth > MAX_NESTING) return;
+    const Block& block = iterator->second->block;
+    int turns = instance.shape & 3;
+    uint64_t row = key >> 32;
+    uint64_t col = static_cast<uint32_t>(key);
+    for(const auto& [offset, item] : block.cells) {
+        auto r = static_cast<uint32_t>(offset >> 32);
+        auto c = static_cast<uint32_t>(offset);
+        uint32_t blockHeight = block.height;
+        uint32_t blockWidth = block.width;
+        for(int i = 0; i < turns; i ++) { //a clockwise turn takes (r, c) in an h x w block to (c, h - 1 - r)
+            uint32_t turnedRow = c;
+            c = blockHeight - 1 - r;
+            r = turnedRow;
+            std::swap(blockHeight, blockWidth);
+        }
+        if(row + r >= height || col + c >= width) continue;
+        uint64_t target = ((row + r) << 32) | (col + c);
+        Item placed = item.rotated(turns);
+        if(placed.type == Item::ItemType::instance) {
+            expandInto(target, placed, cells, depth + 1);
+        } else {
+            cells.emplace_back(target, std::move(placed));
+        }
+    }
+}
+
+std::pair<uint32_t, uint32_t> Grid::instanceSize(const Item& instance) const {
+    auto iterator = subCircuits.find(instance.extraData);
+    if(iterator == subCircuits.end()) return {0, 0};
+    const Block& block = iterator->second->block;
+    return (instance.shape & 1) ? std::pair{block.width, block.height} : std::pair{block.height, block.width};
+}
+
 Item Grid::get(uint32_t row, uint32_t col) const {
     rangeCheck(row, col);
-    auto iterator = gridMap.find((static_cast<uint64_t>(row) << 32) | col);
-    if(iterator == gridMap.end()) {
-        return Item{};
-    }
-    return iterator->second;
+    const Item* item = gridMap.find((static_cast<uint64_t>(row) << 32) | col);
+    return item ? *item : Item{};
 }
 
 void Grid::set(uint32_t row, uint32_t col, const Item& item) {
-    Item previous = get(row, col);
-    uint64_t key = (static_cast<uint64_t>(row) << 32) | col;
-    if(item.type == Item::ItemType::none) {
-        gridMap.erase(key);
+    profiler::count(profiler::Counter::cells_set);
+    rangeCheck(row, col);
+    commit(gridMap.with({{(static_cast<uint64_t>(row) << 32) | col, item}}, [this](uint64_t key, const Item* before, const Item* after) {
+        indexChange(key, before, after);
+    }));
+}
+
+Block Grid::copy(uint32_t row, uint32_t col, uint32_t height, uint32_t width) const {
+    Block block{width, height, {}};
+    if(static_cast<uint64_t>(width) * height < gridMap.size()) {
+        for(uint32_t r = 0; r < height; r ++) {
+            for(uint32_t c = 0; c < width; c ++) {
+                const Item* item = gridMap.find((static_cast<uint64_t>(row + r) << 32) | (col + c));
+                if(item) {
+                    block.cells.emplace_back((static_cast<uint64_t>(r) << 32) | c, *item);
+                }
+            }
+        }
     } else {
-        gridMap[key] = item;
+        for(const auto& [key, item] : gridMap) {
+            auto r = static_cast<uint32_t>(key >> 32);
+            auto c = static_cast<uint32_t>(key);
+            if(r >= row && r - row < height && c >= col && c - col < width) {
+                block.cells.emplace_back((static_cast<uint64_t>(r - row) << 32) | (c - col), item);
+            }
+        }
+    }
+    return block;
+}
+
+void Grid::apply(std::vector<std::pair<uint64_t, Item>> changes) {
+    if(changes.empty()) return;
+    profiler::Scope scope{"Grid::apply"};
+    profiler::count(profiler::Counter::cells_set, static_cast<int64_t>(changes.size()));
+    for(const auto& change : changes) {
+        rangeCheck(static_cast<uint32_t>(change.first >> 32), static_cast<uint32_t>(change.first));
+    }
+    commit(gridMap.with(std::move(changes), [this](uint64_t key, const Item* before, const Item* after) {
+        indexChange(key, before, after);
+    }));
+}
+
+void Grid::replicate(const Block& block, uint32_t row, uint32_t col, uint32_t rows, uint32_t cols, uint32_t rowStride, uint32_t colStride) {
+    if(row >= height || col >= width) return;
+    //Copies starting past the edge would be clipped away whole, so they are never visited. A stride of 0 puts every
+    //copy on the first.
+    auto onGrid = [](uint32_t copies, uint32_t stride, uint32_t space) {
+        if(stride == 0) return std::min(copies, 1u);
+        return static_cast<uint32_t>(std::min<uint64_t>(copies, (static_cast<uint64_t>(space) + stride - 1) / stride));
+    };
+    rows = onGrid(rows, rowStride, height - row);
+    cols = onGrid(cols, colStride, width - col);
+    if(rows == 0 || cols == 0) return;
+    //Overlapping copies can make more changes than there are cells under them, so no more than those are reserved, and
+    //the block's cells can still take the number of changes past what a vector holds
+    std::vector<std::pair<uint64_t, Item>> changes{};
+    uint64_t copies = static_cast<uint64_t>(rows) * cols;
+    uint64_t covered = std::min<uint64_t>(height - row, (rows - 1) * static_cast<uint64_t>(rowStride) + block.height) *
+                       std::min<uint64_t>(width - col, (cols - 1) * static_cast<uint64_t>(colStride) + block.width);
+    if(block.cells.size() <= changes.max_size() / copies) {
+        changes.reserve(static_cast<size_t>(std::min<uint64_t>(block.cells.size() * copies, covered)));
     }
-    undoHistory[undoOperations] = {key, previous};
+    for(uint64_t copyRow = 0; copyRow < rows; copyRow ++) {
+        for(uint64_t copyCol = 0; copyCol < cols; copyCol ++) {
+            if(copyRow == 0 && copyCol == 0) continue;
+            uint64_t top = row + copyRow * rowStride;
+            uint64_t left = col + copyCol * colStride;
+            for(const auto& [key, item] : block.cells) {
+                uint64_t r = top + (key >> 32);
+                uint64_t c = left + static_cast<uint32_t>(key);
+                if(r < height && c < width) {
+                    changes.emplace_back((r << 32) | c, item);
+                }
+            }
+        }
+    }
+    apply(std::move(changes));
+}
+
+//The current version becomes an undo step, and next is published
+void Grid::commit(GridVersion next) {
+    undoHistory[undoOperations] = std::move(gridMap);
+    gridMap = std::move(next);
+    published.store(gridMap);
     undoOperations ++;
     redoOperations = 0;
     if(undoOperations == 100) {
         for(int i = 0; i < 99; i ++) {
-            undoHistory[i] = undoHistory[i + 1];
+            undoHistory[i] = std::move(undoHistory[i + 1]);
         }
         undoOperations = 99;
     }
 }
 
+void Grid::indexChange(uint64_t key, const Item* before, const Item* after) {
+    if(before) index.erase(key, *before);
+    if(after) index.insert(key, *after);
+}
+
 void Grid::rangeCheck(uint32_t row, uint32_t col) const {
     if (row > height || col > width) {
         throw std::out_of_range(
@@ -50,30 +187,43 @@ void Grid::rangeCheck(uint32_t row, uint32_t col) const {
     }
 }
 
-//swap the current state of the map and operation.second at operation.first
-void Grid::doOperation(std::pair<uint64_t, Item> &operation) {
-    std::pair<uint64_t, Item> operationCopy = operation;
-    auto iterator = gridMap.find(operation.first);
-    if(iterator == gridMap.end()) {
-        operation = {operation.first, Item{}};
-        if(operationCopy.second.type != Item::ItemType::none) {
-            gridMap[operation.first] = operationCopy.second;
-        }
-    } else {
-        operation = {operation.first, iterator->second};
-        if(operationCopy.second.type == Item::ItemType::none) {
-            gridMap.erase(iterator);
-        } else {
-            gridMap[operation.first] = operationCopy.second;
+memory::Report Grid::memoryUsage() const {
+    memory::Report report{};
+    report.occupiedCells = gridMap.size();
+    //Undo steps share most of their tiles with the current version, and only count what is theirs alone
+    std::unordered_set<const void*> seen{};
+    report.cells = gridMap.memoryUsage(seen);
+    //Labels and values that do not fit a float are kept in tables every grid shares, which only grow, so only the
+    //entries of this grid's cells and sub-circuits are counted
+    std::unordered_set<uint64_t> entries{};
+    for(const auto& [key, item] : gridMap) {
+        report.labels += item.tableBytes(entries);
+    }
+    for(const auto& [name, subCircuit] : subCircuits) {
+        for(const auto& [key, item] : subCircuit->block.cells) {
+            report.labels += item.tableBytes(entries);
         }
     }
+    report.index = index.memoryUsage();
+    for(const GridVersion& version : undoHistory) {
+        report.undo += version.memoryUsage(seen);
+    }
+    for(const auto& [name, subCircuit] : subCircuits) {
+        report.subCircuits += sizeof(SubCircuit) + memory::heapBytes(subCircuit->name) + subCircuit->block.cells.capacity() * sizeof(subCircuit->block.cells[0]);
+    }
+    return report;
 }
 
 bool Grid::undo() {
     if(undoOperations > 0) {
         undoOperations --;
         redoOperations ++;
-        doOperation(undoHistory[undoOperations]);
+        GridVersion& step = undoHistory[undoOperations];
+        gridMap.diff(step, [this](uint64_t key, const Item* before, const Item* after) {
+            indexChange(key, before, after);
+        });
+        std::swap(gridMap, step);
+        published.store(gridMap);
         return true;
     }
     return false;
@@ -81,10 +231,15 @@ bool Grid::undo() {
 
 bool Grid::redo() {
     if(redoOperations > 0) {
-        doOperation(undoHistory[undoOperations]);
+        GridVersion& step = undoHistory[undoOperations];
+        gridMap.diff(step, [this](uint64_t key, const Item* before, const Item* after) {
+            indexChange(key, before, after);
+        });
+        std::swap(gridMap, step);
+        published.store(gridMap);
         redoOperations --;
         undoOperations ++;
         return true;
     }
     return false;
-}
+}
\ No newline at end of file
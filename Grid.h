@@ -1,24 +1,68 @@
 #pragma once
 #include <unordered_map>
+#include <map>
+#include <vector>
+#include <memory>
 #include "Item.h"
+#include "GridIndex.h"
+#include "GridVersion.h"
+#include "Memory.h"
+
+//Occupied cells of a rectangular region, keyed relative to its top left corner
+struct Block {
+    uint32_t width{0};
+    uint32_t height{0};
+    std::vector<std::pair<uint64_t, Item>> cells;
+};
+
+//Named block placed by instance items. Every instance shares the one definition, so a copy costs one cell.
+struct SubCircuit {
+    std::wstring name;
+    Block block;
+};
 
 class Grid {
     uint32_t width;
     uint32_t height;
     void rangeCheck(uint32_t row, uint32_t col) const;
-    std::pair<uint64_t, Item> undoHistory[100];
+    void commit(GridVersion next);
+    void indexChange(uint64_t key, const Item* before, const Item* after);
+    void expandInto(uint64_t key, const Item& instance, std::vector<std::pair<uint64_t, Item>>& cells, int depth) const;
+    //Version before each undo step. Undo swaps it with the current version, leaving what redo needs in its place.
+    GridVersion undoHistory[100];
     int undoOperations{0};
     int redoOperations{0};
+    GridIndex index;
+    PublishedVersion published;
 public:
-    //Using map with uint64_t key as an efficient 2d array with a large number of elements
-    std::unordered_map<uint64_t, Item> gridMap;
-    explicit Grid(uint32_t width = 100, uint32_t height = 100, std::unordered_map<uint64_t,Item> gridMap = {});
+    //The occupied cells, keyed by row << 32 | col. Changes should go through set or apply, which keep the index up to
+    //date and publish each new version for other threads.
+    GridVersion gridMap;
+    //Definitions of the sub-circuits instance items refer to, by name
+    std::map<std::wstring, std::shared_ptr<const SubCircuit>> subCircuits;
+    explicit Grid(uint32_t width = 100, uint32_t height = 100, GridVersion gridMap = {});
     //Using get-set instead of operator[][], because maps would create an empty item with [][] for a new key
     Item get(uint32_t row, uint32_t col) const;
     void set(uint32_t row, uint32_t col, const Item& item);
+    //Only looks at whichever is smaller out of the region and the occupied cells
+    Block copy(uint32_t row, uint32_t col, uint32_t height, uint32_t width) const;
+    //Sets many cells as a single undo step. Items of type none clear their cell, a later change to the same key wins.
+    void apply(std::vector<std::pair<uint64_t, Item>> changes);
+    //Places copies of block on a rows x cols lattice with its first copy at (row, col), leaving that first copy
+    //alone as it is normally where the block came from. Copies are clipped to the grid. One undo step.
+    void replicate(const Block& block, uint32_t row, uint32_t col, uint32_t rows, uint32_t cols, uint32_t rowStride, uint32_t colStride);
     uint32_t getWidth() const;
     uint32_t getHeight() const;
-    void doOperation(std::pair<uint64_t, Item>& operation);
+    const GridIndex& getIndex() const;
+    //The cells as of the last change. Safe to call from any thread, and the version returned never changes.
+    GridVersion snapshot() const;
+    //Cells placed by the instance item at key, turned and moved into position and clipped to the grid.
+    //Instances inside the sub-circuit are expanded too. Empty if the sub-circuit is not defined.
+    std::vector<std::pair<uint64_t, Item>> expandInstance(uint64_t key, const Item& instance) const;
+    //Rows and columns the instance covers once turned, zero if its sub-circuit is not defined
+    std::pair<uint32_t, uint32_t> instanceSize(const Item& instance) const;
+    //Everything but bitmaps and clipboard, which belong to the window
+    memory::Report memoryUsage() const;
     bool undo();
     bool redo();
 };
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "GridIndex.h"
+#include <algorithm>
+#include <cwctype>
+#include <atomic>
+
+size_t GridIndex::KeySet::slot(uint64_t key) const {
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & (slots.size() - 1);
+}
+
+void GridIndex::KeySet::grow() {
+    std::vector<uint64_t> old = std::move(slots);
+    size_t size = 16;
+    while(size < count * 4) size *= 2; //a quarter full, so the set can double before growing again
+    slots.assign(size, EMPTY);
+    used = count;
+    for(uint64_t key : old) {
+        if(key == EMPTY || key == ERASED) continue;
+        size_t i = slot(key);
+        while(slots[i] != EMPTY) i = (i + 1) & (slots.size() - 1);
+        slots[i] = key;
+    }
+}
+
+void GridIndex::KeySet::insert(uint64_t key) {
+    if((used + 1) * 2 > slots.size()) grow();
+    size_t i = slot(key);
+    size_t freeSlot = slots.size();
+    while(slots[i] != EMPTY) {
+        if(slots[i] == key) return;
+        if(slots[i] == ERASED && freeSlot == slots.size()) freeSlot = i;
+        i = (i + 1) & (slots.size() - 1);
+    }
+    if(freeSlot == slots.size()) {
+        freeSlot = i;
+        used ++;
+    }
+    slots[freeSlot] = key;
+    count ++;
+}
+
+void GridIndex::KeySet::erase(uint64_t key) {
+    if(slots.empty()) return;
+    size_t i = slot(key);
+    while(slots[i] != EMPTY) {
+        if(slots[i] == key) {
+            slots[i] = ERASED;
+            count --;
+            return;
+        }
+        i = (i + 1) & (slots.size() - 1);
+    }
+}
+
+bool GridIndex::KeySet::empty() const {
+    return count == 0;
+}
+
+void GridIndex::KeySet::appendTo(std::vector<uint64_t>& result) const {
+    for(uint64_t key : slots) {
+        if(key != EMPTY && key != ERASED) result.push_back(key);
+    }
+}
+
+size_t GridIndex::KeySet::memoryUsage() const {
+    return slots.capacity() * sizeof(uint64_t);
+}
+
+bool GridIndex::hasValue(const Item& item) {
+    const components::Component* part = components::find(item.type);
+    return part != nullptr && part->unit != 0 && item.extraData.empty();
+}
+
+//Shared by every index, since a grid can be replaced by one loaded or built elsewhere
+uint64_t GridIndex::nextStamp() {
+    static std::atomic<uint64_t> stamps{0};
+    return stamps.fetch_add(1) + 1;
+}
+
+std::wstring GridIndex::fold(const std::wstring& text) {
+    std::wstring folded = text;
+    std::transform(folded.begin(), folded.end(), folded.begin(), [](wchar_t c) {return static_cast<wchar_t>(std::towlower(c));});
+    return folded;
+}
+
+void GridIndex::insert(uint64_t key, const Item& item) {
+    if(item.type == Item::ItemType::none) return;
+    if(!item.extraData.empty()) {
+        labels[fold(item.extraData)].insert(key);
+    }
+    if(hasValue(item)) {
+        values[static_cast<int>(item.type)][item.value].insert(key);
+    }
+    if(item.type == Item::ItemType::instance) {
+        instances.insert(key);
+        instanceStamp = nextStamp();
+    }
+}
+
+void GridIndex::erase(uint64_t key, const Item& item) {
+    if(item.type == Item::ItemType::none) return;
+    if(!item.extraData.empty()) {
+        auto iterator = labels.find(fold(item.extraData));
+        if(iterator != labels.end()) {
+            iterator->second.erase(key);
+            if(iterator->second.empty()) labels.erase(iterator);
+        }
+    }
+    if(hasValue(item)) {
+        Map<double>& byValue = values[static_cast<int>(item.type)];
+        auto iterator = byValue.find(item.value);
+        if(iterator != byValue.end()) {
+            iterator->second.erase(key);
+            if(iterator->second.empty()) byValue.erase(iterator);
+        }
+    }
+    if(item.type == Item::ItemType::instance) {
+        instances.erase(key);
+        instanceStamp = instances.empty() ? 0 : nextStamp();
+    }
+}
+
+std::vector<uint64_t> GridIndex::findLabel(const std::wstring& text) const {
+    std::wstring prefix = fold(text);
+    std::vector<uint64_t> result{};
+    for(auto iterator = labels.lower_bound(prefix); iterator != labels.end() && iterator->first.compare(0, prefix.size(), prefix) == 0; iterator ++) {
+        iterator->second.appendTo(result);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<uint64_t> GridIndex::findValue(Item::ItemType type, double min, double max) const {
+    std::vector<uint64_t> result{};
+    const Map<double>& byValue = values[static_cast<int>(type)];
+    for(auto iterator = byValue.lower_bound(min); iterator != byValue.end() && iterator->first <= max; iterator ++) {
+        iterator->second.appendTo(result);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<uint64_t> GridIndex::getInstances() const {
+    std::vector<uint64_t> result{};
+    instances.appendTo(result);
+    return result;
+}
+
+uint64_t GridIndex::getInstanceStamp() const {
+    return instanceStamp;
+}
+
+size_t GridIndex::memoryUsage() const {
+    size_t bytes = labels.get_allocator().allocated() + instances.memoryUsage();
+    for(const auto& [label, keys] : labels) {
+        bytes += memory::heapBytes(label) + keys.memoryUsage();
+    }
+    for(const auto& byValue : values) {
+        bytes += byValue.get_allocator().allocated();
+        for(const auto& [value, keys] : byValue) {
+            bytes += keys.memoryUsage();
+        }
+    }
+    return bytes;
+}
\ No newline at end of file
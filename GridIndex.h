@@ -0,0 +1,53 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <string>
+#include "Item.h"
+#include "Memory.h"
+#include "Components.h"
+
+//Inverted indices over the labels and component values of a Grid, updated by Grid as cells change so a search
+//never has to scan the whole map
+class GridIndex {
+public:
+    void insert(uint64_t key, const Item& item);
+    void erase(uint64_t key, const Item& item);
+    //Cells whose label starts with text, ignoring case, in row-major order
+    std::vector<uint64_t> findLabel(const std::wstring& text) const;
+    //Cells of the given type with a numeric value in [min, max], in row-major order
+    std::vector<uint64_t> findValue(Item::ItemType type, double min, double max) const;
+    //Cells holding sub-circuit instances, in no particular order
+    std::vector<uint64_t> getInstances() const;
+    //Changes each time an instance is placed or removed, and is never the same for two different sets of instances,
+    //even across indices, so a cache of where instances lie can tell when it is out of date
+    uint64_t getInstanceStamp() const;
+    size_t memoryUsage() const;
+private:
+    //Open addressing set of cell keys. Replicated blocks put millions of cells under one value, and a node based
+    //set spends most of a bulk insert allocating.
+    class KeySet {
+    public:
+        void insert(uint64_t key);
+        void erase(uint64_t key);
+        bool empty() const;
+        void appendTo(std::vector<uint64_t>& result) const;
+        size_t memoryUsage() const;
+    private:
+        constexpr static uint64_t EMPTY = ~0ull; //no cell has this key, grids are far smaller than 2^32 square
+        constexpr static uint64_t ERASED = ~0ull - 1;
+        size_t slot(uint64_t key) const;
+        void grow();
+        std::vector<uint64_t> slots;
+        size_t count{0};
+        size_t used{0}; //count plus erased slots
+    };
+    template<typename Key>
+    using Map = std::map<Key, KeySet, std::less<Key>, memory::Allocator<std::pair<const Key, KeySet>>>;
+    static bool hasValue(const Item& item);
+    static std::wstring fold(const std::wstring& text);
+    static uint64_t nextStamp();
+    Map<std::wstring> labels;
+    std::vector<Map<double>> values = std::vector<Map<double>>(components::limit()); //by type
+    KeySet instances;
+    uint64_t instanceStamp{0}; //0 while there have been no instances
+};
@@ -0,0 +1,822 @@
+#include "GridVersion.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <stdexcept>
+#include <exception>
+
+namespace {
+    constexpr uint64_t TILE_MASK = (7ull << 32) | 7; //row and column within a tile
+
+    //Bytes of the last block allocated for Of, shared_ptr control block included
+    template<typename Of>
+    std::atomic<size_t> blockBytes{0};
+
+    //Allocates tiles and nodes together with their control blocks, noting the size so memoryUsage counts what was
+    //really allocated rather than sizeof
+    template<typename T, typename Of>
+    struct BlockAllocator {
+        using value_type = T;
+        BlockAllocator() = default;
+        template<typename U>
+        BlockAllocator(const BlockAllocator<U, Of>&) noexcept {}
+        T* allocate(size_t n) {
+            blockBytes<Of>.store(n * sizeof(T), std::memory_order_relaxed);
+            return std::allocator<T>{}.allocate(n);
+        }
+        void deallocate(T* pointer, size_t n) noexcept {
+            std::allocator<T>{}.deallocate(pointer, n);
+        }
+        template<typename U>
+        bool operator==(const BlockAllocator<U, Of>&) const noexcept {
+            return true;
+        }
+    };
+
+    template<typename T>
+    std::shared_ptr<T> makeBlock() {
+        return std::allocate_shared<T>(BlockAllocator<T, T>{});
+    }
+
+    int slot(uint64_t key) {
+        return static_cast<int>(((key >> 32) & 7) * 8 + (key & 7));
+    }
+
+    //Six bits of the hash per level, from the top, so changes sorted by hash are also sorted at every level.
+    //Level 10 takes the last four.
+    int childIndex(uint64_t hash, int level) {
+        int shift = 58 - 6 * level;
+        return static_cast<int>((shift >= 0 ? hash >> shift : hash << -shift) & 63);
+    }
+
+    bool same(const Item& a, const Item& b) {
+        return a.type == b.type && a.shape == b.shape && a.value == b.value && a.extraData == b.extraData;
+    }
+
+    //The item find gives for a cell in runs, one per shape
+    const Item& wireItem(int shape) {
+        static const std::array<Item, 16> items = [] {
+            std::array<Item, 16> wires{};
+            for(int i = 0; i < 16; i ++) {
+                wires[i] = Item{Item::ItemType::wire, i, 0};
+            }
+            return wires;
+        }();
+        return items[shape];
+    }
+
+    const GridVersion::Lines& linesOf(const std::shared_ptr<const GridVersion::Lines>& lines) {
+        static const GridVersion::Lines none{};
+        return lines ? *lines : none;
+    }
+
+    const GridVersion::Runs* findLine(const GridVersion::Lines& lines, uint32_t at) {
+        auto line = std::lower_bound(lines.begin(), lines.end(), at, [](const auto& line, uint32_t at) {return line.first < at;});
+        return line != lines.end() && line->first == at ? line->second.get() : nullptr;
+    }
+
+    bool covered(const GridVersion::Runs& runs, uint32_t piece) {
+        auto run = std::upper_bound(runs.begin(), runs.end(), piece, [](uint32_t piece, const GridVersion::Run& run) {return piece < run.first;});
+        return run != runs.begin() && (run - 1)->second > piece;
+    }
+
+    //Bit 0 for the first half of the cell along the line, bit 1 for the second
+    int halves(const GridVersion::Lines& lines, uint32_t at, uint32_t cell) {
+        const GridVersion::Runs* runs = findLine(lines, at);
+        if(runs == nullptr) return 0;
+        return (covered(*runs, 2 * cell) ? 1 : 0) | (covered(*runs, 2 * cell + 1) ? 2 : 0);
+    }
+
+    //runs with each piece, in order and none twice, set or cleared. Runs that touch are joined.
+    GridVersion::Runs setPieces(const GridVersion::Runs& runs, const std::vector<std::pair<uint32_t, bool>>& pieces) {
+        GridVersion::Runs result{};
+        result.reserve(runs.size() + pieces.size());
+        auto add = [&result](uint32_t first, uint32_t second) {
+            if(first >= second) return;
+            if(!result.empty() && result.back().second >= first) {
+                result.back().second = std::max(result.back().second, second);
+            } else {
+                result.emplace_back(first, second);
+            }
+        };
+        size_t run = 0;
+        uint32_t done = 0; //everything before is in result
+        for(auto [piece, on] : pieces) {
+            for(; run < runs.size() && runs[run].second <= piece; run ++) {
+                add(std::max(runs[run].first, done), runs[run].second);
+            }
+            if(run < runs.size() && runs[run].first < piece) add(std::max(runs[run].first, done), piece);
+            if(on) add(piece, piece + 1);
+            done = piece + 1;
+        }
+        for(; run < runs.size(); run ++) {
+            add(std::max(runs[run].first, done), runs[run].second);
+        }
+        return result;
+    }
+
+    //Calls differ with each stretch of pieces [from, to) covered by one of a and b but not the other
+    template<typename Differ>
+    void runDifferences(const GridVersion::Runs& a, const GridVersion::Runs& b, Differ differ) {
+        std::vector<uint32_t> bounds{};
+        bounds.reserve(2 * (a.size() + b.size()));
+        for(const GridVersion::Runs* runs : {&a, &b}) {
+            for(auto [first, second] : *runs) {
+                bounds.push_back(first);
+                bounds.push_back(second);
+            }
+        }
+        std::sort(bounds.begin(), bounds.end());
+        bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+        for(size_t i = 0; i + 1 < bounds.size(); i ++) {
+            if(covered(a, bounds[i]) != covered(b, bounds[i])) differ(bounds[i], bounds[i + 1]);
+        }
+    }
+}
+
+struct GridVersion::Change {
+    uint64_t hash;
+    uint16_t slot;
+    uint16_t runBefore; //shape runs gave the cell before
+    uint32_t index; //into the list of changes
+};
+
+GridVersion::GridVersion(std::shared_ptr<const Node> root, std::shared_ptr<const Lines> rows, std::shared_ptr<const Lines> columns, size_t wires,
+                         uint64_t runDigest) : root{std::move(root)}, rows{std::move(rows)}, columns{std::move(columns)}, wires{wires}, runDigest{runDigest} {}
+
+//The finalizer of splitmix64. It is a bijection, so tiles never collide and two tiles always part by level 10.
+uint64_t GridVersion::hash(uint64_t origin) {
+    origin ^= origin >> 30;
+    origin *= 0xBF58476D1CE4E5B9ull;
+    origin ^= origin >> 27;
+    origin *= 0x94D049BB133111EBull;
+    return origin ^ (origin >> 31);
+}
+
+uint64_t GridVersion::cellDigest(uint64_t key, const Item& item) {
+    return hash(hash(key) + item.hash());
+}
+
+uint64_t GridVersion::lineDigest(uint32_t at, bool vertical, const Runs& runs) {
+    uint64_t digest = hash((static_cast<uint64_t>(at) << 1) | (vertical ? 1 : 0));
+    for(auto [first, second] : runs) {
+        digest = hash(digest + ((static_cast<uint64_t>(first) << 32) | second));
+    }
+    return digest;
+}
+
+uint64_t GridVersion::digestOf(const Child& child) {
+    return child.node ? child.node->digest : child.tile ? child.tile->digest : 0;
+}
+
+uint64_t GridVersion::digest() const {
+    return (root ? root->digest : 0) ^ runDigest;
+}
+
+size_t GridVersion::size() const {
+    return (root ? root->count : 0) + wires;
+}
+
+bool GridVersion::empty() const {
+    return !root && wires == 0;
+}
+
+bool GridVersion::inRuns(const Item& item) {
+    return item.type == Item::ItemType::wire && item.shape > 0 && item.shape < 16 && item.value == 0 && item.extraData.empty();
+}
+
+const GridVersion::Lines& GridVersion::rowRuns() const {
+    return linesOf(rows);
+}
+
+const GridVersion::Lines& GridVersion::columnRuns() const {
+    return linesOf(columns);
+}
+
+size_t GridVersion::runCells() const {
+    return wires;
+}
+
+const Item* GridVersion::find(uint64_t key) const {
+    const Item* item = findInTiles(key);
+    if(item != nullptr || wires == 0) return item;
+    int shape = runShape(key);
+    return shape != 0 ? &wireItem(shape) : nullptr;
+}
+
+int GridVersion::runShape(uint64_t key) const {
+    auto row = static_cast<uint32_t>(key >> 32);
+    auto col = static_cast<uint32_t>(key);
+    int across = halves(rowRuns(), row, col);
+    int down = halves(columnRuns(), col, row);
+    return ((across & 1) ? Item::LEFT : 0) | ((across & 2) ? Item::RIGHT : 0) | ((down & 1) ? Item::UP : 0) | ((down & 2) ? Item::DOWN : 0);
+}
+
+const Item* GridVersion::findInTiles(uint64_t key) const {
+    uint64_t origin = key & ~TILE_MASK;
+    uint64_t tileHash = hash(origin);
+    const Node* node = root.get();
+    for(int level = 0; node != nullptr; level ++) {
+        uint64_t bit = 1ull << childIndex(tileHash, level);
+        if(!(node->bitmap & bit)) return nullptr;
+        const Child& child = node->children[std::popcount(node->bitmap & (bit - 1))];
+        if(child.tile) {
+            if(child.tile->origin != origin) return nullptr;
+            uint64_t cell = 1ull << slot(key);
+            if(!(child.tile->occupied & cell)) return nullptr;
+            return &child.tile->items[std::popcount(child.tile->occupied & (cell - 1))];
+        }
+        node = child.node.get();
+    }
+    return nullptr;
+}
+
+GridVersion::Iterator GridVersion::begin() const {
+    Iterator iterator{};
+    iterator.version = this;
+    if(root) {
+        iterator.stack.emplace_back(root.get(), 0);
+    }
+    iterator.nextTile();
+    return iterator;
+}
+
+GridVersion::Iterator GridVersion::end() const {
+    return Iterator{};
+}
+
+void GridVersion::Iterator::nextTile() {
+    tile = nullptr;
+    remaining = 0;
+    item = 0;
+    while(!stack.empty()) {
+        auto& [node, index] = stack.back();
+        if(index == node->children.size()) {
+            stack.pop_back();
+            continue;
+        }
+        const Child& child = node->children[index ++];
+        if(child.tile) {
+            tile = child.tile.get();
+            remaining = tile->occupied;
+            return;
+        }
+        stack.emplace_back(child.node.get(), 0);
+    }
+    nextRunCell();
+}
+
+std::pair<uint64_t, const Item&> GridVersion::Iterator::runCell() const {
+    uint64_t at = (vertical ? version->columnRuns() : version->rowRuns())[line].first;
+    uint64_t key = vertical ? (static_cast<uint64_t>(cell) << 32) | at : (at << 32) | cell;
+    return {key, wireItem(version->runShape(key))};
+}
+
+//Moves on to the first cell in runs from the current one that has not been visited
+void GridVersion::Iterator::nextRunCell() {
+    while(version != nullptr) {
+        const Lines& lines = vertical ? version->columnRuns() : version->rowRuns();
+        if(line == lines.size()) {
+            if(vertical) {
+                version = nullptr;
+            } else {
+                vertical = true;
+            }
+            line = 0;
+            run = 0;
+            cell = 0;
+            continue;
+        }
+        const Runs& runs = *lines[line].second;
+        if(run == runs.size()) {
+            line ++;
+            run = 0;
+            cell = 0;
+            continue;
+        }
+        cell = std::max(cell, runs[run].first / 2);
+        if(cell > (runs[run].second - 1) / 2) {
+            run ++;
+        } else if(vertical && halves(version->rowRuns(), cell, lines[line].first) != 0) {
+            cell ++; //visited along its row
+        } else {
+            return;
+        }
+    }
+    *this = Iterator{};
+}
+
+GridVersion GridVersion::with(std::vector<std::pair<uint64_t, Item>> changes, const Changed& changed) const {
+    if(changes.empty()) return *this;
+    std::vector<Change> order(changes.size());
+    for(size_t i = 0; i < changes.size(); i ++) {
+        order[i] = Change{hash(changes[i].first & ~TILE_MASK), static_cast<uint16_t>(slot(changes[i].first)), 0, static_cast<uint32_t>(i)};
+    }
+    Change* kept = keepLast(order.data(), order.data() + order.size());
+    //Cells whose wire joins or leaves the runs. The tiles only see such a wire as an empty cell.
+    std::vector<std::pair<uint64_t, int>> runChanges{};
+    ptrdiff_t joined = findRunChanges(order.data(), kept, changes, runChanges);
+    GridVersion next{updateNode(root, order.data(), kept, 0, changes, changed), rows, columns, static_cast<size_t>(static_cast<ptrdiff_t>(wires) + joined), runDigest};
+    if(!runChanges.empty()) {
+        next.rows = updateLines(rows, runChanges, false, next.runDigest);
+        next.columns = updateLines(columns, runChanges, true, next.runDigest);
+    }
+    return next;
+}
+
+//Changes under different children of the root share no tile and no node, so once they are apart each child's can be
+//sorted and made on its own, and only the root is put together afterwards
+GridVersion GridVersion::with(std::vector<std::pair<uint64_t, Item>> changes, ThreadPool& pool) const {
+    if(changes.empty()) return *this;
+    std::vector<Change> unordered(changes.size());
+    std::array<size_t, 65> starts{};
+    for(size_t i = 0; i < changes.size(); i ++) {
+        unordered[i] = Change{hash(changes[i].first & ~TILE_MASK), static_cast<uint16_t>(slot(changes[i].first)), 0, static_cast<uint32_t>(i)};
+        starts[childIndex(unordered[i].hash, 0) + 1] ++;
+    }
+    for(int index = 0; index < 64; index ++) {
+        starts[index + 1] += starts[index];
+    }
+    std::vector<Change> order(changes.size());
+    std::array<size_t, 64> placed{};
+    std::copy(starts.begin(), starts.end() - 1, placed.begin());
+    for(const Change& change : unordered) {
+        order[placed[childIndex(change.hash, 0)] ++] = change;
+    }
+    unordered = std::vector<Change>{};
+
+    //Tasks must not throw, so each keeps what it threw, by child and then the two line tasks, for after the wait
+    std::array<std::exception_ptr, 66> failures{};
+    auto submit = [&pool, &failures](size_t task, auto work) {
+        pool.submit([&failures, task, work] {
+            try {
+                work();
+            } catch(...) {
+                failures[task] = std::current_exception();
+            }
+        });
+    };
+    auto rethrow = [&failures] {
+        for(const std::exception_ptr& failure : failures) {
+            if(failure) std::rethrow_exception(failure);
+        }
+    };
+    std::array<Change*, 64> kept{};
+    std::array<std::vector<std::pair<uint64_t, int>>, 64> runChanges{};
+    std::array<ptrdiff_t, 64> joined{};
+    for(int index = 0; index < 64; index ++) {
+        if(starts[index] == starts[index + 1]) continue;
+        submit(index, [&, index] {
+            kept[index] = keepLast(order.data() + starts[index], order.data() + starts[index + 1]);
+            joined[index] = findRunChanges(order.data() + starts[index], kept[index], changes, runChanges[index]);
+        });
+    }
+    pool.wait();
+    rethrow();
+    std::vector<std::pair<uint64_t, int>> allRunChanges{};
+    ptrdiff_t allJoined = 0;
+    for(int index = 0; index < 64; index ++) {
+        allRunChanges.insert(allRunChanges.end(), runChanges[index].begin(), runChanges[index].end());
+        allJoined += joined[index];
+    }
+
+    auto existing = [this](int index) {
+        uint64_t bit = 1ull << index;
+        return root && (root->bitmap & bit) ? root->children[std::popcount(root->bitmap & (bit - 1))] : Child{};
+    };
+    std::array<Child, 64> children{};
+    for(int index = 0; index < 64; index ++) {
+        if(starts[index] == starts[index + 1]) continue;
+        submit(index, [&, index] {
+            children[index] = update(existing(index), order.data() + starts[index], kept[index], 1, changes, nullptr);
+        });
+    }
+    GridVersion next{nullptr, rows, columns, static_cast<size_t>(static_cast<ptrdiff_t>(wires) + allJoined), runDigest};
+    uint64_t columnDigest = 0;
+    if(!allRunChanges.empty()) {
+        submit(64, [&] {
+            next.rows = updateLines(rows, allRunChanges, false, next.runDigest);
+        });
+        submit(65, [&] {
+            next.columns = updateLines(columns, allRunChanges, true, columnDigest);
+        });
+    }
+    pool.wait();
+    rethrow();
+    next.runDigest ^= columnDigest;
+
+    auto updated = makeBlock<Node>();
+    bool unchanged = true;
+    for(int index = 0; index < 64; index ++) {
+        Child child = existing(index);
+        if(starts[index] != starts[index + 1]) {
+            unchanged = unchanged && children[index].node == child.node && children[index].tile == child.tile;
+            child = std::move(children[index]);
+        }
+        append(*updated, 1ull << index, std::move(child));
+    }
+    next.root = unchanged ? root : updated->children.empty() ? nullptr : std::move(updated);
+    return next;
+}
+
+GridVersion GridVersion::ofRuns(std::vector<std::pair<uint32_t, Runs>> rows, std::vector<std::pair<uint32_t, Runs>> columns, uint32_t width, uint32_t height) {
+    GridVersion version{};
+    for(bool vertical : {false, true}) {
+        auto& given = vertical ? columns : rows;
+        if(given.empty()) continue;
+        //Counting the wires walks every piece, so runs off the grid are refused before they can make that take forever
+        const uint32_t lineCount = vertical ? width : height;
+        const uint64_t pieces = 2 * static_cast<uint64_t>(vertical ? height : width);
+        auto lines = makeBlock<Lines>();
+        lines->reserve(given.size());
+        for(auto& [at, runs] : given) {
+            if(runs.empty() || (!lines->empty() && lines->back().first >= at)) {
+                throw std::invalid_argument{"Lines out of order"};
+            }
+            if(at >= lineCount || runs.back().second > pieces) {
+                throw std::invalid_argument{"Runs off the grid"};
+            }
+            for(size_t i = 0; i < runs.size(); i ++) {
+                if(runs[i].first >= runs[i].second || (i > 0 && runs[i - 1].second >= runs[i].first)) {
+                    throw std::invalid_argument{"Runs out of order"};
+                }
+            }
+            version.runDigest ^= lineDigest(at, vertical, runs);
+            auto block = makeBlock<Runs>();
+            *block = std::move(runs);
+            lines->emplace_back(at, std::move(block));
+        }
+        (vertical ? version.columns : version.rows) = std::move(lines);
+    }
+    //Runs along a row never share a cell, so only cells that runs reach both ways need looking up
+    for(const auto& [row, runs] : version.rowRuns()) {
+        for(auto [first, second] : *runs) {
+            version.wires += (second - 1) / 2 - first / 2 + 1;
+        }
+    }
+    for(const auto& [column, runs] : version.columnRuns()) {
+        for(auto [first, second] : *runs) {
+            for(uint32_t row = first / 2; row <= (second - 1) / 2; row ++) {
+                if(halves(version.rowRuns(), row, column) == 0) version.wires ++;
+            }
+        }
+    }
+    return version;
+}
+
+GridVersion::Change* GridVersion::keepLast(Change* begin, Change* end) {
+    std::sort(begin, end, [](const Change& a, const Change& b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.slot != b.slot ? a.slot < b.slot : a.index < b.index;
+    });
+    Change* kept = begin;
+    for(Change* change = begin; change != end; change ++) {
+        if(change + 1 != end && (change + 1)->hash == change->hash && (change + 1)->slot == change->slot) continue;
+        *kept ++ = *change;
+    }
+    return kept;
+}
+
+ptrdiff_t GridVersion::findRunChanges(Change* begin, Change* end, const std::vector<std::pair<uint64_t, Item>>& changes,
+                                      std::vector<std::pair<uint64_t, int>>& runChanges) const {
+    ptrdiff_t joined = 0;
+    for(Change* change = begin; change != end; change ++) {
+        const auto& [key, item] = changes[change->index];
+        int before = wires != 0 ? runShape(key) : 0;
+        int after = inRuns(item) ? item.shape : 0;
+        change->runBefore = static_cast<uint16_t>(before);
+        if(before == after) continue;
+        runChanges.emplace_back(key, after);
+        joined += (after != 0 ? 1 : 0) - (before != 0 ? 1 : 0);
+    }
+    return joined;
+}
+
+//lines with the halves of each cell along them set to the cell's shape, 0 to clear it. digest follows the lines changed.
+std::shared_ptr<const GridVersion::Lines> GridVersion::updateLines(const std::shared_ptr<const Lines>& lines, const std::vector<std::pair<uint64_t, int>>& cells,
+                                                                   bool vertical, uint64_t& digest) {
+    struct Piece {
+        uint32_t line;
+        uint32_t piece;
+        bool on;
+    };
+    std::vector<Piece> pieces{};
+    pieces.reserve(2 * cells.size());
+    for(auto [key, shape] : cells) {
+        auto row = static_cast<uint32_t>(key >> 32);
+        auto col = static_cast<uint32_t>(key);
+        uint32_t along = vertical ? row : col;
+        pieces.push_back(Piece{vertical ? col : row, 2 * along, (shape & (vertical ? Item::UP : Item::LEFT)) != 0});
+        pieces.push_back(Piece{vertical ? col : row, 2 * along + 1, (shape & (vertical ? Item::DOWN : Item::RIGHT)) != 0});
+    }
+    std::sort(pieces.begin(), pieces.end(), [](const Piece& a, const Piece& b) {
+        return a.line != b.line ? a.line < b.line : a.piece < b.piece;
+    });
+    const Lines& before = linesOf(lines);
+    auto updated = makeBlock<Lines>();
+    updated->reserve(before.size() + 1);
+    bool unchanged = true;
+    size_t existing = 0;
+    std::vector<std::pair<uint32_t, bool>> along{};
+    for(size_t group = 0; group < pieces.size();) {
+        uint32_t line = pieces[group].line;
+        along.clear();
+        for(; group < pieces.size() && pieces[group].line == line; group ++) {
+            along.emplace_back(pieces[group].piece, pieces[group].on);
+        }
+        for(; existing < before.size() && before[existing].first < line; existing ++) {
+            updated->push_back(before[existing]);
+        }
+        static const Runs none{};
+        std::shared_ptr<const Runs> runs = existing < before.size() && before[existing].first == line ? before[existing ++].second : nullptr;
+        Runs next = setPieces(runs ? *runs : none, along);
+        if(runs && next == *runs) {
+            updated->emplace_back(line, std::move(runs));
+            continue;
+        }
+        unchanged = false;
+        if(runs) digest ^= lineDigest(line, vertical, *runs);
+        if(next.empty()) continue;
+        digest ^= lineDigest(line, vertical, next);
+        auto replacement = makeBlock<Runs>();
+        *replacement = std::move(next);
+        replacement->shrink_to_fit();
+        updated->emplace_back(line, std::move(replacement));
+    }
+    if(unchanged) return lines;
+    updated->insert(updated->end(), before.begin() + static_cast<std::ptrdiff_t>(existing), before.end());
+    if(updated->empty()) return nullptr;
+    return updated;
+}
+
+//Rebuilds the node from the changes below it, returning it as it was if none of them changed anything
+std::shared_ptr<const GridVersion::Node> GridVersion::updateNode(const std::shared_ptr<const Node>& node, Change* begin, Change* end, int level,
+                                                                 std::vector<std::pair<uint64_t, Item>>& changes, const Changed& changed) {
+    auto updated = makeBlock<Node>();
+    updated->children.reserve((node ? node->children.size() : 0) + 1);
+    uint64_t bitmap = node ? node->bitmap : 0;
+    size_t existing = 0;
+    bool unchanged = true;
+    Change* group = begin;
+    for(int index = 0; index < 64; index ++) {
+        uint64_t bit = 1ull << index;
+        Change* groupEnd = group;
+        while(groupEnd != end && childIndex(groupEnd->hash, level) == index) groupEnd ++;
+        if(!(bitmap & bit) && group == groupEnd) continue;
+        Child child = (bitmap & bit) ? node->children[existing ++] : Child{};
+        if(group != groupEnd) {
+            Child next = update(child, group, groupEnd, level + 1, changes, changed);
+            unchanged = unchanged && next.node == child.node && next.tile == child.tile;
+            child = std::move(next);
+        }
+        group = groupEnd;
+        append(*updated, bit, std::move(child));
+    }
+    if(unchanged) return node;
+    if(updated->children.empty()) return nullptr;
+    return updated;
+}
+
+//The child with changes made, level being that of a node in its place
+GridVersion::Child GridVersion::update(const Child& child, Change* begin, Change* end, int level,
+                                       std::vector<std::pair<uint64_t, Item>>& changes, const Changed& changed) {
+    if(begin->hash == (end - 1)->hash && !child.node && (!child.tile || child.hash == begin->hash)) {
+        uint64_t origin = changes[begin->index].first & ~TILE_MASK;
+        auto tile = updateTile(child.tile, origin, begin, end, changes, changed);
+        return tile ? Child{begin->hash, nullptr, std::move(tile)} : Child{};
+    }
+    //A tile that has to share its place moves down into a node of its own
+    std::shared_ptr<const Node> node = child.node;
+    if(child.tile) {
+        auto pushed = makeBlock<Node>();
+        pushed->bitmap = 1ull << childIndex(child.hash, level);
+        pushed->count = std::popcount(child.tile->occupied);
+        pushed->digest = child.tile->digest;
+        pushed->children.push_back(child);
+        node = std::move(pushed);
+    }
+    auto updated = updateNode(node, begin, end, level, changes, changed);
+    if(!updated) return Child{};
+    if(updated == node && child.tile) return child;
+    if(updated->children.size() == 1 && updated->children[0].tile) return updated->children[0]; //a lone tile moves back up
+    return Child{0, std::move(updated), nullptr};
+}
+
+std::shared_ptr<const GridVersion::Tile> GridVersion::updateTile(const std::shared_ptr<const Tile>& tile, uint64_t origin, Change* begin, Change* end,
+                                                                 std::vector<std::pair<uint64_t, Item>>& changes, const Changed& changed) {
+    const Item* cells[64]{};
+    Item* incoming[64]{};
+    uint64_t occupied = tile ? tile->occupied : 0;
+    uint64_t digest = tile ? tile->digest : 0;
+    size_t item = 0;
+    for(uint64_t bits = occupied; bits != 0; bits &= bits - 1) {
+        cells[std::countr_zero(bits)] = &tile->items[item ++];
+    }
+    bool touched = false;
+    for(Change* change = begin; change != end; change ++) {
+        auto& [key, next] = changes[change->index];
+        Item* after = next.type == Item::ItemType::none ? nullptr : &next;
+        const Item* before = cells[change->slot] ? cells[change->slot] : change->runBefore ? &wireItem(change->runBefore) : nullptr;
+        if(before == nullptr && after == nullptr) continue;
+        if(changed) changed(key, before, after);
+        if(after && inRuns(*after)) after = nullptr;
+        if(cells[change->slot] == nullptr && after == nullptr) continue;
+        touched = true;
+        if(cells[change->slot]) digest ^= cellDigest(key, *cells[change->slot]);
+        if(after) digest ^= cellDigest(key, *after);
+        cells[change->slot] = after;
+        incoming[change->slot] = after;
+        if(after) {
+            occupied |= 1ull << change->slot;
+        } else {
+            occupied &= ~(1ull << change->slot);
+        }
+    }
+    if(!touched) return tile;
+    if(occupied == 0) return nullptr;
+    auto updated = makeBlock<Tile>();
+    updated->origin = origin;
+    updated->occupied = occupied;
+    updated->digest = digest;
+    updated->items.reserve(std::popcount(occupied));
+    for(uint64_t bits = occupied; bits != 0; bits &= bits - 1) {
+        int cell = std::countr_zero(bits);
+        if(incoming[cell]) {
+            updated->items.push_back(std::move(*incoming[cell]));
+        } else {
+            updated->items.push_back(*cells[cell]);
+        }
+    }
+    return updated;
+}
+
+void GridVersion::append(Node& node, uint64_t bit, Child child) {
+    if(!child.node && !child.tile) return;
+    node.bitmap |= bit;
+    node.count += child.node ? child.node->count : static_cast<size_t>(std::popcount(child.tile->occupied));
+    node.digest ^= digestOf(child);
+    node.children.push_back(std::move(child));
+}
+
+void GridVersion::diff(const GridVersion& later, const Changed& changed) const {
+    if(runDigest == later.runDigest) {
+        diff(Child{0, root, nullptr}, Child{0, later.root, nullptr}, changed);
+        return;
+    }
+    //A wire can move between a tile and the runs, or change along both its row and its column, so what changed is
+    //gathered and merged into one call per cell
+    std::vector<std::tuple<uint64_t, const Item*, const Item*>> cells{};
+    Changed gather = [&cells](uint64_t key, const Item* before, const Item* after) {
+        cells.emplace_back(key, before, after);
+    };
+    diff(Child{0, root, nullptr}, Child{0, later.root, nullptr}, gather);
+    diffLines(rowRuns(), later.rowRuns(), false, later, gather);
+    diffLines(columnRuns(), later.columnRuns(), true, later, gather);
+    std::stable_sort(cells.begin(), cells.end(), [](const auto& a, const auto& b) {return std::get<0>(a) < std::get<0>(b);});
+    for(size_t i = 0; i < cells.size();) {
+        auto [key, before, after] = cells[i ++];
+        for(; i < cells.size() && std::get<0>(cells[i]) == key; i ++) {
+            if(before == nullptr) before = std::get<1>(cells[i]);
+            if(after == nullptr) after = std::get<2>(cells[i]);
+        }
+        changed(key, before, after);
+    }
+}
+
+//Calls changed for each cell whose runs differ between before, lines of this, and after, those of later
+void GridVersion::diffLines(const Lines& before, const Lines& after, bool vertical, const GridVersion& later, const Changed& changed) const {
+    static const Runs none{};
+    size_t i = 0;
+    size_t j = 0;
+    while(i < before.size() || j < after.size()) {
+        uint32_t line;
+        const Runs* a = &none;
+        const Runs* b = &none;
+        if(j == after.size() || (i < before.size() && before[i].first < after[j].first)) {
+            line = before[i].first;
+            a = before[i ++].second.get();
+        } else if(i == before.size() || after[j].first < before[i].first) {
+            line = after[j].first;
+            b = after[j ++].second.get();
+        } else {
+            line = before[i].first;
+            a = before[i ++].second.get();
+            b = after[j ++].second.get();
+            if(a == b || *a == *b) continue;
+        }
+        int64_t last = -1;
+        runDifferences(*a, *b, [&](uint32_t from, uint32_t to) {
+            for(uint32_t cell = from / 2; cell <= (to - 1) / 2; cell ++) {
+                if(cell == last) continue;
+                last = cell;
+                uint64_t key = vertical ? (static_cast<uint64_t>(cell) << 32) | line : (static_cast<uint64_t>(line) << 32) | cell;
+                int was = runShape(key);
+                int is = later.runShape(key);
+                changed(key, was != 0 ? &wireItem(was) : nullptr, is != 0 ? &wireItem(is) : nullptr);
+            }
+        });
+    }
+}
+
+void GridVersion::diff(const Child& before, const Child& after, const Changed& changed) {
+    if(digestOf(before) == digestOf(after)) return;
+    if(before.node && after.node) {
+        const Node& a = *before.node;
+        const Node& b = *after.node;
+        for(uint64_t bits = a.bitmap | b.bitmap; bits != 0; bits &= bits - 1) {
+            uint64_t bit = bits & (~bits + 1);
+            diff((a.bitmap & bit) ? a.children[std::popcount(a.bitmap & (bit - 1))] : Child{},
+                 (b.bitmap & bit) ? b.children[std::popcount(b.bitmap & (bit - 1))] : Child{}, changed);
+        }
+        return;
+    }
+    //A tile on one side and a node or another tile on the other: pair up the few tiles below by hash
+    std::vector<std::pair<uint64_t, const Tile*>> a{};
+    std::vector<std::pair<uint64_t, const Tile*>> b{};
+    collect(before, a);
+    collect(after, b);
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    size_t i = 0;
+    size_t j = 0;
+    while(i < a.size() || j < b.size()) {
+        if(j == b.size() || (i < a.size() && a[i].first < b[j].first)) {
+            diffTiles(a[i ++].second, nullptr, changed);
+        } else if(i == a.size() || b[j].first < a[i].first) {
+            diffTiles(nullptr, b[j ++].second, changed);
+        } else {
+            if(a[i].second->digest != b[j].second->digest) diffTiles(a[i].second, b[j].second, changed);
+            i ++;
+            j ++;
+        }
+    }
+}
+
+void GridVersion::collect(const Child& child, std::vector<std::pair<uint64_t, const Tile*>>& tiles) {
+    if(child.tile) {
+        tiles.emplace_back(child.hash, child.tile.get());
+    } else if(child.node) {
+        for(const Child& grandchild : child.node->children) {
+            collect(grandchild, tiles);
+        }
+    }
+}
+
+void GridVersion::diffTiles(const Tile* before, const Tile* after, const Changed& changed) {
+    uint64_t origin = before ? before->origin : after->origin;
+    uint64_t a = before ? before->occupied : 0;
+    uint64_t b = after ? after->occupied : 0;
+    for(uint64_t bits = a | b; bits != 0; bits &= bits - 1) {
+        uint64_t bit = bits & (~bits + 1);
+        const Item* x = (a & bit) ? &before->items[std::popcount(a & (bit - 1))] : nullptr;
+        const Item* y = (b & bit) ? &after->items[std::popcount(b & (bit - 1))] : nullptr;
+        if(x && y && same(*x, *y)) continue;
+        auto cell = static_cast<uint64_t>(std::countr_zero(bits));
+        changed(origin + ((cell >> 3) << 32) + (cell & 7), x, y);
+    }
+}
+
+size_t GridVersion::memoryUsage(std::unordered_set<const void*>& seen) const {
+    size_t total = usage(Child{0, root, nullptr}, seen);
+    for(const std::shared_ptr<const Lines>& lines : {rows, columns}) {
+        if(!lines || !seen.insert(lines.get()).second) continue;
+        total += blockBytes<Lines>.load(std::memory_order_relaxed) + lines->capacity() * sizeof(Lines::value_type);
+        for(const auto& [at, runs] : *lines) {
+            if(!seen.insert(runs.get()).second) continue;
+            total += blockBytes<Runs>.load(std::memory_order_relaxed) + runs->capacity() * sizeof(Run);
+        }
+    }
+    return total;
+}
+
+size_t GridVersion::usage(const Child& child, std::unordered_set<const void*>& seen) {
+    size_t total = 0;
+    if(child.node) {
+        if(!seen.insert(child.node.get()).second) return 0;
+        total += blockBytes<Node>.load(std::memory_order_relaxed) + child.node->children.capacity() * sizeof(Child);
+        for(const Child& grandchild : child.node->children) {
+            total += usage(grandchild, seen);
+        }
+    } else if(child.tile) {
+        if(!seen.insert(child.tile.get()).second) return 0;
+        total += blockBytes<Tile>.load(std::memory_order_relaxed) + child.tile->items.capacity() * sizeof(Item);
+    }
+    return total;
+}
+
+PublishedVersion::PublishedVersion(const PublishedVersion& other) : version{other.version.load(std::memory_order_acquire)} {}
+
+PublishedVersion& PublishedVersion::operator=(const PublishedVersion& other) {
+    version.store(other.version.load(std::memory_order_acquire), std::memory_order_release);
+    return *this;
+}
+
+GridVersion PublishedVersion::load() const {
+    std::shared_ptr<const GridVersion> loaded = version.load(std::memory_order_acquire);
+    return loaded ? *loaded : GridVersion{};
+}
+
+//The tiles, runs and count go out together in one copy, so a version loaded never mixes two stores
+void PublishedVersion::store(const GridVersion& version) {
+    this->version.store(std::make_shared<const GridVersion>(version), std::memory_order_release);
+}
@@ -0,0 +1,175 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <unordered_set>
+#include <utility>
+#include <bit>
+#include "Item.h"
+
+class ThreadPool;
+
+//Immutable map from cell key to Item: a hash array mapped trie whose leaves are 8x8 tiles of cells. Making a change
+//gives a new version that copies only the tiles changed and the nodes above them and shares the rest, so any thread
+//can hold a version for as long as it likes while newer ones are made, and old versions are cheap to keep for undo.
+//Plain wires, which are most of a large design, are not kept in tiles but as runs along each row and column.
+//Every tile and node carries a digest of the cells below it, so two versions that share nothing can still be compared
+//by looking only inside what differs.
+class GridVersion {
+public:
+    //Runs are in half cells: along a row, piece 2c is the left half of cell c and 2c + 1 its right half, and along a
+    //column piece 2r is the top half of row r's cell and 2r + 1 its bottom half
+    using Run = std::pair<uint32_t, uint32_t>; //pieces [first, second)
+    using Runs = std::vector<Run>; //in order, no two touching
+    using Lines = std::vector<std::pair<uint32_t, std::shared_ptr<const Runs>>>; //by row or column, none empty
+private:
+    struct Tile {
+        uint64_t origin; //key of the top left cell
+        uint64_t occupied; //bit (row % 8) * 8 + col % 8 of each cell with an item
+        uint64_t digest; //of its cells, see cellDigest
+        std::vector<Item> items; //in bit order
+    };
+    struct Node;
+    //Exactly one of node and tile is set, or neither for an empty child
+    struct Child {
+        uint64_t hash; //of the tile's origin
+        std::shared_ptr<const Node> node;
+        std::shared_ptr<const Tile> tile;
+    };
+    struct Node {
+        uint64_t bitmap; //bit i set for each child, children are in bit order
+        size_t count; //cells below
+        uint64_t digest; //of every cell below, the children's XORed
+        std::vector<Child> children;
+    };
+    struct Change;
+public:
+    //Visits occupied cells a tile at a time and then a run at a time, in no particular order. Dereferences to (key, item).
+    class Iterator {
+    public:
+        std::pair<uint64_t, const Item&> operator*() const {
+            if(tile == nullptr) return runCell();
+            auto bit = static_cast<uint64_t>(std::countr_zero(remaining));
+            return {tile->origin + ((bit >> 3) << 32) + (bit & 7), tile->items[item]};
+        }
+        Iterator& operator++() {
+            if(tile == nullptr) {
+                cell ++;
+                nextRunCell();
+                return *this;
+            }
+            remaining &= remaining - 1;
+            item ++;
+            if(remaining == 0) nextTile();
+            return *this;
+        }
+        //Whether every tile has been visited, leaving only cells in runs
+        bool pastTiles() const {
+            return tile == nullptr;
+        }
+        bool operator==(const Iterator& other) const {
+            return tile == other.tile && remaining == other.remaining && version == other.version && vertical == other.vertical &&
+                   line == other.line && run == other.run && cell == other.cell;
+        }
+    private:
+        friend class GridVersion;
+        void nextTile();
+        //Cells in runs come after the tiles: those along rows, then those along columns that no row run reaches
+        std::pair<uint64_t, const Item&> runCell() const;
+        void nextRunCell();
+        std::vector<std::pair<const Node*, size_t>> stack;
+        const Tile* tile{nullptr};
+        uint64_t remaining{0}; //occupied bits not visited yet, the lowest is the current cell
+        size_t item{0};
+        const GridVersion* version{nullptr}; //null once every cell has been visited
+        bool vertical{false};
+        size_t line{0};
+        size_t run{0};
+        uint32_t cell{0}; //along the line
+    };
+    //Called with a cell's key and its item before and after, null where the cell is empty
+    using Changed = std::function<void(uint64_t key, const Item* before, const Item* after)>;
+
+    GridVersion() = default;
+    size_t size() const;
+    bool empty() const;
+    //Null if the cell is empty. A cell in runs gives an item shared by every wire of its shape.
+    const Item* find(uint64_t key) const;
+    Iterator begin() const;
+    Iterator end() const;
+    //This version with changes made: a later change to the same key wins and items of type none clear their cell.
+    //changed, if given, is called for each cell changed, while the items it is given are still alive.
+    GridVersion with(std::vector<std::pair<uint64_t, Item>> changes, const Changed& changed = nullptr) const;
+    //The same as with, the tiles under each of the root's children and the runs each way made by tasks of their own on
+    //pool, for building versions of whole designs. What a task throws is rethrown here once every task has finished.
+    GridVersion with(std::vector<std::pair<uint64_t, Item>> changes, ThreadPool& pool) const;
+    //A version of just plain wires, in runs as rowRuns and columnRuns give them, on a grid width cells wide and height
+    //high. Throws std::invalid_argument if lines or runs are out of order or off the grid, or a run is empty or touches
+    //the next.
+    static GridVersion ofRuns(std::vector<std::pair<uint32_t, Runs>> rows, std::vector<std::pair<uint32_t, Runs>> columns, uint32_t width, uint32_t height);
+    //Calls changed for each cell that differs from this in later, without looking inside anything they share or
+    //whose digests match, so versions loaded apart from one another are compared a differing tile at a time
+    void diff(const GridVersion& later, const Changed& changed) const;
+    //Of every cell and item. Versions with the same cells have the same digest however they were made, and ones that
+    //differ a different digest bar a 2^-64 chance. Like Item::hash, only compares within one run.
+    uint64_t digest() const;
+    //Bytes of the tiles, nodes and runs not already in seen, which are then added to it, so versions that share can
+    //be counted one after another without counting twice
+    size_t memoryUsage(std::unordered_set<const void*>& seen) const;
+    //Whether item is a wire that would be kept in runs: one with no label or value
+    static bool inRuns(const Item& item);
+    //Runs of the wires kept in runs, along each row and along each column
+    const Lines& rowRuns() const;
+    const Lines& columnRuns() const;
+    //Cells kept in runs, out of size
+    size_t runCells() const;
+private:
+    GridVersion(std::shared_ptr<const Node> root, std::shared_ptr<const Lines> rows, std::shared_ptr<const Lines> columns, size_t wires, uint64_t runDigest);
+    static uint64_t hash(uint64_t origin);
+    //Digests are XORs of these, so a change updates the digests above it in constant time on its way up
+    static uint64_t cellDigest(uint64_t key, const Item& item);
+    static uint64_t lineDigest(uint32_t at, bool vertical, const Runs& runs);
+    static uint64_t digestOf(const Child& child);
+    const Item* findInTiles(uint64_t key) const;
+    //Shape of the wire runs give the cell, 0 if they do not reach it
+    int runShape(uint64_t key) const;
+    //Sorts changes by tile then cell and keeps only the last to each cell, returning the end of those kept
+    static Change* keepLast(Change* begin, Change* end);
+    //Notes in each change the shape runs gave its cell and adds the cells whose wire joins or leaves the runs to
+    //runChanges, returning how many more cells the runs then reach
+    ptrdiff_t findRunChanges(Change* begin, Change* end, const std::vector<std::pair<uint64_t, Item>>& changes,
+                             std::vector<std::pair<uint64_t, int>>& runChanges) const;
+    static std::shared_ptr<const Lines> updateLines(const std::shared_ptr<const Lines>& lines, const std::vector<std::pair<uint64_t, int>>& cells, bool vertical,
+                                                    uint64_t& digest);
+    void diffLines(const Lines& before, const Lines& after, bool vertical, const GridVersion& later, const Changed& changed) const;
+    static Child update(const Child& child, Change* begin, Change* end, int level, std::vector<std::pair<uint64_t, Item>>& changes, const Changed& changed);
+    static std::shared_ptr<const Node> updateNode(const std::shared_ptr<const Node>& node, Change* begin, Change* end, int level,
+                                                  std::vector<std::pair<uint64_t, Item>>& changes, const Changed& changed);
+    static std::shared_ptr<const Tile> updateTile(const std::shared_ptr<const Tile>& tile, uint64_t origin, Change* begin, Change* end,
+                                                  std::vector<std::pair<uint64_t, Item>>& changes, const Changed& changed);
+    //Adds child to node at bit unless it is empty
+    static void append(Node& node, uint64_t bit, Child child);
+    static void diff(const Child& before, const Child& after, const Changed& changed);
+    static void collect(const Child& child, std::vector<std::pair<uint64_t, const Tile*>>& tiles);
+    static void diffTiles(const Tile* before, const Tile* after, const Changed& changed);
+    static size_t usage(const Child& child, std::unordered_set<const void*>& seen);
+    std::shared_ptr<const Node> root; //null when no cell is in a tile
+    std::shared_ptr<const Lines> rows; //null when there are no runs
+    std::shared_ptr<const Lines> columns;
+    size_t wires{0}; //cells in runs
+    uint64_t runDigest{0}; //of every line of runs, both ways
+};
+
+//The latest version of a grid for other threads: the owner stores, any thread loads without waiting on the owner's
+//edits, and a version loaded stays whole however many are stored after it.
+class PublishedVersion {
+public:
+    PublishedVersion() = default;
+    PublishedVersion(const PublishedVersion& other);
+    PublishedVersion& operator=(const PublishedVersion& other);
+    GridVersion load() const;
+    void store(const GridVersion& version);
+private:
+    std::atomic<std::shared_ptr<const GridVersion>> version;
+};
@@ -0,0 +1,564 @@
+#include "ImageExport.h"
+#include "Resources.h"
+#include "Components.h"
+#include "OutputBuffer.h"
+#include "Compositor.h"
+#include <wx/rawbmp.h>
+#include <zlib.h>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <bit>
+
+namespace {
+    constexpr size_t MAX_BAND_BYTES = 64 << 20; //two bands are held at once, one drawing and one compressing
+    constexpr size_t MAX_ROW_BYTES = 256 << 20; //one row of cells, the least a band can hold
+    constexpr int TILE_PIXELS = 1024;
+    constexpr size_t MAX_LABEL_BYTES = 64 << 20; //label sprites kept for later bands, dropped before one once over this
+    constexpr uint32_t SVG_BAND_ROWS = 256; //rows of cells whose instances are stamped out at once for SVG
+
+    //A label drawn once with wx as black text over nothing, and where it goes relative to its cell's top left corner
+    struct LabelSprite {
+        int x;
+        int y;
+        Compositor::Sprite sprite;
+    };
+    //Items that draw the same label: the same type, shape, value and text
+    struct ItemHash {
+        size_t operator()(const Item& item) const {
+            return static_cast<size_t>(item.hash());
+        }
+    };
+    struct SameLabel {
+        bool operator()(const Item& a, const Item& b) const {
+            return a.type == b.type && a.shape == b.shape && a.extraData == b.extraData &&
+                   std::bit_cast<uint64_t>(static_cast<double>(a.value)) == std::bit_cast<uint64_t>(static_cast<double>(b.value));
+        }
+    };
+    using LabelSprites = std::unordered_map<Item, LabelSprite, ItemHash, SameLabel>;
+
+    bool hasLabel(const Item& item) {
+        return item.type == Item::ItemType::wire ? !item.extraData.empty() : components::find(item.type) != nullptr;
+    }
+
+    //Draws item's label into scratch, which is three cells square with the cell in the middle, and keeps the pixels the
+    //text covers. Labels can spill into the cells around theirs but no further.
+    LabelSprite rasterizeLabel(const Item& item, int cellSize, bool rotatedText, const wxFont& font, wxBitmap& scratch) {
+        {
+            wxMemoryDC dc{scratch};
+            dc.SetBackground(*wxWHITE_BRUSH);
+            dc.Clear();
+            dc.SetFont(font);
+            dc.SetTextForeground(*wxBLACK);
+            dc.SetDeviceOrigin(cellSize, cellSize);
+            item.drawLabel(dc, cellSize, rotatedText);
+            dc.SelectObject(wxNullBitmap);
+        }
+        const int size = scratch.GetWidth();
+        std::vector<uint8_t> coverage(static_cast<size_t>(size) * size);
+        int left = size, top = size, right = 0, bottom = 0;
+        wxNativePixelData pixels{scratch};
+        wxNativePixelData::Iterator source{pixels};
+        for(int y = 0; y < size; y ++) {
+            wxNativePixelData::Iterator rowStart = source;
+            for(int x = 0; x < size; x ++, ++source) {
+                auto covered = static_cast<uint8_t>(255 - (source.Red() + source.Green() + source.Blue()) / 3);
+                coverage[static_cast<size_t>(y) * size + x] = covered;
+                if(covered == 0) continue;
+                left = std::min(left, x);
+                top = std::min(top, y);
+                right = std::max(right, x + 1);
+                bottom = std::max(bottom, y + 1);
+            }
+            source = rowStart;
+            source.OffsetY(pixels, 1);
+        }
+        LabelSprite label{left - cellSize, top - cellSize, {}};
+        if(left >= right) return label;
+        label.sprite.width = right - left;
+        label.sprite.height = bottom - top;
+        label.sprite.pixels.reserve(static_cast<size_t>(label.sprite.width) * label.sprite.height);
+        for(int y = top; y < bottom; y ++) {
+            for(int x = left; x < right; x ++) {
+                label.sprite.pixels.push_back(Compositor::pack(0, 0, 0, coverage[static_cast<size_t>(y) * size + x]));
+            }
+        }
+        return label;
+    }
+
+    size_t spriteBytes(const LabelSprite& label) {
+        return sizeof(LabelSprite) + label.sprite.pixels.size() * sizeof(uint32_t);
+    }
+
+    void putBigEndian(uint8_t* out, uint32_t value) {
+        out[0] = static_cast<uint8_t>(value >> 24);
+        out[1] = static_cast<uint8_t>(value >> 16);
+        out[2] = static_cast<uint8_t>(value >> 8);
+        out[3] = static_cast<uint8_t>(value);
+    }
+
+    //Streams an 8-bit RGB PNG. Rows go through one deflate stream and leave as an IDAT chunk each time the output fills.
+    class PngWriter {
+    public:
+        PngWriter(std::ostream& ostream, uint32_t width, uint32_t height) : ostream{ostream}, output(OUTPUT_SIZE) {
+            ostream.write("\x89PNG\r\n\x1a\n", 8);
+            uint8_t header[13]{};
+            putBigEndian(header, width);
+            putBigEndian(header + 4, height);
+            header[8] = 8; //bits per channel
+            header[9] = 2; //RGB
+            chunk("IHDR", header, sizeof(header));
+            //Schematics are mostly background, which the fastest level already packs well
+            if(deflateInit(&stream, Z_BEST_SPEED) != Z_OK) {
+                throw std::runtime_error{"Could not start compression"};
+            }
+            stream.next_out = output.data();
+            stream.avail_out = OUTPUT_SIZE;
+        }
+        ~PngWriter() {
+            deflateEnd(&stream);
+        }
+        PngWriter(const PngWriter&) = delete;
+        PngWriter& operator=(const PngWriter&) = delete;
+        //Each row starts with its filter type
+        void write(const uint8_t* rows, size_t size) {
+            compress(rows, size, Z_NO_FLUSH);
+        }
+        void finish() {
+            compress(nullptr, 0, Z_FINISH);
+            if(stream.avail_out != OUTPUT_SIZE) chunk("IDAT", output.data(), OUTPUT_SIZE - stream.avail_out);
+            chunk("IEND", nullptr, 0);
+            if(!ostream) {
+                throw std::runtime_error{"Could not write image"};
+            }
+        }
+    private:
+        constexpr static uInt OUTPUT_SIZE = 1 << 20;
+        void compress(const uint8_t* data, size_t size, int flush) {
+            stream.next_in = const_cast<Bytef*>(data);
+            stream.avail_in = static_cast<uInt>(size);
+            int result;
+            do {
+                result = deflate(&stream, flush);
+                if(result == Z_STREAM_ERROR) {
+                    throw std::runtime_error{"Could not compress image"};
+                }
+                if(stream.avail_out == 0) {
+                    chunk("IDAT", output.data(), OUTPUT_SIZE);
+                    stream.next_out = output.data();
+                    stream.avail_out = OUTPUT_SIZE;
+                }
+            } while(stream.avail_in != 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+        }
+        void chunk(const char* type, const uint8_t* data, uint32_t size) {
+            uint8_t length[4];
+            putBigEndian(length, size);
+            ostream.write(reinterpret_cast<const char*>(length), 4);
+            ostream.write(type, 4);
+            uLong crc = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+            if(size != 0) {
+                ostream.write(reinterpret_cast<const char*>(data), size);
+                crc = crc32(crc, data, size);
+            }
+            uint8_t check[4];
+            putBigEndian(check, static_cast<uint32_t>(crc));
+            ostream.write(reinterpret_cast<const char*>(check), 4);
+        }
+        std::ostream& ostream;
+        std::vector<uint8_t> output;
+        z_stream stream{};
+    };
+
+    //SVG glyphs are drawn in a 1x1 cell, from the same strokes as Resources draws
+    using components::Point;
+    void polyline(OutputBuffer& out, const std::vector<Point>& points) {
+        out << "<polyline points=\"";
+        for(Point point : points) {
+            out << point.x << ',' << point.y << ' ';
+        }
+        out << "\"/>";
+    }
+    void circle(OutputBuffer& out, Point centre, double radius, bool filled = false) {
+        out << "<circle cx=\"" << centre.x << "\" cy=\"" << centre.y << "\" r=\"" << radius << '"';
+        out << (filled ? " class=\"f\"/>" : "/>");
+    }
+
+    //Parts are p<type>-<variant>, wires w<shape>
+    void symbols(OutputBuffer& out) {
+        for(const components::Component& part : components::all()) {
+            for(int variant = 0; variant < part.variants(); variant ++) {
+                out << "<symbol id=\"p" << static_cast<int>(part.type) << '-' << variant << "\" viewBox=\"0 0 1 1\">";
+                for(const components::Stroke& stroke : part.strokes) {
+                    if(!part.draws(stroke, variant)) continue;
+                    std::vector<Point> points{};
+                    for(Point point : stroke.points) {
+                        points.push_back(part.place(point, variant));
+                    }
+                    if(stroke.circle) circle(out, points[0], stroke.radius);
+                    else polyline(out, points);
+                }
+                out << "</symbol>\n";
+            }
+        }
+        for(int shape = 1; shape < 16; shape ++) {
+            out << "<symbol id=\"w" << shape << "\" viewBox=\"0 0 1 1\">";
+            if(shape & Item::UP) polyline(out, {{0.5, 0}, {0.5, 0.5}});
+            if(shape & Item::DOWN) polyline(out, {{0.5, 1}, {0.5, 0.5}});
+            if(shape & Item::LEFT) polyline(out, {{0, 0.5}, {0.5, 0.5}});
+            if(shape & Item::RIGHT) polyline(out, {{1, 0.5}, {0.5, 0.5}});
+            int directions = ((shape & Item::UP) != 0) + ((shape & Item::DOWN) != 0) + ((shape & Item::LEFT) != 0) + ((shape & Item::RIGHT) != 0);
+            if(directions > 2) circle(out, {0.5, 0.5}, 3.0 / 128, true);
+            out << "</symbol>\n";
+        }
+    }
+
+    enum class Anchor {
+        start, middle
+    };
+    //top is true to hang the text below y, otherwise it is centred on y
+    void text(OutputBuffer& out, uint32_t row, uint32_t col, double x, double y, Anchor anchor, bool top, bool rotated, const std::wstring& label) {
+        if(label.empty()) return;
+        out << "<text x=\"" << col + x << "\" y=\"" << row + y << '"';
+        if(anchor == Anchor::middle) out << " text-anchor=\"middle\"";
+        out << (top ? " dominant-baseline=\"hanging\"" : " dominant-baseline=\"central\"");
+        if(rotated) out << " transform=\"rotate(270 " << col + x << ' ' << row + y << ")\"";
+        out << '>';
+        out.writeUtf8(label, true);
+        out << "</text>\n";
+    }
+
+    //Labels go roughly where Item::draw puts them
+    void label(OutputBuffer& out, uint32_t row, uint32_t col, const Item& item, bool rotatedText) {
+        if(const components::Component* part = components::find(item.type)) {
+            const components::Anchor& anchor = part->anchor(item.shape);
+            if(part->horizontal(item.shape)) text(out, row, col, 0.5, anchor.below, Anchor::middle, true, false, item.getValueStr());
+            else if(rotatedText) text(out, row, col, anchor.rotated, 0.5, Anchor::middle, false, true, item.getValueStr());
+            else text(out, row, col, anchor.beside, anchor.height / 2, Anchor::start, false, false, item.getValueStr());
+            return;
+        }
+        switch(item.type) {
+            case Item::ItemType::wire:
+                if((item.shape & Item::LEFT) && (item.shape & Item::RIGHT) && !(item.shape & (Item::UP | Item::DOWN))) {
+                    text(out, row, col, 0.5, 0.375, Anchor::middle, false, false, item.extraData);
+                } else if((item.shape & Item::UP) && (item.shape & Item::DOWN) && (item.shape & Item::RIGHT) && !(item.shape & Item::LEFT)) {
+                    text(out, row, col, 0.1, 0.5, Anchor::start, false, false, item.extraData);
+                } else {
+                    text(out, row, col, 13.0 / 24, 0.375, Anchor::start, false, false, item.extraData);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+ImageExport::ImageExport(const Grid& grid, Options options) : grid{grid}, cells{grid.snapshot()}, options{options} {
+    std::vector<uint64_t> keys = grid.getIndex().getInstances();
+    std::sort(keys.begin(), keys.end());
+    for(uint64_t key : keys) {
+        const Item& instance = *cells.find(key);
+        auto [iterator, inserted] = expansions.try_emplace({instance.extraData, instance.shape & 3});
+        if(inserted) {
+            iterator->second = grid.expandInstance(0, instance);
+            std::stable_sort(iterator->second.begin(), iterator->second.end(), [](const auto& a, const auto& b) {return a.first < b.first;});
+        }
+        uint32_t rows = grid.instanceSize(instance).first;
+        if(rows == 0 || iterator->second.empty()) continue;
+        instances.push_back(Instance{key, rows, &iterator->second});
+        tallest = std::max(tallest, rows);
+    }
+}
+
+//Only instances starting less than the tallest one's height above the band can reach it
+ImageExport::InstanceCells ImageExport::expandRows(uint32_t firstRow, uint32_t lastRow) const {
+    InstanceCells result{};
+    uint64_t from = static_cast<uint64_t>(firstRow > tallest ? firstRow - tallest : 0) << 32;
+    auto instance = std::lower_bound(instances.begin(), instances.end(), from, [](const Instance& a, uint64_t key) {return a.key < key;});
+    for(; instance != instances.end() && (instance->key >> 32) < lastRow; ++instance) {
+        auto top = static_cast<uint32_t>(instance->key >> 32);
+        auto left = static_cast<uint32_t>(instance->key);
+        if(static_cast<uint64_t>(top) + instance->rows <= firstRow) continue;
+        uint64_t skipped = static_cast<uint64_t>(firstRow > top ? firstRow - top : 0) << 32;
+        const Expansion& expansion = *instance->cells;
+        auto cell = std::lower_bound(expansion.begin(), expansion.end(), skipped, [](const auto& a, uint64_t key) {return a.first < key;});
+        for(; cell != expansion.end(); ++cell) {
+            uint64_t row = top + (cell->first >> 32);
+            uint64_t col = left + static_cast<uint32_t>(cell->first);
+            if(row >= lastRow || row >= grid.getHeight()) break;
+            if(col >= grid.getWidth()) continue;
+            uint64_t key = (row << 32) | col;
+            const Item* existing = cells.find(key);
+            if(existing == nullptr || existing->type == Item::ItemType::instance) {
+                result.try_emplace(key, cell->second);
+            }
+        }
+    }
+    return result;
+}
+
+const Item* ImageExport::find(uint64_t key, const InstanceCells& instanceCells) const {
+    const Item* item = cells.find(key);
+    if(item != nullptr && item->type != Item::ItemType::instance) return item;
+    if(instanceCells.empty()) return nullptr;
+    auto cell = instanceCells.find(key);
+    return cell == instanceCells.end() ? nullptr : &cell->second;
+}
+
+//Only the calling thread draws with wx: the glyphs up front, and each band's labels not yet seen before the band is
+//composited. The pool composites tiles of the band from those sprites, touching no wx and nothing shared but them.
+void ImageExport::writePng(std::ostream& ostream, ThreadPool& pool) const {
+    const int cellSize = options.cellSize;
+    const uint32_t width = grid.getWidth();
+    const uint32_t height = grid.getHeight();
+    const size_t stride = 1 + static_cast<size_t>(width) * cellSize * 3;
+    if(stride * cellSize > MAX_ROW_BYTES || static_cast<uint64_t>(height) * cellSize > INT32_MAX || cellSize <= 0) {
+        throw std::runtime_error{"Image is too large to export at this size"};
+    }
+    const uint32_t tileCells = std::max(1, TILE_PIXELS / cellSize);
+    //Whole rows of tiles where they fit, but a band can be as little as one row of cells for very wide images
+    const size_t rowBytes = stride * cellSize;
+    auto bandRows = static_cast<uint32_t>(std::min<size_t>(std::max<size_t>(1, MAX_BAND_BYTES / rowBytes), height));
+    if(bandRows > tileCells) bandRows -= bandRows % tileCells;
+    const uint32_t tilesAcross = (width + tileCells - 1) / tileCells;
+
+    //The same pen, glyphs and font WindowGrid draws with, at cellSize, turned into sprites as its software renderer does
+    wxColour backgroundColour = wxTheColourDatabase->Find(options.shadedBackground ? "LIGHT GREY" : "WHITE");
+    const uint32_t background = Compositor::pack(backgroundColour.Red(), backgroundColour.Green(), backgroundColour.Blue());
+    const uint32_t black = Compositor::pack(0, 0, 0);
+    const int penWidth = static_cast<int>(std::ceil(22.0 / 1024 * cellSize));
+    const int half = cellSize / 2;
+    const Compositor::Sprite dotSprite = Compositor::disc(std::max(cellSize * options.dotSize / 128, 1) + penWidth / 2.0, black);
+    const Compositor::Sprite junctionSprite = Compositor::disc(std::max(cellSize * 3 / 128, 1) + penWidth / 2.0, black);
+    std::vector<Compositor::Sprite> glyphSprites(components::limit() * components::MAX_VARIANTS);
+    {
+        resources::Glyphs glyphs{cellSize};
+        for(const components::Component& part : components::all()) {
+            for(int variant = 0; variant < part.variants(); variant ++) {
+                wxImage image = glyphs.get(part, variant).ConvertToImage();
+                glyphSprites[static_cast<size_t>(part.type) * components::MAX_VARIANTS + variant] = Compositor::fromRgb(image.GetWidth(), image.GetHeight(),
+                        image.GetData(), image.HasAlpha() ? image.GetAlpha() : nullptr);
+            }
+        }
+    }
+    wxFont font = wxSystemSettings::GetFont(wxSYS_DEFAULT_GUI_FONT);
+    font.SetPixelSize(wxSize{0, cellSize / 8});
+    wxBitmap scratch{3 * cellSize, 3 * cellSize, 24};
+    //Only ever changed while the pool is idle
+    LabelSprites labels{};
+    size_t labelBytes = 0;
+
+    //Filter type 0 (none) is left at the start of every row when the band is made
+    std::vector<uint8_t> bands[2];
+    bands[0].assign(stride * bandRows * cellSize, 0);
+    bands[1].assign(stride * bandRows * cellSize, 0);
+    std::atomic<uint32_t> nextTile{0};
+    std::vector<std::vector<Item>> unseen(pool.size());
+    std::vector<Compositor> compositors(pool.size());
+    InstanceCells bandCells{}; //of the band and the rows either side of it, replaced only while the pool is idle
+
+    //Calls visit with each cell of the tile and the cells around it, their item or null and where they are in the tile
+    auto forCells = [&](uint32_t firstRow, uint32_t rows, uint32_t tile, auto visit) {
+        int64_t tileRow = firstRow + tile / tilesAcross * tileCells;
+        int64_t tileCol = tile % tilesAcross * tileCells;
+        auto numRows = static_cast<int64_t>(std::min<uint64_t>(tileCells, firstRow + rows - tileRow));
+        auto numCols = static_cast<int64_t>(std::min<uint64_t>(tileCells, width - tileCol));
+        for(int64_t r = -1; r <= numRows; r ++) {
+            if(tileRow + r < 0 || tileRow + r >= height) continue;
+            for(int64_t c = -1; c <= numCols; c ++) {
+                if(tileCol + c < 0 || tileCol + c >= width) continue;
+                bool inside = r >= 0 && r < numRows && c >= 0 && c < numCols;
+                visit(find((static_cast<uint64_t>(tileRow + r) << 32) | static_cast<uint64_t>(tileCol + c), bandCells), inside,
+                      static_cast<int>(c) * cellSize, static_cast<int>(r) * cellSize);
+            }
+        }
+        return std::pair<int64_t, int64_t>{numRows, numCols};
+    };
+    //Items of the band whose labels have no sprite yet, for the calling thread to draw
+    auto findUnseen = [&](unsigned worker, uint32_t firstRow, uint32_t rows, uint32_t tile) {
+        forCells(firstRow, rows, tile, [&](const Item* item, bool inside, int x, int y) {
+            if(item != nullptr && hasLabel(*item) && labels.find(*item) == labels.end()) unseen[worker].push_back(*item);
+        });
+    };
+    //What Item::draw would draw, a cell at a time, with labels last so neighbouring cells never cover them
+    auto compositeTile = [&](unsigned worker, std::vector<uint8_t>& band, uint32_t firstRow, uint32_t rows, uint32_t tile) {
+        Compositor& compositor = compositors[worker];
+        compositor.resize(static_cast<int>(tileCells) * cellSize, static_cast<int>(tileCells) * cellSize);
+        compositor.clear(background);
+        auto segment = [&](int x1, int y1, int x2, int y2) {
+            compositor.fill(std::min(x1, x2) - penWidth / 2, std::min(y1, y2) - penWidth / 2, std::abs(x2 - x1) + penWidth, std::abs(y2 - y1) + penWidth, black);
+        };
+        forCells(firstRow, rows, tile, [&](const Item* item, bool inside, int x, int y) {
+            if(!inside) return;
+            if(item == nullptr) {
+                if(options.dotSize != -1) compositor.blend(dotSprite, x + half - dotSprite.width / 2, y + half - dotSprite.height / 2);
+            } else if(item->type == Item::ItemType::wire) {
+                if(item->shape & Item::UP) segment(x + half, y, x + half, y + half);
+                if(item->shape & Item::DOWN) segment(x + half, y + cellSize, x + half, y + half);
+                if(item->shape & Item::LEFT) segment(x, y + half, x + half, y + half);
+                if(item->shape & Item::RIGHT) segment(x + cellSize, y + half, x + half, y + half);
+                if(std::popcount(static_cast<unsigned>(item->shape & (Item::UP | Item::DOWN | Item::LEFT | Item::RIGHT))) > 2) {
+                    compositor.blend(junctionSprite, x + half - junctionSprite.width / 2, y + half - junctionSprite.height / 2);
+                }
+            } else if(const components::Component* part = components::find(item->type)) {
+                compositor.blend(glyphSprites[static_cast<size_t>(part->type) * components::MAX_VARIANTS + part->variant(item->shape)], x, y);
+            }
+        });
+        auto [numRows, numCols] = forCells(firstRow, rows, tile, [&](const Item* item, bool inside, int x, int y) {
+            if(item == nullptr || !hasLabel(*item)) return;
+            const LabelSprite& label = labels.find(*item)->second;
+            compositor.blend(label.sprite, x + label.x, y + label.y);
+        });
+        uint32_t tileRow = firstRow + tile / tilesAcross * tileCells;
+        uint32_t tileCol = tile % tilesAcross * tileCells;
+        const uint32_t* source = compositor.data();
+        for(int y = 0; y < numRows * cellSize; y ++) {
+            const uint32_t* pixel = source + static_cast<size_t>(y) * compositor.getWidth();
+            uint8_t* out = band.data() + ((tileRow - firstRow) * cellSize + y) * stride + 1 + static_cast<size_t>(tileCol) * cellSize * 3;
+            for(int x = 0; x < numCols * cellSize; x ++, pixel ++) {
+                *out++ = static_cast<uint8_t>(*pixel);
+                *out++ = static_cast<uint8_t>(*pixel >> 8);
+                *out++ = static_cast<uint8_t>(*pixel >> 16);
+            }
+        }
+    };
+    //One task per worker taking tiles until the band is done, then waits
+    auto eachTile = [&](uint32_t firstRow, auto work) {
+        uint32_t rows = std::min(bandRows, height - firstRow);
+        uint32_t tiles = (rows + tileCells - 1) / tileCells * tilesAcross;
+        nextTile = 0;
+        for(unsigned worker = 0; worker < pool.size(); worker ++) {
+            pool.submit([&, firstRow, rows, tiles, worker, work] {
+                for(uint32_t tile = nextTile++; tile < tiles; tile = nextTile++) {
+                    work(worker, firstRow, rows, tile);
+                }
+            });
+        }
+    };
+    //Sprites of the band's labels are drawn on this thread, once the pool has found which are missing
+    auto prepareLabels = [&](uint32_t firstRow) {
+        if(labelBytes > MAX_LABEL_BYTES) {
+            labels.clear();
+            labelBytes = 0;
+        }
+        eachTile(firstRow, findUnseen);
+        pool.wait();
+        for(std::vector<Item>& items : unseen) {
+            for(const Item& item : items) {
+                if(labels.find(item) != labels.end()) continue;
+                LabelSprite& label = labels.emplace(item, rasterizeLabel(item, cellSize, options.rotatedText, font, scratch)).first->second;
+                labelBytes += spriteBytes(label);
+            }
+            items.clear();
+        }
+    };
+
+    PngWriter png{ostream, width * cellSize, height * cellSize};
+    if(height == 0 || width == 0) {
+        png.finish();
+        return;
+    }
+    //The pool composites each band while this thread compresses the one before it
+    for(uint32_t firstRow = 0, band = 0; firstRow < height; firstRow += bandRows, band ^= 1) {
+        bandCells = expandRows(firstRow == 0 ? 0 : firstRow - 1, static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(firstRow) + bandRows + 1, height)));
+        prepareLabels(firstRow);
+        eachTile(firstRow, [&, band](unsigned worker, uint32_t first, uint32_t rows, uint32_t tile) {compositeTile(worker, bands[band], first, rows, tile);});
+        if(firstRow != 0) png.write(bands[band ^ 1].data(), stride * bandRows * cellSize);
+        pool.wait();
+    }
+    uint32_t lastRows = height - (height - 1) / bandRows * bandRows;
+    png.write(bands[((height - 1) / bandRows) & 1].data(), stride * lastRows * cellSize);
+    png.finish();
+}
+
+void ImageExport::writeSvg(std::ostream& ostream) const {
+    std::vector<uint64_t> explicitKeys{};
+    explicitKeys.reserve(cells.size());
+    for(const auto& [key, item] : cells) {
+        if(item.type != Item::ItemType::instance) explicitKeys.push_back(key);
+    }
+    std::sort(explicitKeys.begin(), explicitKeys.end());
+
+    const uint32_t width = grid.getWidth();
+    const uint32_t height = grid.getHeight();
+    //Calls visit with the occupied cells of each band in key order and the instance cells among them
+    auto eachBand = [&](auto visit) {
+        auto next = explicitKeys.begin();
+        for(uint32_t firstRow = 0; firstRow < height; firstRow += std::min(SVG_BAND_ROWS, height - firstRow)) {
+            uint64_t lastRow = std::min<uint64_t>(static_cast<uint64_t>(firstRow) + SVG_BAND_ROWS, height);
+            InstanceCells bandCells = expandRows(firstRow, static_cast<uint32_t>(lastRow));
+            std::vector<uint64_t> keys{};
+            keys.reserve(bandCells.size());
+            for(; next != explicitKeys.end() && (*next >> 32) < lastRow; ++next) {
+                keys.push_back(*next);
+            }
+            for(const auto& pair : bandCells) {
+                keys.push_back(pair.first);
+            }
+            std::sort(keys.begin(), keys.end());
+            visit(keys, bandCells);
+        }
+    };
+    OutputBuffer out{ostream};
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"" << static_cast<uint64_t>(width) * options.cellSize
+        << "\" height=\"" << static_cast<uint64_t>(height) * options.cellSize << "\" viewBox=\"0 0 " << width << ' ' << height << "\">\n";
+    out << "<style>symbol *{fill:none;stroke:#000;stroke-width:" << 22.0 / 1024 << ";stroke-linecap:round;stroke-linejoin:round}"
+        << " .f{fill:#000} text{font-family:sans-serif;font-size:0.125px;fill:#000}</style>\n";
+    out << "<defs>\n";
+    symbols(out);
+    if(options.dotSize != -1) {
+        out << "<pattern id=\"dots\" width=\"1\" height=\"1\" patternUnits=\"userSpaceOnUse\"><circle cx=\"0.5\" cy=\"0.5\" r=\""
+            << options.dotSize / 128.0 << "\" fill=\"#000\"/></pattern>\n";
+    }
+    out << "</defs>\n";
+    out << "<rect width=\"" << width << "\" height=\"" << height << "\" fill=\"" << (options.shadedBackground ? "#C0C0C0" : "#FFFFFF") << "\"/>\n";
+
+    //Grid dots go on the empty runs of each row, and rows with nothing in them are merged into one rectangle
+    if(options.dotSize != -1) {
+        auto dots = [&](uint32_t row, uint32_t col, uint32_t rows, uint32_t cols) {
+            out << "<rect x=\"" << col << "\" y=\"" << row << "\" width=\"" << cols << "\" height=\"" << rows << "\" fill=\"url(#dots)\"/>\n";
+        };
+        uint32_t emptyFrom = 0;
+        eachBand([&](const std::vector<uint64_t>& keys, const InstanceCells&) {
+            for(size_t i = 0; i < keys.size();) {
+                auto row = static_cast<uint32_t>(keys[i] >> 32);
+                if(emptyFrom < row) dots(emptyFrom, 0, row - emptyFrom, width);
+                uint32_t col = 0;
+                for(; i < keys.size() && static_cast<uint32_t>(keys[i] >> 32) == row; i ++) {
+                    auto occupied = static_cast<uint32_t>(keys[i]);
+                    if(occupied > col) dots(row, col, 1, occupied - col);
+                    col = occupied + 1;
+                }
+                if(col < width) dots(row, col, 1, width - col);
+                emptyFrom = row + 1;
+            }
+        });
+        if(emptyFrom < height) dots(emptyFrom, 0, height - emptyFrom, width);
+    }
+
+    //Then the cells, so every dot is under every glyph and label
+    eachBand([&](const std::vector<uint64_t>& keys, const InstanceCells& bandCells) {
+        for(uint64_t key : keys) {
+            const Item& item = *find(key, bandCells);
+            auto row = static_cast<uint32_t>(key >> 32);
+            auto col = static_cast<uint32_t>(key);
+            if(const components::Component* part = components::find(item.type)) {
+                out << "<use xlink:href=\"#p" << static_cast<int>(item.type) << '-' << part->variant(item.shape);
+            } else if(item.type == Item::ItemType::wire) {
+                if((item.shape & 15) != 0) out << "<use xlink:href=\"#w" << (item.shape & 15);
+            } else {
+                continue;
+            }
+            if(item.type != Item::ItemType::wire || (item.shape & 15) != 0) {
+                out << "\" x=\"" << col << "\" y=\"" << row << "\" width=\"1\" height=\"1\"/>\n";
+            }
+            label(out, row, col, item, options.rotatedText);
+        }
+    });
+    out << "</svg>\n";
+    out.flush();
+    if(!ostream) {
+        throw std::runtime_error{"Could not write image"};
+    }
+}
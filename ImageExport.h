@@ -0,0 +1,45 @@
+#pragma once
+#include <ostream>
+#include <unordered_map>
+#include <map>
+#include "Grid.h"
+#include "ThreadPool.h"
+
+//Writes a whole Grid as an image without ever holding all of it.
+//PNG is drawn a band of cell rows at a time: the pool composites the tiles of one band from sprites of the glyphs and
+//labels Item::draw would draw while the band before it is compressed, so memory grows with the width of the image but
+//not its height.
+//SVG defines each glyph once as a <symbol> and places a <use> of it per cell.
+//Either way sub-circuit instances are stamped out a band at a time too, from one expansion of each sub-circuit.
+class ImageExport {
+public:
+    struct Options {
+        int cellSize = 32; //pixels per cell
+        int dotSize = 3; //as in WindowGrid, -1 for no dots
+        bool rotatedText = false;
+        bool shadedBackground = false;
+    };
+    ImageExport(const Grid& grid, Options options);
+    //Throws std::runtime_error if a single row of cells is too wide to hold, or writing fails. Must be called on the
+    //main thread, which draws the sprites with wx; the pool's workers never touch wx.
+    void writePng(std::ostream& ostream, ThreadPool& pool) const;
+    void writeSvg(std::ostream& ostream) const;
+private:
+    using Expansion = std::vector<std::pair<uint64_t, Item>>;
+    using InstanceCells = std::unordered_map<uint64_t, Item>;
+    struct Instance {
+        uint64_t key;
+        uint32_t rows; //as placed, after turning
+        const Expansion* cells;
+    };
+    //Cells of instances in rows [firstRow, lastRow) that no explicit cell covers
+    InstanceCells expandRows(uint32_t firstRow, uint32_t lastRow) const;
+    //What is drawn in a cell, with the instances of instanceCells stamped out, or null if the cell is empty
+    const Item* find(uint64_t key, const InstanceCells& instanceCells) const;
+    const Grid& grid;
+    GridVersion cells; //as the grid last published them, so the pool's workers read a version of their own
+    Options options;
+    std::map<std::pair<std::wstring, int>, Expansion> expansions; //by sub-circuit and turns, relative to the instance and in key order
+    std::vector<Instance> instances; //in key order, so by first row
+    uint32_t tallest{0}; //rows of the tallest instance
+};
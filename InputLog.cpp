@@ -0,0 +1,179 @@
+#include "InputLog.h"
+#include "WindowGrid.h"
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+
+namespace {
+    const char* const typeNames[] {"motion", "down", "up", "wheel", "key"};
+    constexpr int TYPES = static_cast<int>(input::Event::Type::key) + 1;
+    constexpr int WHEEL_STEP = 120; //what GetWheelDelta gives everywhere, rotations are saved in these units
+
+    void setModifiers(wxKeyboardState& state, int modifiers) {
+        state.SetControlDown(modifiers & wxMOD_CONTROL);
+        state.SetShiftDown(modifiers & wxMOD_SHIFT);
+        state.SetAltDown(modifiers & wxMOD_ALT);
+    }
+
+    std::string row(const char* name, std::vector<double>& times) {
+        char buffer[128];
+        if(times.empty()) {
+            std::snprintf(buffer, sizeof(buffer), "%-8s %8d\n", name, 0);
+            return buffer;
+        }
+        std::sort(times.begin(), times.end());
+        auto percentile = [&times](double p) {
+            size_t i = static_cast<size_t>(p * static_cast<double>(times.size()));
+            return times[std::min(i, times.size() - 1)];
+        };
+        std::snprintf(buffer, sizeof(buffer), "%-8s %8zu %9.3f %9.3f %9.3f %9.3f\n", name, times.size(), percentile(0.5), percentile(0.9), percentile(0.99), times.back());
+        return buffer;
+    }
+}
+
+input::Log input::Log::load(const std::filesystem::path& path) {
+    std::ifstream ifstream{path};
+    std::string magic;
+    int version;
+    if(!(ifstream >> magic >> version) || magic != "schematic-input" || version < 1 || version > 2) {
+        throw std::runtime_error{"Not an input log: " + path.string()};
+    }
+    Log log{};
+    ifstream >> log.clientSize.x >> log.clientSize.y >> log.viewStart.x >> log.viewStart.y >> log.zoomLevels;
+    if(version == 1) log.viewStart = log.viewStart * 16; //in scroll units, which were 16 pixels
+    Event event{};
+    std::string type;
+    while(ifstream >> event.time >> type >> event.x >> event.y >> event.buttons >> event.modifiers >> event.data >> event.unicode) {
+        auto name = std::find_if(std::begin(typeNames), std::end(typeNames), [&type](const char* name) {return type == name;});
+        if(name == std::end(typeNames)) {
+            throw std::runtime_error{"Unknown event " + type + " in " + path.string()};
+        }
+        event.type = static_cast<Event::Type>(name - std::begin(typeNames));
+        log.events.push_back(event);
+    }
+    if(!ifstream.eof()) {
+        throw std::runtime_error{"Could not read " + path.string()};
+    }
+    return log;
+}
+
+void input::Log::save(const std::filesystem::path& path) const {
+    std::ofstream ofstream{path};
+    ofstream << "schematic-input 2\n" << clientSize.x << ' ' << clientSize.y << ' ' << viewStart.x << ' ' << viewStart.y << ' ' << zoomLevels << '\n';
+    for(const Event& event : events) {
+        ofstream << event.time << ' ' << typeNames[static_cast<int>(event.type)] << ' ' << event.x << ' ' << event.y << ' ' << event.buttons << ' '
+                 << event.modifiers << ' ' << event.data << ' ' << event.unicode << '\n';
+    }
+    ofstream.close();
+    if(ofstream.fail()) {
+        throw std::runtime_error{"Could not write " + path.string()};
+    }
+}
+
+input::Recorder::Recorder(wxWindow& frame, WindowGrid& windowGrid) : frame{frame}, windowGrid{windowGrid}, start{std::chrono::steady_clock::now()} {
+    log.clientSize = windowGrid.GetClientSize();
+    log.viewStart = windowGrid.GetViewStart();
+    log.zoomLevels = windowGrid.zoomLevels;
+    //Bound after the editor's own handlers, so these run first and see events the editor does not skip
+    windowGrid.Bind(wxEVT_MOTION, &Recorder::onMouse, this);
+    windowGrid.Bind(wxEVT_LEFT_DOWN, &Recorder::onMouse, this);
+    windowGrid.Bind(wxEVT_LEFT_UP, &Recorder::onMouse, this);
+    windowGrid.Bind(wxEVT_MOUSEWHEEL, &Recorder::onMouse, this);
+    frame.Bind(wxEVT_CHAR_HOOK, &Recorder::onKey, this);
+}
+
+input::Recorder::~Recorder() {
+    windowGrid.Unbind(wxEVT_MOTION, &Recorder::onMouse, this);
+    windowGrid.Unbind(wxEVT_LEFT_DOWN, &Recorder::onMouse, this);
+    windowGrid.Unbind(wxEVT_LEFT_UP, &Recorder::onMouse, this);
+    windowGrid.Unbind(wxEVT_MOUSEWHEEL, &Recorder::onMouse, this);
+    frame.Unbind(wxEVT_CHAR_HOOK, &Recorder::onKey, this);
+}
+
+const input::Log& input::Recorder::getLog() const {
+    return log;
+}
+
+void input::Recorder::onMouse(wxMouseEvent& event) {
+    Event::Type type = Event::Type::motion;
+    if(event.GetEventType() == wxEVT_LEFT_DOWN) {
+        type = Event::Type::left_down;
+    } else if(event.GetEventType() == wxEVT_LEFT_UP) {
+        type = Event::Type::left_up;
+    } else if(event.GetEventType() == wxEVT_MOUSEWHEEL) {
+        if(event.GetWheelAxis() != wxMOUSE_WHEEL_VERTICAL) {
+            event.Skip();
+            return;
+        }
+        type = Event::Type::wheel;
+    }
+    int buttons = (event.LeftIsDown() ? 1 : 0) | (event.MiddleIsDown() ? 2 : 0);
+    int rotation = type == Event::Type::wheel ? event.GetWheelRotation() * WHEEL_STEP / event.GetWheelDelta() : 0;
+    add(type, event.GetX(), event.GetY(), buttons, event.GetModifiers(), rotation, 0);
+    event.Skip();
+}
+
+void input::Recorder::onKey(wxKeyEvent& event) {
+    int unicode = static_cast<int>(event.GetUnicodeKey());
+    bool opensDialog = event.GetModifiers() == wxMOD_CONTROL && (unicode == 'S' || unicode == 'N' || unicode == 'L' || unicode == 'F');
+    if(!opensDialog) {
+        add(Event::Type::key, 0, 0, 0, event.GetModifiers(), event.GetKeyCode(), unicode);
+    }
+    event.Skip();
+}
+
+void input::Recorder::add(Event::Type type, int x, int y, int buttons, int modifiers, int data, int unicode) {
+    int64_t time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    log.events.push_back(Event{type, time, x, y, buttons, modifiers, data, unicode});
+}
+
+std::string input::replay(const Log& log, wxWindow& frame, WindowGrid& windowGrid) {
+    using clock = std::chrono::steady_clock;
+    auto milliseconds = [](clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+    windowGrid.setView(log.zoomLevels, log.viewStart);
+    windowGrid.Update();
+    std::vector<double> handling[TYPES];
+    std::vector<double> painting{};
+    for(const Event& event : log.events) {
+        clock::time_point start = clock::now();
+        if(event.type == Event::Type::key) {
+            wxKeyEvent keyEvent{wxEVT_CHAR_HOOK};
+            keyEvent.m_keyCode = event.data;
+            keyEvent.m_uniChar = static_cast<wxChar>(event.unicode);
+            setModifiers(keyEvent, event.modifiers);
+            keyEvent.SetEventObject(&frame);
+            frame.GetEventHandler()->ProcessEvent(keyEvent);
+        } else {
+            const wxEventType types[] {wxEVT_MOTION, wxEVT_LEFT_DOWN, wxEVT_LEFT_UP, wxEVT_MOUSEWHEEL};
+            wxMouseEvent mouseEvent{types[static_cast<int>(event.type)]};
+            mouseEvent.m_x = event.x;
+            mouseEvent.m_y = event.y;
+            mouseEvent.m_leftDown = event.buttons & 1;
+            mouseEvent.m_middleDown = event.buttons & 2;
+            setModifiers(mouseEvent, event.modifiers);
+            if(event.type == Event::Type::wheel) {
+                mouseEvent.m_wheelRotation = event.data;
+                mouseEvent.m_wheelDelta = WHEEL_STEP;
+                mouseEvent.m_linesPerAction = 3;
+                mouseEvent.m_wheelAxis = wxMOUSE_WHEEL_VERTICAL;
+            }
+            mouseEvent.SetEventObject(&windowGrid);
+            windowGrid.GetEventHandler()->ProcessEvent(mouseEvent);
+        }
+        clock::time_point handled = clock::now();
+        uint64_t frames = windowGrid.framesDrawn;
+        windowGrid.Update();
+        handling[static_cast<int>(event.type)].push_back(milliseconds(handled - start));
+        if(windowGrid.framesDrawn != frames) {
+            painting.push_back(milliseconds(clock::now() - handled));
+        }
+    }
+    std::string table = "event       count    p50 ms    p90 ms    p99 ms    max ms\n";
+    for(int i = 0; i < TYPES; i ++) {
+        table += row(typeNames[i], handling[i]);
+    }
+    return table + row("paint", painting);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <wx/wx.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <filesystem>
+
+class WindowGrid;
+
+//Mouse and key input to the editor, recorded to a file and played back to time how quickly it responds.
+//Right clicks and the shortcuts that open dialogs are left out, they would stop a replay waiting for someone.
+namespace input {
+    struct Event {
+        enum class Type {
+            motion, left_down, left_up, wheel, key
+        };
+        Type type;
+        int64_t time; //microseconds since recording started
+        int x, y; //in the window, for mouse events
+        int buttons; //1 left, 2 middle
+        int modifiers; //wxMOD_ flags
+        int data; //wheel rotation, or key code
+        int unicode; //unicode key, for key events
+    };
+
+    struct Log {
+        //The view when recording started, restored before a replay so the positions land on the same cells
+        wxSize clientSize{};
+        wxPoint viewStart{}; //in pixels
+        int zoomLevels{0};
+        std::vector<Event> events;
+        //Throws std::runtime_error if the file cannot be read or is not a log
+        static Log load(const std::filesystem::path& path);
+        //Throws std::runtime_error if the file cannot be written
+        void save(const std::filesystem::path& path) const;
+    };
+
+    //Records while it exists
+    class Recorder {
+    public:
+        Recorder(wxWindow& frame, WindowGrid& windowGrid);
+        ~Recorder();
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+        const Log& getLog() const;
+    private:
+        void onMouse(wxMouseEvent& event);
+        void onKey(wxKeyEvent& event);
+        void add(Event::Type type, int x, int y, int buttons, int modifiers, int data, int unicode);
+        wxWindow& frame;
+        WindowGrid& windowGrid;
+        std::chrono::steady_clock::time_point start;
+        Log log;
+    };
+
+    //Sends every event of log as fast as it is handled, painting after each one, and returns a table of percentiles
+    //of the time spent handling and painting. Keys go to frame, the rest to windowGrid.
+    std::string replay(const Log& log, wxWindow& frame, WindowGrid& windowGrid);
+}
@@ -1,27 +1,214 @@
 #include <sstream>
 #include <iomanip>
 #include <utility>
+#include <cmath>
+#include <cwchar>
+#include <atomic>
+#include <mutex>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <cstring>
+#include <unordered_map>
 #include "Item.h"
+#include "Resources.h"
+#include "Components.h"
+#include "Memory.h"
+#include "Profiler.h"
 
-Item::Item(Item::ItemType type, int shape, double value, std::wstring extraData) : type{type}, shape{shape}, value{value}, extraData{std::move(extraData)} {}
+namespace {
+    constexpr size_t HEADER_BYTES = 2 * sizeof(int) + sizeof(double) + sizeof(size_t); //of a saved item, before its label
+
+    //Entries handed out by id, each kept once. Entries never move once added, in chunks that double in size, so
+    //reading one needs no lock and only adding one does.
+    template<typename T, typename Key, Key (*keyOf)(const T&)>
+    class Interned {
+    public:
+        Interned() = default;
+        Interned(const Interned&) = delete;
+        ~Interned() {
+            for(std::atomic<T*>& chunk : chunks) {
+                delete[] chunk.load(std::memory_order_relaxed);
+            }
+        }
+        //Id of the entry equal to entry, which is added if there is none. Ids count up from 0.
+        uint32_t add(const T& entry) {
+            std::lock_guard<std::mutex> lock{mutex};
+            auto found = ids.find(keyOf(entry));
+            if(found != ids.end()) return found->second;
+            auto [chunk, offset] = locate(count);
+            T* entries = chunks[chunk].load(std::memory_order_relaxed);
+            if(entries == nullptr) {
+                entries = new T[static_cast<size_t>(FIRST_CHUNK) << chunk];
+                chunks[chunk].store(entries, std::memory_order_release);
+            }
+            entries[offset] = entry;
+            ids.emplace(keyOf(entries[offset]), count);
+            return count ++;
+        }
+        //What entry id adds to memoryUsage
+        size_t entryBytes(uint32_t id) const {
+            size_t bytes = sizeof(T) + sizeof(void*) + sizeof(typename decltype(ids)::value_type) + 2 * sizeof(void*);
+            if constexpr(std::is_same_v<T, std::wstring>) bytes += memory::heapBytes((*this)[id]);
+            return bytes;
+        }
+        const T& operator[](uint32_t id) const {
+            auto [chunk, offset] = locate(id);
+            return chunks[chunk].load(std::memory_order_acquire)[offset];
+        }
+        size_t memoryUsage() {
+            std::lock_guard<std::mutex> lock{mutex};
+            size_t bytes = ids.bucket_count() * sizeof(void*) + ids.size() * (sizeof(typename decltype(ids)::value_type) + 2 * sizeof(void*));
+            for(int chunk = 0; chunk < CHUNKS && chunks[chunk].load(std::memory_order_relaxed) != nullptr; chunk ++) {
+                bytes += (static_cast<size_t>(FIRST_CHUNK) << chunk) * sizeof(T);
+            }
+            if constexpr(std::is_same_v<T, std::wstring>) {
+                for(uint32_t id = 0; id < count; id ++) {
+                    bytes += memory::heapBytes((*this)[id]);
+                }
+            }
+            return bytes;
+        }
+    private:
+        constexpr static uint32_t FIRST_CHUNK = 1024;
+        constexpr static int CHUNKS = 22; //enough for 2^32 entries
+        static std::pair<int, uint32_t> locate(uint32_t id) {
+            int chunk = std::bit_width(id / FIRST_CHUNK + 1) - 1;
+            return {chunk, id - FIRST_CHUNK * ((1u << chunk) - 1)};
+        }
+        std::atomic<T*> chunks[CHUNKS]{}; //chunk i holds FIRST_CHUNK << i entries
+        std::mutex mutex;
+        std::unordered_map<Key, uint32_t> ids;
+        uint32_t count{0};
+    };
+
+    std::wstring_view textOf(const std::wstring& text) {
+        return text; //views the entry itself, which never moves
+    }
+
+    uint64_t bitsOf(const double& value) {
+        return std::bit_cast<uint64_t>(value); //so a NaN is found again
+    }
+
+    Interned<std::wstring, std::wstring_view, textOf>& labels() {
+        static Interned<std::wstring, std::wstring_view, textOf> table{};
+        return table;
+    }
+
+    Interned<double, uint64_t, bitsOf>& values() {
+        static Interned<double, uint64_t, bitsOf> table{};
+        return table;
+    }
+
+    constexpr uint32_t VALUE_ID = 0x7F800001; //bits of the first value kept in the table, a NaN
+    constexpr uint32_t VALUE_IDS = 0x7FFFFF; //the NaNs left with the sign bit clear
+}
+
+Item::Label::Label(const std::wstring& text) : id{text.empty() ? 0 : labels().add(text) + 1} {}
+
+Item::Label::Label(const wchar_t* text) : Label{std::wstring{text}} {}
+
+Item::Label::operator const std::wstring&() const {
+    return str();
+}
+
+const std::wstring& Item::Label::str() const {
+    static const std::wstring none{};
+    return id == 0 ? none : labels()[id - 1];
+}
+
+Item::Value::Value(double value) {
+    bool fits = std::isfinite(value) ? std::abs(value) <= std::numeric_limits<float>::max() : std::isinf(value);
+    if(fits && static_cast<double>(static_cast<float>(value)) == value) {
+        bits = std::bit_cast<uint32_t>(static_cast<float>(value));
+        return;
+    }
+    uint32_t id = values().add(value);
+    if(id >= VALUE_IDS) {
+        throw std::length_error{"Too many distinct component values"};
+    }
+    bits = VALUE_ID + id;
+}
+
+Item::Value::operator double() const {
+    if(bits >= VALUE_ID && bits < VALUE_ID + VALUE_IDS) return values()[bits - VALUE_ID];
+    return static_cast<double>(std::bit_cast<float>(bits));
+}
+
+uint64_t Item::hash() const {
+    //The finalizer of splitmix64 over each half in turn
+    auto mix = [](uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ull;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    };
+    uint64_t fields = static_cast<uint64_t>(type) | (static_cast<uint64_t>(shape) << 8) | (static_cast<uint64_t>(value.bits) << 16);
+    return mix(mix(fields) ^ extraData.id);
+}
+
+size_t Item::tableBytes(std::unordered_set<uint64_t>& seen) const {
+    size_t bytes = 0;
+    if(!extraData.empty() && seen.insert(extraData.id).second) {
+        bytes += labels().entryBytes(extraData.id - 1);
+    }
+    if(value.bits >= VALUE_ID && value.bits < VALUE_ID + VALUE_IDS && seen.insert((static_cast<uint64_t>(1) << 32) | value.bits).second) {
+        bytes += values().entryBytes(value.bits - VALUE_ID);
+    }
+    return bytes;
+}
+
+size_t Item::internedBytes() {
+    return labels().memoryUsage() + values().memoryUsage();
+}
+
+Item::Item(Item::ItemType type, int shape, double value, std::wstring extraData) : type{type}, shape{static_cast<uint8_t>(shape)}, value{value}, extraData{extraData} {}
+
+//Files keep the layout items had before they were packed: an int each for type and shape, a double and the label
+Item::Item(const char*& data, const char* end) {
+    size_t size = savedSize(data, end);
+    if(size == 0) {
+        throw std::runtime_error{"File invalid"};
+    }
+    int savedType;
+    int savedShape;
+    double savedValue;
+    size_t stringSize;
+    std::memcpy(&savedType, data, sizeof(int));
+    std::memcpy(&savedShape, data + sizeof(int), sizeof(int));
+    std::memcpy(&savedValue, data + 2 * sizeof(int), sizeof(double));
+    std::memcpy(&stringSize, data + 2 * sizeof(int) + sizeof(double), sizeof(size_t));
+    std::wstring text(stringSize, 0); //using () to avoid initializer-list constructor
+    std::memcpy(text.data(), data + HEADER_BYTES, stringSize * sizeof(wchar_t));
+    type = static_cast<ItemType>(savedType);
+    shape = static_cast<uint8_t>(savedShape);
+    value = savedValue;
+    extraData = text;
+    data += size;
+}
 
-Item::Item(std::ifstream& ifstream) {
+size_t Item::savedSize(const char* data, const char* end) {
+    auto available = static_cast<size_t>(end - data);
+    if(available < HEADER_BYTES) return 0;
     size_t stringSize;
-    ifstream.read(reinterpret_cast<char*>(&type), sizeof(Item::ItemType));
-    ifstream.read(reinterpret_cast<char*>(&shape), sizeof(int));
-    ifstream.read(reinterpret_cast<char*>(&value), sizeof(double));
-    ifstream.read(reinterpret_cast<char*>(&stringSize), sizeof(size_t));
-    extraData = std::wstring(stringSize, 0); //using () to avoid initializer-list constructor
-    ifstream.read(reinterpret_cast<char*>(extraData.data()), stringSize * sizeof(wchar_t));
+    std::memcpy(&stringSize, data + 2 * sizeof(int) + sizeof(double), sizeof(size_t));
+    if(stringSize > (available - HEADER_BYTES) / sizeof(wchar_t)) return 0;
+    return HEADER_BYTES + stringSize * sizeof(wchar_t);
 }
 
-void Item::save(std::ofstream& ofstream) {
-    ofstream.write(reinterpret_cast<const char*>(&type), sizeof(Item::ItemType));
-    ofstream.write(reinterpret_cast<const char*>(&shape), sizeof(int));
-    ofstream.write(reinterpret_cast<const char*>(&value), sizeof(double));
-    size_t stringSize = extraData.size();
+void Item::save(std::ofstream& ofstream) const {
+    int savedType = static_cast<int>(type);
+    int savedShape = shape;
+    double savedValue = value;
+    const std::wstring& text = extraData;
+    ofstream.write(reinterpret_cast<const char*>(&savedType), sizeof(int));
+    ofstream.write(reinterpret_cast<const char*>(&savedShape), sizeof(int));
+    ofstream.write(reinterpret_cast<const char*>(&savedValue), sizeof(double));
+    size_t stringSize = text.size();
     ofstream.write(reinterpret_cast<const char*>(&stringSize), sizeof(size_t));
-    ofstream.write(reinterpret_cast<char*>(extraData.data()), stringSize * sizeof(wchar_t));
+    ofstream.write(reinterpret_cast<const char*>(text.data()), stringSize * sizeof(wchar_t));
 }
 
 namespace {
@@ -83,197 +270,169 @@ namespace {
 
 std::wstring Item::getValueStr(int split) const {
     if(!extraData.empty()) {
-        if(split != 0 && extraData.size() > split) {
+        const std::wstring& text = extraData;
+        if(split != 0 && text.size() > split) {
             std::wstring splitData{};
-            for(int i = 0; i < extraData.size(); i ++) {
+            for(int i = 0; i < text.size(); i ++) {
                 if(i % split == 0 && i != 0) splitData += '\n';
-                splitData += extraData[i];
+                splitData += text[i];
             }
             return splitData;
         }
-        return extraData;
+        return text;
+    }
+    const components::Component* part = components::find(type);
+    if(part == nullptr || part->unit == 0) return L"";
+    return valueToStr(value, part->unit, split);
+}
+
+std::wstring Item::formatValue(double value, wchar_t unit) {
+    return valueToStr(value, unit, 0);
+}
+
+bool Item::parseValue(const std::wstring& text, double& value) {
+    const wchar_t* begin = text.c_str();
+    wchar_t* end;
+    double number = std::wcstod(begin, &end);
+    if(end == begin) return false;
+    while(*end == ' ') end ++;
+    const std::wstring prefixes = L"yzafpnum kMGTPEZY"; //the space stands in for no prefix, 10^0
+    wchar_t symbol = *end == L'\u00B5' ? L'u' : *end;
+    size_t prefix = symbol == 0 || symbol == ' ' ? std::wstring::npos : prefixes.find(symbol);
+    if(prefix != std::wstring::npos) {
+        number *= std::pow(10.0, 3 * (static_cast<int>(prefix) - 8));
+        end ++;
     }
-    switch(type) {
-        case ItemType::resistor: {
-            return valueToStr(value, L'\u03A9', split);
+    if(components::isUnit(*end)) end ++;
+    while(*end == ' ') end ++;
+    if(*end != 0) return false;
+    value = number;
+    return true;
+}
+
+Item Item::rotated(int quarterTurns) const {
+    Item item = *this;
+    for(int i = 0; i < (quarterTurns & 3); i ++) {
+        if(item.type == ItemType::wire) {
+            int turned = 0;
+            if(item.shape & UP) turned |= RIGHT;
+            if(item.shape & RIGHT) turned |= DOWN;
+            if(item.shape & DOWN) turned |= LEFT;
+            if(item.shape & LEFT) turned |= UP;
+            item.shape = (item.shape & DEPENDENT) | turned;
+        } else if(item.type == ItemType::instance) {
+            item.shape = (item.shape + 1) & 3;
+        } else if(const components::Component* part = components::find(item.type)) {
+            item.shape = part->rotated(item.shape);
         }
-        case ItemType::volt_source:
-            return valueToStr(value, 'V', split);
-        case ItemType::amp_source:
-            return valueToStr(value, 'A', split);
-        case ItemType::capacitor:
-            return valueToStr(value, 'F', split);
-        default:
-            return L"";
     }
+    return item;
 }
 
-void Item::draw(wxDC& dc, int cellSize, int dotSize, bool rotatedText, wxBitmap* resistorBitmaps, wxBitmap* capacitorBitmaps, wxBitmap* ampSourceBitmaps, wxBitmap* voltSourceBitmaps, wxBitmap* switchBitmaps) {
-    switch(type) {
-        case ItemType::none:
-            if(dotSize != -1) {
-                dc.DrawCircle(cellSize / 2 , cellSize / 2, std::max(cellSize * dotSize / 128, 1));
-            }
-            break;
-        case Item::ItemType::resistor: {
-            if (shape == Item::HORIZONTAL) {
-                dc.DrawBitmap(resistorBitmaps[0], 0, 0);
-                dc.DrawLabel(getValueStr(), wxRect{0, cellSize * 4 / 17, cellSize, cellSize}, wxALIGN_CENTER_HORIZONTAL | wxALIGN_TOP);
-            } else {
-                dc.DrawBitmap(resistorBitmaps[1], 0, 0);
-                if(rotatedText) {
-                    std::wstring valueStr = getValueStr();
-                    wxSize textSize = dc.GetTextExtent(valueStr);
-                    dc.DrawRotatedText(valueStr, cellSize * 40 / 51, cellSize / 2 - textSize.GetWidth() / 2, 270);
-                } else {
-                    dc.DrawLabel(getValueStr(5), wxRect{cellSize * 11 / 17, 0, 0, cellSize}, wxALIGN_CENTER_VERTICAL | wxALIGN_LEFT);
-                }
-            }
-            break;
+void Item::draw(wxDC& dc, int cellSize, int dotSize, bool rotatedText, resources::Glyphs& glyphs) const {
+    if(profiler::enabled() && type != ItemType::none && type != ItemType::instance) {
+        if(type != ItemType::wire) profiler::count(profiler::Counter::glyphs_blitted);
+        if(type != ItemType::wire || !extraData.empty()) profiler::count(profiler::Counter::labels_drawn);
+    }
+    if(type == ItemType::none) {
+        if(dotSize != -1) {
+            dc.DrawCircle(cellSize / 2 , cellSize / 2, std::max(cellSize * dotSize / 128, 1));
         }
-        case Item::ItemType::capacitor: {
-            if (shape == Item::HORIZONTAL) {
-                dc.DrawBitmap(capacitorBitmaps[0], 0, 0);
-                dc.DrawLabel(getValueStr(), wxRect{0, cellSize * 2 / 17, cellSize, cellSize}, wxALIGN_CENTER_HORIZONTAL | wxALIGN_TOP);
-            } else {
-                dc.DrawBitmap(capacitorBitmaps[1], 0, 0);
-                if(rotatedText) {
-                    std::wstring valueStr = getValueStr();
-                    wxSize textSize = dc.GetTextExtent(valueStr);
-                    dc.DrawRotatedText(valueStr, cellSize * 31 / 34, cellSize / 2 - textSize.GetWidth() / 2, 270);
-                } else {
-                    dc.DrawLabel(getValueStr(6), wxRect{cellSize * 4 / 7, 0, 0, cellSize / 2}, wxALIGN_CENTER_VERTICAL | wxALIGN_LEFT);
-                }
-            }
-            break;
+        return;
+    }
+    const wxBitmap* bitmap = glyph(glyphs);
+    if(bitmap != nullptr) {
+        dc.DrawBitmap(*bitmap, 0, 0);
+    }
+    if(type == ItemType::wire) {
+        int directions = 0;
+        wxPoint middle = wxPoint{cellSize / 2, cellSize / 2};
+        if (shape & Item::UP) {
+            dc.DrawLine(wxPoint{cellSize / 2, 0}, middle);
+            directions++;
         }
-        case Item::ItemType::wire: {
-            int directions = 0;
-            bool up, down, left, right;
-            up = down = left = right = false;
-            wxPoint middle = wxPoint{cellSize / 2, cellSize / 2};
-            if (shape & Item::UP) {
-                dc.DrawLine(wxPoint{cellSize / 2, 0}, middle);
-                directions++;
-                up = true;
-            }
-            if (shape & Item::DOWN) {
-                dc.DrawLine(wxPoint{cellSize / 2, cellSize}, middle);
-                directions++;
-                down = true;
-            }
-            if (shape & Item::LEFT) {
-                dc.DrawLine(wxPoint{0, cellSize / 2}, middle);
-                directions++;
-                left = true;
-            }
-            if (shape & Item::RIGHT) {
-                dc.DrawLine(wxPoint{cellSize, cellSize / 2}, middle);
-                directions++;
-                right = true;
-            }
-            if (directions > 2) {
-                dc.DrawCircle(middle, std::max(cellSize * 3 / 128, 1));
-            }
-            if(!extraData.empty()) {
-                wxSize textSize = dc.GetTextExtent(extraData);
-                if(directions == 4 || (up && right && directions == 2) || (right && directions == 1) || (up && directions == 1 && !rotatedText)) { //draw in top right corner
-                    dc.DrawLabel(getValueStr(6), wxRect{cellSize * 13/24, 0, 0, cellSize / 2}, wxALIGN_BOTTOM | wxALIGN_LEFT);
-                } else if(left && right) { //draw horizontally centered
-                    if(up) {
-                        dc.DrawLabel(extraData, wxRect{0, cellSize / 2, cellSize, 0}, wxALIGN_CENTER_HORIZONTAL | wxALIGN_TOP);
-                    } else {
-                        dc.DrawLabel(extraData, wxRect{0, 0, cellSize, cellSize / 2}, wxALIGN_CENTER_HORIZONTAL | wxALIGN_BOTTOM);
-                    }
-                } else if(up && down) { //draw vertically centered
-                    if(rotatedText) {
-                        if(right) {
-                            dc.DrawRotatedText(extraData, cellSize / 2, cellSize / 2 - textSize.GetWidth() / 2, 270);
-                        } else {
-                            dc.DrawRotatedText(extraData, cellSize * 13 / 24 + textSize.GetHeight(), cellSize / 2 - textSize.GetWidth() / 2, 270);
-                        }
-                    } else {
-                        std::wstring valueStr = getValueStr(6);
-                        if(right) {
-                            dc.DrawLabel(valueStr, wxRect{0, 0, cellSize * 11 / 24, cellSize}, wxALIGN_CENTER_VERTICAL | wxALIGN_RIGHT);
-                        } else {
-                            dc.DrawLabel(valueStr, wxRect{cellSize * 13 / 24, 0, 0, cellSize}, wxALIGN_CENTER_VERTICAL | wxALIGN_LEFT);
-                        }
-                    }
-                } else if(right || (down && directions == 1 && !rotatedText)) { //draw in bottom right corner
-                    dc.DrawLabel(getValueStr(6), wxRect{cellSize * 13/24, cellSize * 13 / 24, 0, 0}, wxALIGN_TOP | wxALIGN_LEFT);
-                } else if(left && down) { //Draw in bottom left corner
-                    dc.DrawLabel(getValueStr(6), wxRect{0, cellSize * 13 / 24, cellSize * 11 / 24, 0}, wxALIGN_RIGHT | wxALIGN_TOP);
-                } else if(left) { //Draw in top left corner
-                    dc.DrawLabel(getValueStr(6), wxRect{0, 0, cellSize * 11 / 24, cellSize * 11 / 24}, wxALIGN_RIGHT | wxALIGN_BOTTOM);
-                } else if(up) { //Draw in top right corner, rotated
-                    dc.DrawRotatedText(extraData, cellSize * 13 / 24 + textSize.GetHeight(), cellSize / 4 - textSize.GetWidth() / 2, 270);
-                } else if(down) { //Draw in bottom right corner, rotated
-                    dc.DrawRotatedText(extraData, cellSize * 13 / 24 + textSize.GetHeight(), cellSize * 3 / 4 - textSize.GetWidth() / 2, 270);
-                } else { //Draw in center
-                    dc.DrawLabel(extraData, wxRect{0, 0, cellSize, cellSize}, wxALIGN_CENTER);
-                }
-            }
-            break;
+        if (shape & Item::DOWN) {
+            dc.DrawLine(wxPoint{cellSize / 2, cellSize}, middle);
+            directions++;
         }
-        case Item::ItemType::amp_source: case Item::ItemType::volt_source: {
-            wxBitmap* bitmaps = type == Item::ItemType::amp_source ? ampSourceBitmaps : voltSourceBitmaps;
-            int bitmapIndex;
-            if(shape & Item::UP) bitmapIndex = 0;
-            else if(shape & Item::DOWN) bitmapIndex = 1;
-            else if(shape & Item::RIGHT) bitmapIndex = 2;
-            else bitmapIndex = 3;
-            if(shape & Item::DEPENDENT) bitmapIndex += 4;
-            dc.DrawBitmap(bitmaps[bitmapIndex], 0, 0);
-            if((shape & Item::LEFT) || (shape & Item::RIGHT)) {
-                dc.DrawLabel(getValueStr(), wxRect{0, cellSize * 5 / 34, cellSize, cellSize}, wxALIGN_CENTER_HORIZONTAL | wxALIGN_TOP);
-            } else if(rotatedText) {
-                std::wstring valueStr = getValueStr();
-                wxSize textSize = dc.GetTextExtent(valueStr);
-                dc.DrawRotatedText(valueStr, cellSize * 15 / 17, cellSize / 2 - textSize.GetWidth() / 2, 270);
-            } else {
-                dc.DrawLabel(getValueStr(4), wxRect{cellSize * 25 / 34, 0, cellSize, cellSize}, wxALIGN_CENTER_VERTICAL | wxALIGN_LEFT);
-            }
-            break;
+        if (shape & Item::LEFT) {
+            dc.DrawLine(wxPoint{0, cellSize / 2}, middle);
+            directions++;
         }
-        case Item::ItemType::toggle: {
-            bool vertical = false;
-            bool closed = false;
-            int bitmapIndex = 0;
-            if(shape & Item::VERTICAL) {
-                bitmapIndex = 1;
-                vertical = true;
-            }
-            if(shape & Item::CLOSED) {
-                bitmapIndex += 2;
-                closed = true;
-            }
-            dc.DrawBitmap(switchBitmaps[bitmapIndex], 0, 0);
-            if(vertical) {
-                if(rotatedText) {
-                    wxSize textSize = dc.GetTextExtent(extraData);
-                    dc.DrawRotatedText(extraData, cellSize * 13 / 17, cellSize / 2 - textSize.GetWidth() / 2, 270);
-                } else {
-                    dc.DrawLabel(getValueStr(5), wxRect{cellSize * 10 / 17, 0, 0, cellSize}, wxALIGN_CENTER_VERTICAL | wxALIGN_LEFT);
-                }
-            } else if(closed) {
-                dc.DrawLabel(extraData, wxRect{0, cellSize * 5 / 17, cellSize, 0}, wxALIGN_CENTER_HORIZONTAL | wxALIGN_TOP);
-            } else {
-                dc.DrawLabel(extraData, wxRect{0, cellSize * 10 / 17, cellSize, 0}, wxALIGN_CENTER_HORIZONTAL | wxALIGN_TOP);
-            }
+        if (shape & Item::RIGHT) {
+            dc.DrawLine(wxPoint{cellSize, cellSize / 2}, middle);
+            directions++;
+        }
+        if (directions > 2) {
+            dc.DrawCircle(middle, std::max(cellSize * 3 / 128, 1));
         }
     }
+    drawLabel(dc, cellSize, rotatedText);
+}
+
+const wxBitmap* Item::glyph(resources::Glyphs& glyphs) const {
+    const components::Component* part = components::find(type);
+    return part ? &glyphs.get(*part, part->variant(shape)) : nullptr;
 }
 
-double Item::defaultValue(Item::ItemType type) {
-    switch(type) {
-        case ItemType::resistor:
-            return 100;
-        case ItemType::volt_source: case Item::ItemType::amp_source:
-            return 10;
-        case ItemType::capacitor:
-            return 1e-4;
-        default:
-            return 0;
+void Item::drawLabel(wxDC& dc, int cellSize, bool rotatedText) const {
+    if(const components::Component* part = components::find(type)) {
+        const components::Anchor& anchor = part->anchor(shape);
+        if(part->horizontal(shape)) {
+            dc.DrawLabel(getValueStr(), wxRect{0, static_cast<int>(cellSize * anchor.below), cellSize, cellSize}, wxALIGN_CENTER_HORIZONTAL | wxALIGN_TOP);
+        } else if(rotatedText) {
+            std::wstring valueStr = getValueStr();
+            wxSize textSize = dc.GetTextExtent(valueStr);
+            dc.DrawRotatedText(valueStr, static_cast<int>(cellSize * anchor.rotated), cellSize / 2 - textSize.GetWidth() / 2, 270);
+        } else {
+            dc.DrawLabel(getValueStr(anchor.split), wxRect{static_cast<int>(cellSize * anchor.beside), 0, 0, static_cast<int>(cellSize * anchor.height)},
+                         wxALIGN_CENTER_VERTICAL | wxALIGN_LEFT);
+        }
+        return;
+    }
+    if(type != ItemType::wire) return;
+    const std::wstring& label = extraData;
+    if(label.empty()) return;
+    bool up = shape & Item::UP;
+    bool down = shape & Item::DOWN;
+    bool left = shape & Item::LEFT;
+    bool right = shape & Item::RIGHT;
+    int directions = up + down + left + right;
+    wxSize textSize = dc.GetTextExtent(label);
+    if(directions == 4 || (up && right && directions == 2) || (right && directions == 1) || (up && directions == 1 && !rotatedText)) { //draw in top right corner
+        dc.DrawLabel(getValueStr(6), wxRect{cellSize * 13/24, 0, 0, cellSize / 2}, wxALIGN_BOTTOM | wxALIGN_LEFT);
+    } else if(left && right) { //draw horizontally centered
+        if(up) {
+            dc.DrawLabel(label, wxRect{0, cellSize / 2, cellSize, 0}, wxALIGN_CENTER_HORIZONTAL | wxALIGN_TOP);
+        } else {
+            dc.DrawLabel(label, wxRect{0, 0, cellSize, cellSize / 2}, wxALIGN_CENTER_HORIZONTAL | wxALIGN_BOTTOM);
+        }
+    } else if(up && down) { //draw vertically centered
+        if(rotatedText) {
+            if(right) {
+                dc.DrawRotatedText(label, cellSize / 2, cellSize / 2 - textSize.GetWidth() / 2, 270);
+            } else {
+                dc.DrawRotatedText(label, cellSize * 13 / 24 + textSize.GetHeight(), cellSize / 2 - textSize.GetWidth() / 2, 270);
+            }
+        } else {
+            std::wstring valueStr = getValueStr(6);
+            if(right) {
+                dc.DrawLabel(valueStr, wxRect{0, 0, cellSize * 11 / 24, cellSize}, wxALIGN_CENTER_VERTICAL | wxALIGN_RIGHT);
+            } else {
+                dc.DrawLabel(valueStr, wxRect{cellSize * 13 / 24, 0, 0, cellSize}, wxALIGN_CENTER_VERTICAL | wxALIGN_LEFT);
+            }
+        }
+    } else if(right || (down && directions == 1 && !rotatedText)) { //draw in bottom right corner
+        dc.DrawLabel(getValueStr(6), wxRect{cellSize * 13/24, cellSize * 13 / 24, 0, 0}, wxALIGN_TOP | wxALIGN_LEFT);
+    } else if(left && down) { //Draw in bottom left corner
+        dc.DrawLabel(getValueStr(6), wxRect{0, cellSize * 13 / 24, cellSize * 11 / 24, 0}, wxALIGN_RIGHT | wxALIGN_TOP);
+    } else if(left) { //Draw in top left corner
+        dc.DrawLabel(getValueStr(6), wxRect{0, 0, cellSize * 11 / 24, cellSize * 11 / 24}, wxALIGN_RIGHT | wxALIGN_BOTTOM);
+    } else if(up) { //Draw in top right corner, rotated
+        dc.DrawRotatedText(label, cellSize * 13 / 24 + textSize.GetHeight(), cellSize / 4 - textSize.GetWidth() / 2, 270);
+    } else if(down) { //Draw in bottom right corner, rotated
+        dc.DrawRotatedText(label, cellSize * 13 / 24 + textSize.GetHeight(), cellSize * 3 / 4 - textSize.GetWidth() / 2, 270);
+    } else { //Draw in center
+        dc.DrawLabel(label, wxRect{0, 0, cellSize, cellSize}, wxALIGN_CENTER);
     }
 }
@@ -1,12 +1,54 @@
 #pragma once
 #include <string>
 #include <fstream>
+#include <cstdint>
+#include <unordered_set>
 #include "wx/dc.h"
 
+namespace resources {
+    class Glyphs;
+}
+
+//A cell's contents, packed into 12 bytes: grids hold millions of these, and most have no label and a value a float
+//holds exactly
 class Item {
 public:
-    enum class ItemType {
-        none, resistor, wire, volt_source, amp_source, capacitor, toggle
+    //Parts, resistor to toggle here and any others after instance, are described in res/components.txt, see Components.h
+    enum class ItemType : uint8_t {
+        none, resistor, wire, volt_source, amp_source, capacitor, toggle, instance
+    };
+
+    //Text kept once in a table shared by every item and referred to by id, so an equal label is an equal id.
+    //Converts to the std::wstring it stands for. Labels are never removed from the table, so only text given to cells
+    //should become one, not text made up on the way such as a netlist's scoped names.
+    class Label {
+    public:
+        Label() = default;
+        Label(const std::wstring& text);
+        Label(const wchar_t* text);
+        operator const std::wstring&() const;
+        const std::wstring& str() const;
+        bool empty() const {
+            return id == 0;
+        }
+        bool operator==(const Label& other) const {
+            return id == other.id;
+        }
+    private:
+        friend class Item;
+        uint32_t id{0}; //0 is the empty label
+    };
+
+    //A double kept in 32 bits: as a float where that is exact, otherwise as the id of a table entry in the NaN bits
+    //no float value uses. Converts to and from double.
+    class Value {
+    public:
+        Value() = default;
+        Value(double value);
+        operator double() const;
+    private:
+        friend class Item;
+        uint32_t bits{0};
     };
 
     constexpr static int HORIZONTAL = 0;
@@ -19,16 +61,35 @@ public:
     constexpr static int DEPENDENT = 16;
 
     ItemType type;
-    int shape;
-    double value;
-    std::wstring extraData;
+    uint8_t shape;
+    Value value;
+    Label extraData;
 
     Item() = default;
     Item(ItemType type, int shape, double value, std::wstring extraData = std::wstring{});
-    explicit Item(std::ifstream& ifstream);
-    void save(std::ofstream& ofstream);
-    void draw(wxDC& dc, int cellSize, int dotSize, bool rotatedText, wxBitmap* resistorBitmaps, wxBitmap* capacitorBitmaps, wxBitmap* ampSourceBitmaps, wxBitmap* voltSourceBitmaps, wxBitmap* switchBitmaps);
-    static double defaultValue(Item::ItemType type);
-private:
+    //Reads the item save wrote at data and moves data past it. Throws std::runtime_error rather than read past end.
+    Item(const char*& data, const char* end);
+    //Bytes save wrote for the item at data, 0 if they would run past end, so saved items can be stepped over unread
+    static size_t savedSize(const char* data, const char* end);
+    void save(std::ofstream& ofstream) const;
+    void draw(wxDC& dc, int cellSize, int dotSize, bool rotatedText, resources::Glyphs& glyphs) const;
+    //The bitmap draw blits for the item, drawn now if glyphs has not yet. Null for wires, instances and empty cells.
+    const wxBitmap* glyph(resources::Glyphs& glyphs) const;
+    //Just the text draw puts next to the item, with the cell's top left corner at the device origin
+    void drawLabel(wxDC& dc, int cellSize, bool rotatedText) const;
+    //Formats value with an SI prefix, e.g. 4.7k followed by unit
+    static std::wstring formatValue(double value, wchar_t unit);
+    //Reads a number with an optional SI prefix and unit, e.g. 4.7k or 10mA. Returns false if text is not one.
+    static bool parseValue(const std::wstring& text, double& value);
+    //The item turned clockwise by quarterTurns. An instance keeps its turns in shape, and names its sub-circuit in extraData.
+    Item rotated(int quarterTurns) const;
+    //Text drawn next to the item: its label if it has one, otherwise its value and unit. Breaks lines every split characters.
     std::wstring getValueStr(int split = 0) const;
+    //Equal items hash equal. Labels and values hash by their ids in the tables, so hashes only compare within one run.
+    uint64_t hash() const;
+    //Bytes the label and value tables spend on this item's entries that are not yet in seen, which they are added to.
+    //Adding up every item of a grid gives what the tables hold for it alone.
+    size_t tableBytes(std::unordered_set<uint64_t>& seen) const;
+    //Bytes of the label and value tables every item shares, whichever grid they came from
+    static size_t internedBytes();
 };
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "IterativeSolver.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+namespace {
+    bool isConductance(Item::ItemType type) {
+        return type == Item::ItemType::resistor || type == Item::ItemType::toggle;
+    }
+
+    double dot(const std::vector<double>& a, const std::vector<double>& b) {
+        double sum = 0;
+        for(size_t i = 0; i < a.size(); i ++) {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+}
+
+IterativeSolver::IterativeSolver(const Netlist& netlist) : IterativeSolver{netlist, Options{}} {}
+
+IterativeSolver::IterativeSolver(const Netlist& netlist, Options options) : elements{netlist.elements}, nodes{netlist.nodeCount()}, options{options} {
+    //Walk out from ground through voltage sources, each one fixes the voltage of the node on its far side
+    std::vector<std::vector<size_t>> sourcesAt(nodes);
+    size_t numSources = 0;
+    for(size_t i = 0; i < elements.size(); i ++) {
+        const Netlist::Element& element = elements[i];
+        if(element.dependent && (element.type == Item::ItemType::volt_source || element.type == Item::ItemType::amp_source)) {
+            throw std::runtime_error{"Dependent sources cannot be simulated"};
+        }
+        if(element.type == Item::ItemType::volt_source) {
+            sourcesAt[element.nodeA].push_back(i);
+            sourcesAt[element.nodeB].push_back(i);
+            numSources ++;
+        }
+    }
+    std::vector<bool> fixed(nodes, false);
+    std::vector<bool> used(elements.size(), false);
+    fixedBy.assign(nodes, 0);
+    if(nodes > 0) fixed[Netlist::GROUND] = true;
+    std::vector<uint32_t> queue{Netlist::GROUND};
+    for(size_t head = 0; head < queue.size() && nodes > 0; head ++) {
+        for(size_t source : sourcesAt[queue[head]]) {
+            if(used[source]) continue;
+            used[source] = true;
+            uint32_t other = elements[source].nodeA == queue[head] ? elements[source].nodeB : elements[source].nodeA;
+            if(fixed[other]) {
+                throw std::runtime_error{"Circuit has no unique solution, check for loops of voltage sources"};
+            }
+            fixed[other] = true;
+            fixedBy[other] = source;
+            fixedOrder.push_back(other);
+            queue.push_back(other);
+        }
+    }
+    if(fixedOrder.size() != numSources) {
+        throw std::runtime_error{"The iterative solver needs every voltage source connected to ground"};
+    }
+
+    unknown.assign(nodes, -1);
+    int rows = 0;
+    for(uint32_t node = 0; node < nodes; node ++) {
+        if(!fixed[node]) unknown[node] = rows++;
+    }
+    std::vector<std::pair<int, int>> entries{};
+    for(int row = 0; row < rows; row ++) {
+        entries.emplace_back(row, row);
+    }
+    for(const Netlist::Element& element : elements) {
+        int a = unknown[element.nodeA];
+        int b = unknown[element.nodeB];
+        if(isConductance(element.type) && a != -1 && b != -1 && a != b) {
+            entries.emplace_back(a, b);
+            entries.emplace_back(b, a);
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+    std::vector<int> rowStart(rows + 1, 0);
+    std::vector<int> columns(entries.size());
+    for(size_t p = 0; p < entries.size(); p ++) {
+        rowStart[entries[p].first + 1] ++;
+        columns[p] = entries[p].second;
+    }
+    for(int row = 0; row < rows; row ++) {
+        rowStart[row + 1] += rowStart[row];
+    }
+    matrix = SparseMatrix{rows, std::move(rowStart), std::move(columns)};
+    diagonal.resize(rows);
+    for(int row = 0; row < rows; row ++) {
+        diagonal[row] = matrix.find(row, row);
+    }
+    slots.resize(elements.size(), {-1, -1, -1, -1});
+    for(size_t i = 0; i < elements.size(); i ++) {
+        if(!isConductance(elements[i].type) || elements[i].nodeA == elements[i].nodeB) continue;
+        int a = unknown[elements[i].nodeA];
+        int b = unknown[elements[i].nodeB];
+        slots[i] = {matrix.find(a, a), matrix.find(b, b), a != -1 && b != -1 ? matrix.find(a, b) : -1, a != -1 && b != -1 ? matrix.find(b, a) : -1};
+    }
+    if(options.threads > 1) {
+        pool = std::make_unique<ThreadPool>(options.threads);
+    }
+}
+
+uint32_t IterativeSolver::nodeCount() const {
+    return nodes;
+}
+
+size_t IterativeSolver::elementCount() const {
+    return elements.size();
+}
+
+void IterativeSolver::factorPreconditioner() {
+    int rows = matrix.rows;
+    const std::vector<int>& rowStart = matrix.rowStart;
+    const std::vector<int>& columns = matrix.columns;
+    inverseDiagonal.resize(rows);
+    for(int row = 0; row < rows; row ++) {
+        inverseDiagonal[row] = 1 / matrix.values[diagonal[row]];
+    }
+    if(options.preconditioner != Preconditioner::incomplete_cholesky) return;
+    //IC(0): L keeps the pattern of the lower triangle. Resistor networks are M-matrices, for which this cannot break down.
+    factor.assign(matrix.values.size(), 0);
+    for(int i = 0; i < rows; i ++) {
+        double sumSquares = 0;
+        for(int p = rowStart[i]; p < diagonal[i]; p ++) {
+            int k = columns[p];
+            double sum = matrix.values[p];
+            int q = rowStart[k];
+            for(int s = rowStart[i]; s < p; s ++) { //dot product of rows i and k, over columns before k
+                while(q < diagonal[k] && columns[q] < columns[s]) q ++;
+                if(q < diagonal[k] && columns[q] == columns[s]) sum -= factor[s] * factor[q];
+            }
+            factor[p] = sum / factor[diagonal[k]];
+            sumSquares += factor[p] * factor[p];
+        }
+        double pivot = matrix.values[diagonal[i]] - sumSquares;
+        factor[diagonal[i]] = std::sqrt(pivot > 0 ? pivot : matrix.values[diagonal[i]]);
+    }
+}
+
+void IterativeSolver::precondition(const double* r, double* z) const {
+    int rows = matrix.rows;
+    if(options.preconditioner == Preconditioner::jacobi) {
+        for(int row = 0; row < rows; row ++) {
+            z[row] = r[row] * inverseDiagonal[row];
+        }
+        return;
+    }
+    const std::vector<int>& rowStart = matrix.rowStart;
+    const std::vector<int>& columns = matrix.columns;
+    for(int i = 0; i < rows; i ++) { //L y = r
+        double sum = r[i];
+        for(int p = rowStart[i]; p < diagonal[i]; p ++) {
+            sum -= factor[p] * z[columns[p]];
+        }
+        z[i] = sum / factor[diagonal[i]];
+    }
+    for(int i = rows - 1; i >= 0; i --) { //L^T z = y, going over the rows of L as columns of L^T
+        z[i] /= factor[diagonal[i]];
+        for(int p = rowStart[i]; p < diagonal[i]; p ++) {
+            z[columns[p]] -= factor[p] * z[i];
+        }
+    }
+}
+
+Solver::Solution IterativeSolver::solve(const std::vector<Solver::Assignment>& assignments, Statistics& statistics, const Solver::Solution* initial) {
+    std::vector<double> values(elements.size());
+    for(size_t i = 0; i < elements.size(); i ++) {
+        values[i] = elements[i].value;
+    }
+    for(const Solver::Assignment& assignment : assignments) {
+        if(assignment.element >= elements.size()) {
+            throw std::out_of_range{"Assignment to element " + std::to_string(assignment.element) + " outside netlist"};
+        }
+        values[assignment.element] = assignment.value;
+    }
+    Solver::Solution solution{std::vector<double>(nodes, 0), std::vector<double>(elements.size(), 0)};
+    std::vector<double>& voltages = solution.voltages;
+    for(uint32_t node : fixedOrder) {
+        const Netlist::Element& source = elements[fixedBy[node]];
+        voltages[node] = node == source.nodeA ? voltages[source.nodeB] + values[fixedBy[node]] : voltages[source.nodeA] - values[fixedBy[node]];
+    }
+
+    int rows = matrix.rows;
+    std::fill(matrix.values.begin(), matrix.values.end(), 0);
+    std::vector<double> b(rows, 0);
+    for(int p : diagonal) {
+        matrix.values[p] += Solver::GMIN;
+    }
+    for(size_t i = 0; i < elements.size(); i ++) {
+        const Netlist::Element& element = elements[i];
+        int a = unknown[element.nodeA];
+        int bRow = unknown[element.nodeB];
+        if(isConductance(element.type) && element.nodeA != element.nodeB) {
+            double g = Solver::conductance(element, values[i]);
+            const std::array<int, 4>& slot = slots[i];
+            if(slot[0] != -1) matrix.values[slot[0]] += g;
+            if(slot[1] != -1) matrix.values[slot[1]] += g;
+            if(slot[2] != -1) matrix.values[slot[2]] -= g;
+            if(slot[3] != -1) matrix.values[slot[3]] -= g;
+            //Fixed neighbours move to the right hand side
+            if(a != -1 && bRow == -1) b[a] += g * voltages[element.nodeB];
+            if(bRow != -1 && a == -1) b[bRow] += g * voltages[element.nodeA];
+        } else if(element.type == Item::ItemType::amp_source) {
+            if(a != -1) b[a] += values[i];
+            if(bRow != -1) b[bRow] -= values[i];
+        }
+    }
+    factorPreconditioner();
+
+    std::vector<double> x(rows, 0);
+    if(initial != nullptr && initial->voltages.size() == nodes) {
+        for(uint32_t node = 0; node < nodes; node ++) {
+            if(unknown[node] != -1) x[unknown[node]] = initial->voltages[node];
+        }
+    }
+    std::vector<double> r(rows), z(rows), p(rows), q(rows);
+    matrix.multiply(x.data(), q.data(), pool.get());
+    for(int i = 0; i < rows; i ++) {
+        r[i] = b[i] - q[i];
+    }
+    double bNorm = std::sqrt(dot(b, b));
+    statistics = Statistics{};
+    statistics.residual = bNorm == 0 ? 0 : std::sqrt(dot(r, r)) / bNorm;
+    if(bNorm == 0) {
+        std::fill(x.begin(), x.end(), 0);
+        statistics.converged = true;
+    } else if(statistics.residual <= options.tolerance) {
+        statistics.converged = true;
+    } else {
+        precondition(r.data(), z.data());
+        p = z;
+        double rz = dot(r, z);
+        while(statistics.iterations < options.maxIterations) {
+            matrix.multiply(p.data(), q.data(), pool.get());
+            double alpha = rz / dot(p, q);
+            for(int i = 0; i < rows; i ++) {
+                x[i] += alpha * p[i];
+                r[i] -= alpha * q[i];
+            }
+            statistics.iterations ++;
+            statistics.residual = std::sqrt(dot(r, r)) / bNorm;
+            if(statistics.residual <= options.tolerance) {
+                statistics.converged = true;
+                break;
+            }
+            if(options.cancel && options.cancel->load(std::memory_order_relaxed)) break;
+            precondition(r.data(), z.data());
+            double rzNext = dot(r, z);
+            double beta = rzNext / rz;
+            rz = rzNext;
+            for(int i = 0; i < rows; i ++) {
+                p[i] = z[i] + beta * p[i];
+            }
+        }
+    }
+    for(uint32_t node = 0; node < nodes; node ++) {
+        if(unknown[node] != -1) voltages[node] = x[unknown[node]];
+    }
+
+    //Currents: conductances from Ohm's law, voltage sources from the current their fixed node passes on
+    std::vector<double> leaving(nodes, 0);
+    for(uint32_t node = 0; node < nodes; node ++) {
+        leaving[node] = Solver::GMIN * voltages[node];
+    }
+    for(size_t i = 0; i < elements.size(); i ++) {
+        const Netlist::Element& element = elements[i];
+        double current = 0;
+        if(isConductance(element.type)) {
+            current = Solver::conductance(element, values[i]) * (voltages[element.nodeA] - voltages[element.nodeB]);
+        } else if(element.type == Item::ItemType::amp_source) {
+            current = -values[i];
+        }
+        solution.currents[i] = current;
+        leaving[element.nodeA] += current;
+        leaving[element.nodeB] -= current;
+    }
+    for(size_t i = fixedOrder.size(); i-- > 0;) {
+        uint32_t node = fixedOrder[i];
+        const Netlist::Element& source = elements[fixedBy[node]];
+        double current = node == source.nodeA ? -leaving[node] : leaving[node];
+        solution.currents[fixedBy[node]] = current;
+        uint32_t from = node == source.nodeA ? source.nodeB : source.nodeA;
+        leaving[from] += from == source.nodeA ? current : -current;
+    }
+    return solution;
+}
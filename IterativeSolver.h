@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include "Solver.h"
+#include "SparseMatrix.h"
+
+//Preconditioned conjugate gradient solver for resistive networks, an alternative to Solver for large meshes where
+//the fill-in of a direct factorization gets too big. Voltage sources must connect to ground, directly or through other
+//voltage sources, so they fix node voltages and the remaining nodal system is symmetric positive definite.
+class IterativeSolver {
+public:
+    enum class Preconditioner {
+        jacobi, incomplete_cholesky
+    };
+    struct Options {
+        double tolerance = 1e-10; //relative to the norm of the right hand side
+        int maxIterations = 10000;
+        Preconditioner preconditioner = Preconditioner::incomplete_cholesky;
+        unsigned threads = std::thread::hardware_concurrency();
+        const std::atomic<bool>* cancel = nullptr; //checked every iteration, the solve stops unconverged once it is set
+    };
+    struct Statistics {
+        int iterations = 0;
+        double residual = 0; //relative residual norm when the solver stopped
+        bool converged = false;
+    };
+    explicit IterativeSolver(const Netlist& netlist);
+    IterativeSolver(const Netlist& netlist, Options options);
+    //initial, if given, is a previous solution of the same netlist used as the starting guess
+    Solver::Solution solve(const std::vector<Solver::Assignment>& assignments, Statistics& statistics, const Solver::Solution* initial = nullptr);
+    uint32_t nodeCount() const;
+    size_t elementCount() const;
+private:
+    void precondition(const double* r, double* z) const;
+    void factorPreconditioner();
+    std::vector<Netlist::Element> elements;
+    uint32_t nodes;
+    Options options;
+    std::vector<int> unknown; //row of each free node, -1 for ground and nodes fixed by voltage sources
+    std::vector<uint32_t> fixedOrder; //nodes fixed by voltage sources, each after the node its source hangs from
+    std::vector<size_t> fixedBy; //voltage source fixing each node
+    SparseMatrix matrix;
+    std::vector<std::array<int, 4>> slots; //like Solver::slots, for conductances between free nodes
+    std::vector<int> diagonal;
+    std::vector<double> inverseDiagonal; //Jacobi
+    std::vector<double> factor; //incomplete Cholesky factor, on the lower triangle of the matrix pattern
+    std::unique_ptr<ThreadPool> pool;
+};
@@ -0,0 +1,127 @@
+#include "LiveSimulation.h"
+#include <chrono>
+
+namespace {
+    constexpr size_t MAX_FOLLOWED = 256; //cells a replaced grid may differ in and still be followed edit by edit
+}
+
+LiveSimulation::LiveSimulation(const Grid& grid, Simulation::Backend backend, double tolerance, std::function<void()> published) : backend{backend}, tolerance{tolerance},
+        published{std::move(published)}, replacement{std::make_unique<Design>(Design{grid.getWidth(), grid.getHeight(), grid.snapshot(), grid.subCircuits})}, requested{1}, worker{&LiveSimulation::run, this} {}
+
+LiveSimulation::~LiveSimulation() {
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+        cancel = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void LiveSimulation::edit(uint32_t row, uint32_t col, const Item& item) {
+    {
+        std::lock_guard lock{mutex};
+        edits.push_back(Edit{row, col, item});
+        requested ++;
+        cancel = true;
+    }
+    wake.notify_one();
+}
+
+void LiveSimulation::reset(const Grid& grid) {
+    auto copy = std::make_unique<Design>(Design{grid.getWidth(), grid.getHeight(), grid.snapshot(), grid.subCircuits});
+    {
+        std::lock_guard lock{mutex};
+        replacement = std::move(copy);
+        edits.clear();
+        requested ++;
+        cancel = true;
+    }
+    wake.notify_one();
+}
+
+std::shared_ptr<const LiveSimulation::Snapshot> LiveSimulation::getSnapshot() const {
+    return current.load(std::memory_order_acquire);
+}
+
+void LiveSimulation::publish(std::shared_ptr<const Snapshot> snapshot) {
+    //The snapshot retired last time is dropped here, on the worker, unless a reader still holds it
+    retired = current.exchange(std::move(snapshot), std::memory_order_acq_rel);
+    published();
+}
+
+void LiveSimulation::run() {
+    uint64_t generation = 0;
+    bool stale = true; //simulation does not match mirror and has to be rebuilt
+    while(true) {
+        std::vector<Edit> batch{};
+        std::unique_ptr<Design> design{};
+        {
+            std::unique_lock lock{mutex};
+            wake.wait(lock, [this, generation] {return stopping || requested != generation;});
+            if(stopping) return;
+            batch.swap(edits);
+            design = std::move(replacement);
+            generation = requested;
+            cancel = false;
+        }
+        auto start = std::chrono::steady_clock::now();
+        if(design) {
+            //A replaced grid that differs in a few cells, as after undo, is followed as edits of them
+            std::vector<Edit> differences{};
+            bool follow = !stale && design->width == mirror.getWidth() && design->height == mirror.getHeight() && design->subCircuits == mirror.subCircuits;
+            if(follow) {
+                mirror.gridMap.diff(design->cells, [&differences](uint64_t key, const Item* before, const Item* after) {
+                    if(differences.size() <= MAX_FOLLOWED) {
+                        differences.push_back(Edit{static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key), after ? *after : Item{}});
+                    }
+                });
+            }
+            if(follow && differences.size() <= MAX_FOLLOWED) {
+                batch.insert(batch.begin(), differences.begin(), differences.end());
+            } else {
+                mirror = Grid{design->width, design->height, std::move(design->cells)};
+                mirror.subCircuits = std::move(design->subCircuits);
+                stale = true;
+            }
+        }
+        bool incremental = !stale;
+        for(const Edit& edit : batch) {
+            uint64_t key = (static_cast<uint64_t>(edit.row) << 32) | edit.col;
+            mirror.gridMap = mirror.gridMap.with({{key, edit.item}});
+            if(stale) continue;
+            try {
+                stale = !simulation->update(edit.row, edit.col, edit.item);
+            } catch(std::runtime_error& e) {
+                stale = true;
+            }
+        }
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->generation = generation;
+        if(stale) {
+            incremental = false;
+            try {
+                simulation = std::make_unique<Simulation>(mirror, backend, &cancel, tolerance);
+                stale = false;
+            } catch(Simulation::Cancelled& e) {
+                simulation.reset();
+                continue;
+            } catch(std::runtime_error& e) {
+                simulation.reset();
+                snapshot->error = e.what();
+            }
+        }
+        if(cancel) continue; //newer changes are already queued, so this result would be out of date on arrival
+        if(simulation) {
+            snapshot->overlay = std::make_unique<Overlay>(simulation->getNetlist(), simulation->getSolution());
+            snapshot->nodeCount = simulation->getNetlist().nodeCount();
+            snapshot->elementCount = simulation->getNetlist().elements.size();
+        } else {
+            snapshot->nodeCount = 0;
+            snapshot->elementCount = 0;
+        }
+        snapshot->incremental = incremental;
+        snapshot->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        publish(std::move(snapshot));
+    }
+}
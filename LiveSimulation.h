@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <map>
+#include "Simulation.h"
+#include "Overlay.h"
+
+//Re-solves a circuit on its own thread as the grid is edited. Each result is published as an immutable snapshot
+//behind an atomic pointer, so readers never wait for the solver and a solve never waits for a reader.
+class LiveSimulation {
+public:
+    struct Snapshot {
+        uint64_t generation; //number of posted changes the snapshot includes
+        std::unique_ptr<const Overlay> overlay; //null if the circuit could not be solved
+        std::string error;
+        uint32_t nodeCount;
+        size_t elementCount;
+        double milliseconds; //time spent solving
+        bool incremental; //followed the edits without rebuilding the solver
+    };
+    //published is called on the worker thread after every new snapshot
+    LiveSimulation(const Grid& grid, Simulation::Backend backend, double tolerance, std::function<void()> published);
+    ~LiveSimulation();
+    LiveSimulation(const LiveSimulation&) = delete;
+    LiveSimulation& operator=(const LiveSimulation&) = delete;
+    //Queue an edit of one cell, cancelling a rebuild that is still running for older edits
+    void edit(uint32_t row, uint32_t col, const Item& item);
+    //Queue a full re-solve of a replaced grid, after undo, redo or loading
+    void reset(const Grid& grid);
+    //Latest result, null until the first solve finishes. Safe to call from any thread.
+    std::shared_ptr<const Snapshot> getSnapshot() const;
+private:
+    struct Edit {
+        uint32_t row;
+        uint32_t col;
+        Item item;
+    };
+    //What the worker needs of a grid. Taking one only shares the cells of the version the grid last published, the
+    //worker builds its own index from them.
+    struct Design {
+        uint32_t width;
+        uint32_t height;
+        GridVersion cells;
+        std::map<std::wstring, std::shared_ptr<const SubCircuit>> subCircuits;
+    };
+    void run();
+    void publish(std::shared_ptr<const Snapshot> snapshot);
+    Simulation::Backend backend;
+    double tolerance;
+    std::function<void()> published;
+    //Shared with the worker, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Edit> edits;
+    std::unique_ptr<Design> replacement;
+    uint64_t requested{0};
+    bool stopping{false};
+    std::atomic<bool> cancel{false};
+    //Owned by the worker
+    Grid mirror; //copy of the edited grid
+    std::unique_ptr<Simulation> simulation;
+    std::shared_ptr<const Snapshot> retired; //previous snapshot, so it is usually freed here rather than by a reader
+    std::atomic<std::shared_ptr<const Snapshot>> current;
+    std::thread worker;
+};
@@ -0,0 +1,26 @@
+#include "Memory.h"
+#include <cstdio>
+
+namespace {
+    std::string line(const char* name, size_t bytes) {
+        char buffer[96];
+        std::snprintf(buffer, sizeof(buffer), "%-14s %10.2f MiB\n", name, bytes / 1048576.0);
+        return buffer;
+    }
+}
+
+size_t memory::Report::total() const {
+    return cells + labels + index + undo + subCircuits + clipboard + bitmaps;
+}
+
+double memory::Report::bytesPerCell() const {
+    return occupiedCells == 0 ? 0 : static_cast<double>(cells + labels + index) / static_cast<double>(occupiedCells);
+}
+
+std::string memory::Report::toString() const {
+    std::string text = line("Cells", cells) + line("Labels", labels) + line("Search index", index) + line("Undo history", undo) +
+            line("Sub-circuits", subCircuits) + line("Clipboard", clipboard) + line("Bitmaps", bitmaps) + line("Total", total());
+    char buffer[96];
+    std::snprintf(buffer, sizeof(buffer), "%zu occupied cells, %.1f bytes per cell", occupiedCells, bytesPerCell());
+    return text + buffer;
+}
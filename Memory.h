@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+//Byte counts of what a schematic holds, to size machines and to check that memory savings are real.
+//Node based containers count through Allocator as they allocate and free. The rest are std containers whose
+//capacity is exact, and are added up when a report is asked for.
+namespace memory {
+    //Counts the bytes a container holds. Copies of an allocator share its count, so the node and bucket allocators a
+    //container rebinds to all add to one total, while a copied container starts a count of its own.
+    template<typename T>
+    class Allocator {
+    public:
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+        Allocator() : bytes{std::make_shared<size_t>(0)} {}
+        Allocator(const Allocator&) noexcept = default; //no move, a moved from container still needs a count
+        Allocator& operator=(const Allocator&) noexcept = default;
+        template<typename U>
+        Allocator(const Allocator<U>& other) noexcept : bytes{other.bytes} {}
+        T* allocate(size_t n) {
+            T* pointer = std::allocator<T>{}.allocate(n);
+            *bytes += n * sizeof(T);
+            return pointer;
+        }
+        void deallocate(T* pointer, size_t n) noexcept {
+            *bytes -= n * sizeof(T);
+            std::allocator<T>{}.deallocate(pointer, n);
+        }
+        Allocator select_on_container_copy_construction() const {
+            return Allocator{};
+        }
+        size_t allocated() const {
+            return *bytes;
+        }
+        template<typename U>
+        bool operator==(const Allocator<U>& other) const noexcept {
+            return bytes == other.bytes;
+        }
+    private:
+        template<typename U> friend class Allocator;
+        std::shared_ptr<size_t> bytes;
+    };
+
+    //Heap bytes of a string, zero while it fits in the string itself
+    inline size_t heapBytes(const std::wstring& text) {
+        static const size_t local = std::wstring{}.capacity();
+        return text.capacity() > local ? (text.capacity() + 1) * sizeof(wchar_t) : 0;
+    }
+
+    struct Report {
+        size_t occupiedCells{0};
+        size_t cells{0}; //tiles and trie nodes of the current version
+        size_t labels{0}; //entries of the label and value tables that the cells refer to
+        size_t index{0}; //GridIndex
+        size_t undo{0}; //undo history, only what it does not share with the current version
+        size_t subCircuits{0}; //sub-circuit definitions
+        size_t clipboard{0};
+        size_t bitmaps{0}; //glyph caches and drawn instances, zero without a window
+        size_t total() const;
+        //Cells, labels and index, divided by the cells they hold
+        double bytesPerCell() const;
+        //One subsystem per line, in MiB
+        std::string toString() const;
+    };
+}
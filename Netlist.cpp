@@ -0,0 +1,208 @@
+#include "Netlist.h"
+#include "Components.h"
+#include <algorithm>
+#include <cwctype>
+
+namespace {
+    //Each side of a cell is shared with its neighbour, so sides are named after the cell below or to the right of them
+    uint64_t topSide(uint64_t key) {
+        return key << 1;
+    }
+    uint64_t leftSide(uint64_t key) {
+        return (key << 1) | 1;
+    }
+    uint64_t bottomSide(uint64_t key) {
+        return topSide(key + (static_cast<uint64_t>(1) << 32));
+    }
+    uint64_t rightSide(uint64_t key) {
+        return leftSide(key + 1);
+    }
+
+    //Returns the sides a component connects to, positive terminal first
+    std::pair<uint64_t, uint64_t> terminals(uint64_t key, const components::Component& part, int shape) {
+        if(part.terminals == components::Terminals::four_way) {
+            if(shape & Item::UP) return {topSide(key), bottomSide(key)};
+            if(shape & Item::DOWN) return {bottomSide(key), topSide(key)};
+            if(shape & Item::RIGHT) return {rightSide(key), leftSide(key)};
+            return {leftSide(key), rightSide(key)};
+        }
+        if(shape & Item::VERTICAL) return {topSide(key), bottomSide(key)};
+        return {leftSide(key), rightSide(key)};
+    }
+
+    bool isGroundName(const std::wstring& name) {
+        if(name == L"0") return true;
+        if(name.size() != 3) return false;
+        return std::towupper(name[0]) == L'G' && std::towupper(name[1]) == L'N' && std::towupper(name[2]) == L'D';
+    }
+
+    class DisjointSet {
+    public:
+        uint32_t add() {
+            parent.push_back(static_cast<uint32_t>(parent.size()));
+            return parent.back();
+        }
+        uint32_t find(uint32_t i) {
+            while(parent[i] != i) {
+                parent[i] = parent[parent[i]];
+                i = parent[i];
+            }
+            return i;
+        }
+        void join(uint32_t a, uint32_t b) {
+            parent[find(a)] = find(b);
+        }
+        size_t size() const {
+            return parent.size();
+        }
+    private:
+        std::vector<uint32_t> parent;
+    };
+}
+
+Netlist::Netlist(const Grid& grid) {
+    //Sub-circuit instances are stamped out into their own cells. Cells drawn over an instance replace its cells, and
+    //labels inside an instance only join wires of the same instance, apart from ground.
+    //The scope is appended to the labels of the instance's wires here rather than stored in its items, which would
+    //add every scoped label to the table labels are kept in for as long as the program runs
+    std::vector<std::pair<uint64_t, Item>> placed{};
+    std::vector<std::wstring> scopes{L""}; //of each instance, after none for cells outside them
+    std::vector<size_t> placedScopes{};
+    for(const auto& [key, item] : grid.gridMap) {
+        if(item.type != Item::ItemType::instance) continue;
+        std::vector<std::pair<uint64_t, Item>> expanded = grid.expandInstance(key, item);
+        for(auto& cell : expanded) {
+            const Item* existing = grid.gridMap.find(cell.first);
+            if(existing != nullptr && existing->type != Item::ItemType::instance) continue;
+            placed.push_back(std::move(cell));
+            placedScopes.push_back(scopes.size());
+        }
+        scopes.push_back(L" @" + std::to_wstring(key >> 32) + L"," + std::to_wstring(static_cast<uint32_t>(key)));
+    }
+    struct Cell {
+        uint64_t key;
+        const Item* item;
+        size_t scope;
+    };
+    std::vector<Cell> cells{};
+    cells.reserve(grid.gridMap.size() + placed.size());
+    for(const auto& pair : grid.gridMap) {
+        if(pair.second.type != Item::ItemType::instance) cells.push_back(Cell{pair.first, &pair.second, 0});
+    }
+    for(size_t i = 0; i < placed.size(); i ++) {
+        cells.push_back(Cell{placed[i].first, &placed[i].second, placedScopes[i]});
+    }
+    //Stable, so where instances overlap the first one placed keeps the cell
+    std::stable_sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) {return a.key < b.key;});
+    cells.erase(std::unique(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) {return a.key == b.key;}), cells.end());
+
+    DisjointSet sets{};
+    std::unordered_map<uint64_t, uint32_t> sideIndex{};
+    sideIndex.reserve(cells.size() * 2);
+    auto side = [&](uint64_t side) {
+        auto [iter, inserted] = sideIndex.try_emplace(side, 0);
+        if(inserted) iter->second = sets.add();
+        return iter->second;
+    };
+    std::unordered_map<std::wstring, uint32_t> labels{};
+    std::vector<std::pair<uint32_t, uint32_t>> elementSides{};
+    std::vector<uint32_t> wireSides{};
+    for(const auto& [key, item, scope] : cells) {
+        if(item->type == Item::ItemType::wire) {
+            uint64_t sides[4];
+            int numSides = 0;
+            if(item->shape & Item::UP) sides[numSides++] = topSide(key);
+            if(item->shape & Item::DOWN) sides[numSides++] = bottomSide(key);
+            if(item->shape & Item::LEFT) sides[numSides++] = leftSide(key);
+            if(item->shape & Item::RIGHT) sides[numSides++] = rightSide(key);
+            if(numSides == 0) continue;
+            uint32_t first = side(sides[0]);
+            for(int i = 1; i < numSides; i ++) {
+                sets.join(side(sides[i]), first);
+            }
+            wires.push_back(Wire{key, 0, item->shape});
+            wireSides.push_back(first);
+            if(!item->extraData.empty()) { //wires with the same label are the same net
+                const std::wstring& label = item->extraData;
+                auto [iter, inserted] = labels.try_emplace(scope == 0 || isGroundName(label) ? label : label + scopes[scope], first);
+                if(!inserted) sets.join(first, iter->second);
+            }
+        } else if(const components::Component* part = components::find(item->type)) {
+            auto [a, b] = terminals(key, *part, item->shape);
+            elementSides.emplace_back(side(a), side(b));
+            elementIndex[key] = elements.size();
+            if(!item->extraData.empty()) expressions.emplace_back(elements.size(), item->extraData);
+            elements.push_back(Element{part->model, key, 0, 0, item->shape, elementValue(*item), (item->shape & Item::DEPENDENT) != 0});
+        }
+    }
+
+    //Pick the reference node: a GND label if there is one, otherwise the negative side of the first voltage source
+    uint32_t groundSet = static_cast<uint32_t>(sets.size());
+    for(const auto& [name, set] : labels) {
+        if(isGroundName(name)) {
+            if(groundSet != sets.size()) sets.join(set, groundSet);
+            groundSet = sets.find(set);
+        }
+    }
+    if(groundSet == sets.size()) {
+        for(size_t i = 0; i < elements.size(); i ++) {
+            if(elements[i].type == Item::ItemType::volt_source) {
+                groundSet = sets.find(elementSides[i].second);
+                break;
+            }
+        }
+    }
+    if(groundSet == sets.size() && !elementSides.empty()) {
+        groundSet = sets.find(elementSides[0].second);
+    }
+
+    std::vector<uint32_t> nodeOf(sets.size(), UINT32_MAX);
+    nodeNames.emplace_back();
+    if(groundSet != sets.size()) nodeOf[groundSet] = GROUND;
+    auto node = [&](uint32_t set) {
+        uint32_t& n = nodeOf[sets.find(set)];
+        if(n == UINT32_MAX) {
+            n = static_cast<uint32_t>(nodeNames.size());
+            nodeNames.emplace_back();
+        }
+        return n;
+    };
+    for(size_t i = 0; i < elements.size(); i ++) {
+        elements[i].nodeA = node(elementSides[i].first);
+        elements[i].nodeB = node(elementSides[i].second);
+    }
+    for(size_t i = 0; i < wires.size(); i ++) {
+        wires[i].node = node(wireSides[i]);
+    }
+    for(const auto& [name, set] : labels) {
+        std::wstring& nodeName = nodeNames[node(set)];
+        if(nodeName.empty() || name < nodeName) nodeName = name;
+    }
+}
+
+uint32_t Netlist::nodeCount() const {
+    return static_cast<uint32_t>(nodeNames.size());
+}
+
+size_t Netlist::find(uint32_t row, uint32_t col) const {
+    auto iter = elementIndex.find((static_cast<uint64_t>(row) << 32) | col);
+    return iter == elementIndex.end() ? npos : iter->second;
+}
+
+bool Netlist::connectsLike(size_t element, const Item& item) const {
+    const Element& existing = elements[element];
+    const components::Component* part = components::find(item.type);
+    if(part == nullptr || part->model != existing.type) return false;
+    if(part->model == Item::ItemType::toggle) {
+        return (item.shape & ~Item::CLOSED) == (existing.shape & ~Item::CLOSED);
+    }
+    return item.shape == existing.shape;
+}
+
+double Netlist::elementValue(const Item& item) {
+    const components::Component* part = components::find(item.type);
+    if(part != nullptr && part->model == Item::ItemType::toggle) {
+        return (item.shape & Item::CLOSED) ? 1 : 0;
+    }
+    return item.value;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "Grid.h"
+
+//Electrical view of a Grid: every component becomes a two-terminal element between two nodes
+class Netlist {
+public:
+    struct Element {
+        Item::ItemType type; //the built-in part it behaves as, its components::Component::model
+        uint64_t key; //gridMap key of the cell holding the component
+        uint32_t nodeA; //positive terminal for sources, top/left terminal otherwise
+        uint32_t nodeB;
+        int shape;
+        double value; //ohms, volts, amps or farads; toggles use 1 for closed and 0 for open
+        bool dependent;
+    };
+    struct Wire {
+        uint64_t key;
+        uint32_t node;
+        int shape;
+    };
+    constexpr static uint32_t GROUND = 0;
+    constexpr static size_t npos = static_cast<size_t>(-1);
+    explicit Netlist(const Grid& grid);
+    //Elements are sorted by key, so indices are stable for a given grid
+    std::vector<Element> elements;
+    //Every connected wire cell and its node, sorted by key
+    std::vector<Wire> wires;
+    //Label of each node, empty if the node has no labelled wire
+    std::vector<std::wstring> nodeNames;
+    //Elements whose value is text (a parameter name or expression) rather than a number, by element index
+    std::vector<std::pair<size_t, std::wstring>> expressions;
+    uint32_t nodeCount() const;
+    size_t find(uint32_t row, uint32_t col) const;
+    //True if item, placed where the element is, connects the same way (so only its value differs)
+    bool connectsLike(size_t element, const Item& item) const;
+    static double elementValue(const Item& item);
+private:
+    std::unordered_map<uint64_t, size_t> elementIndex;
+};
@@ -0,0 +1,53 @@
+#include "OutputBuffer.h"
+#include <algorithm>
+
+OutputBuffer::OutputBuffer(std::ostream& ostream) : ostream{ostream}, buffer{std::make_unique<char[]>(BUFFER_SIZE)} {}
+
+OutputBuffer::~OutputBuffer() {
+    flush();
+}
+
+OutputBuffer& OutputBuffer::operator<<(std::string_view text) {
+    if(text.size() > BUFFER_SIZE - used) {
+        flush();
+        if(text.size() > BUFFER_SIZE) {
+            ostream.write(text.data(), static_cast<std::streamsize>(text.size()));
+            return *this;
+        }
+    }
+    std::copy(text.begin(), text.end(), buffer.get() + used);
+    used += text.size();
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(const char* text) {
+    return *this << std::string_view{text};
+}
+
+OutputBuffer& OutputBuffer::operator<<(char c) {
+    if(used == BUFFER_SIZE) flush();
+    buffer[used++] = c;
+    return *this;
+}
+
+void OutputBuffer::writeUtf8(std::wstring_view text, bool xml) {
+    for(size_t i = 0; i < text.size(); i ++) {
+        auto c = static_cast<uint32_t>(text[i]);
+        if(sizeof(wchar_t) == 2 && c >= 0xD800 && c < 0xDC00 && i + 1 < text.size()) { //surrogate pair
+            c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<uint32_t>(text[++i]) - 0xDC00);
+        }
+        if(xml && c == '&') *this << "&amp;";
+        else if(xml && c == '<') *this << "&lt;";
+        else if(xml && c == '>') *this << "&gt;";
+        else if(xml && c == '"') *this << "&quot;";
+        else if(c < 0x80) *this << static_cast<char>(c);
+        else if(c < 0x800) *this << static_cast<char>(0xC0 | (c >> 6)) << static_cast<char>(0x80 | (c & 0x3F));
+        else if(c < 0x10000) *this << static_cast<char>(0xE0 | (c >> 12)) << static_cast<char>(0x80 | ((c >> 6) & 0x3F)) << static_cast<char>(0x80 | (c & 0x3F));
+        else *this << static_cast<char>(0xF0 | (c >> 18)) << static_cast<char>(0x80 | ((c >> 12) & 0x3F)) << static_cast<char>(0x80 | ((c >> 6) & 0x3F)) << static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+void OutputBuffer::flush() {
+    ostream.write(buffer.get(), static_cast<std::streamsize>(used));
+    used = 0;
+}
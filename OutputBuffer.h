@@ -0,0 +1,34 @@
+#pragma once
+#include <ostream>
+#include <memory>
+#include <string_view>
+#include <charconv>
+#include <type_traits>
+
+//Formats straight into a fixed buffer that is handed to the stream whenever it fills, so text files of any size
+//are written without building strings for them
+class OutputBuffer {
+public:
+    explicit OutputBuffer(std::ostream& ostream);
+    ~OutputBuffer();
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+    OutputBuffer& operator<<(std::string_view text);
+    OutputBuffer& operator<<(const char* text);
+    OutputBuffer& operator<<(char c);
+    template<typename T> requires std::is_arithmetic_v<T>
+    OutputBuffer& operator<<(T number) {
+        if(BUFFER_SIZE - used < MAX_NUMBER) flush();
+        used = std::to_chars(buffer.get() + used, buffer.get() + BUFFER_SIZE, number).ptr - buffer.get();
+        return *this;
+    }
+    //Writes text as UTF-8, escaping the characters XML reserves if xml is set
+    void writeUtf8(std::wstring_view text, bool xml = false);
+    void flush();
+private:
+    constexpr static size_t BUFFER_SIZE = 1 << 20;
+    constexpr static size_t MAX_NUMBER = 32; //longest a double or integer can format to
+    std::ostream& ostream;
+    std::unique_ptr<char[]> buffer;
+    size_t used{0};
+};
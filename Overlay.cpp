@@ -0,0 +1,98 @@
+#include "Overlay.h"
+#include <algorithm>
+
+namespace {
+    uint64_t tileKey(uint32_t tileRow, uint32_t tileCol) {
+        return (static_cast<uint64_t>(tileRow) << 32) | tileCol;
+    }
+
+    //Direction from terminal A to terminal B, see Netlist::Element
+    uint8_t flowDirection(const Netlist::Element& element) {
+        switch(element.type) {
+            case Item::ItemType::volt_source: case Item::ItemType::amp_source:
+                if(element.shape & Item::UP) return Item::DOWN;
+                if(element.shape & Item::DOWN) return Item::UP;
+                if(element.shape & Item::RIGHT) return Item::LEFT;
+                return Item::RIGHT;
+            default:
+                return (element.shape & Item::VERTICAL) ? Item::DOWN : Item::RIGHT;
+        }
+    }
+}
+
+Overlay::Overlay(const Netlist& netlist, const Solver::Solution& solution) : minVoltage{0}, maxVoltage{0}, nodeNames{netlist.nodeNames} {
+    bool first = true;
+    for(const Netlist::Wire& wire : netlist.wires) {
+        double voltage = solution.voltages[wire.node];
+        at(wire.key) = Cell{voltage, wire.node, Kind::voltage, static_cast<uint8_t>(wire.shape)};
+        minVoltage = first ? voltage : std::min(minVoltage, voltage);
+        maxVoltage = first ? voltage : std::max(maxVoltage, voltage);
+        first = false;
+    }
+    for(size_t i = 0; i < netlist.elements.size(); i ++) {
+        const Netlist::Element& element = netlist.elements[i];
+        if(element.type == Item::ItemType::capacitor) continue; //no current at DC
+        at(element.key) = Cell{solution.currents[i], static_cast<uint32_t>(i), Kind::current, flowDirection(element)};
+    }
+}
+
+bool Overlay::update(const Netlist& netlist, const Solver::Solution& solution, std::vector<uint64_t>& changed) {
+    double oldMin = minVoltage;
+    double oldMax = maxVoltage;
+    bool first = true;
+    for(const Netlist::Wire& wire : netlist.wires) {
+        double voltage = solution.voltages[wire.node];
+        Cell& cell = at(wire.key);
+        if(cell.value != voltage) {
+            cell.value = voltage;
+            changed.push_back(wire.key);
+        }
+        minVoltage = first ? voltage : std::min(minVoltage, voltage);
+        maxVoltage = first ? voltage : std::max(maxVoltage, voltage);
+        first = false;
+    }
+    for(size_t i = 0; i < netlist.elements.size(); i ++) {
+        const Netlist::Element& element = netlist.elements[i];
+        if(element.type == Item::ItemType::capacitor) continue;
+        Cell& cell = at(element.key);
+        if(cell.value != solution.currents[i]) {
+            cell.value = solution.currents[i];
+            changed.push_back(element.key);
+        }
+    }
+    return minVoltage == oldMin && maxVoltage == oldMax;
+}
+
+Overlay::Cell& Overlay::at(uint64_t key) {
+    auto row = static_cast<uint32_t>(key >> 32);
+    auto col = static_cast<uint32_t>(key);
+    std::unique_ptr<Cell[]>& tile = tiles[tileKey(row / TILE_SIZE, col / TILE_SIZE)];
+    if(!tile) {
+        tile = std::make_unique<Cell[]>(TILE_SIZE * TILE_SIZE); //value-initialized, so every cell starts empty
+    }
+    return tile[(row % TILE_SIZE) * TILE_SIZE + col % TILE_SIZE];
+}
+
+const Overlay::Cell* Overlay::tile(uint32_t tileRow, uint32_t tileCol) const {
+    auto iter = tiles.find(tileKey(tileRow, tileCol));
+    return iter == tiles.end() ? nullptr : iter->second.get();
+}
+
+const Overlay::Cell* Overlay::find(uint32_t row, uint32_t col) const {
+    const Cell* cells = tile(row / TILE_SIZE, col / TILE_SIZE);
+    if(cells == nullptr) return nullptr;
+    const Cell& cell = cells[(row % TILE_SIZE) * TILE_SIZE + col % TILE_SIZE];
+    return cell.kind == Kind::empty ? nullptr : &cell;
+}
+
+double Overlay::getMinVoltage() const {
+    return minVoltage;
+}
+
+double Overlay::getMaxVoltage() const {
+    return maxVoltage;
+}
+
+const std::wstring& Overlay::getNodeName(uint32_t node) const {
+    return nodeNames[node];
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include "Netlist.h"
+#include "Solver.h"
+
+//Simulation results laid out per cell in fixed-size tiles, so painting looks up one tile per block of cells
+//instead of searching for every cell in view
+class Overlay {
+public:
+    enum class Kind : uint8_t {
+        empty, voltage, current
+    };
+    struct Cell {
+        double value; //volts for wires, amps for components
+        uint32_t index; //node for wires, element for components
+        Kind kind;
+        uint8_t shape; //wire directions, or the direction current flows when it is positive
+    };
+    constexpr static uint32_t TILE_SIZE = 64;
+    Overlay(const Netlist& netlist, const Solver::Solution& solution);
+    //Takes a new solution of the same netlist, as after an incremental solve, adding the keys of cells whose result
+    //changed to changed. Returns false if the voltage range moved, which recolours every wire.
+    bool update(const Netlist& netlist, const Solver::Solution& solution, std::vector<uint64_t>& changed);
+    //TILE_SIZE * TILE_SIZE cells in row-major order, or null if nothing in the tile has a result
+    const Cell* tile(uint32_t tileRow, uint32_t tileCol) const;
+    const Cell* find(uint32_t row, uint32_t col) const;
+    double getMinVoltage() const;
+    double getMaxVoltage() const;
+    const std::wstring& getNodeName(uint32_t node) const;
+private:
+    Cell& at(uint64_t key);
+    std::unordered_map<uint64_t, std::unique_ptr<Cell[]>> tiles;
+    double minVoltage;
+    double maxVoltage;
+    std::vector<std::wstring> nodeNames;
+};
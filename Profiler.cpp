@@ -0,0 +1,91 @@
+#include "Profiler.h"
+#include <vector>
+#include <mutex>
+
+std::atomic<bool> profiler::active{false};
+std::atomic<int64_t> profiler::counters[static_cast<int>(Counter::count)]{};
+
+namespace {
+    constexpr size_t MAX_EVENTS = 1 << 20;
+    const char* counterNames[] = {"cells visited", "glyphs blitted", "labels drawn", "bitmap cache hits", "bitmap cache misses", "cells set"};
+    static_assert(sizeof(counterNames) / sizeof(counterNames[0]) == static_cast<size_t>(profiler::Counter::count));
+
+    struct Event {
+        const char* name;
+        int64_t start;
+        int64_t duration; //-1 for a counter sample
+        uint32_t thread;
+        int64_t values[static_cast<int>(profiler::Counter::count)];
+    };
+    const auto epoch = std::chrono::steady_clock::now();
+    std::mutex mutex{};
+    std::vector<Event> events{};
+    size_t dropped = 0;
+    std::atomic<uint32_t> nextThread{1};
+
+    //Small numbers read better than native thread ids in a trace viewer
+    uint32_t threadNumber() {
+        thread_local uint32_t number = nextThread++;
+        return number;
+    }
+
+    void add(const Event& event) {
+        std::lock_guard lock{mutex};
+        if(events.size() < MAX_EVENTS) events.push_back(event);
+        else dropped ++;
+    }
+}
+
+void profiler::setEnabled(bool enabled) {
+    if(enabled) {
+        for(auto& counter : counters) {
+            counter = 0;
+        }
+    }
+    active = enabled;
+}
+
+int64_t profiler::now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void profiler::record(const char* name, int64_t start, int64_t end) {
+    add(Event{name, start, end - start, threadNumber(), {}});
+}
+
+void profiler::sample(const char* name, int64_t* values) {
+    if(!enabled()) return;
+    Event event{name, now(), -1, threadNumber(), {}};
+    for(int i = 0; i < static_cast<int>(Counter::count); i ++) {
+        event.values[i] = counters[i].exchange(0, std::memory_order_relaxed);
+        if(values != nullptr) values[i] = event.values[i];
+    }
+    add(event);
+}
+
+void profiler::writeTrace(std::ostream& ostream) {
+    std::lock_guard lock{mutex};
+    ostream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for(size_t i = 0; i < events.size(); i ++) {
+        const Event& event = events[i];
+        ostream << "{\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << event.start;
+        if(event.duration != -1) {
+            ostream << ",\"ph\":\"X\",\"dur\":" << event.duration << '}';
+        } else {
+            ostream << ",\"ph\":\"C\",\"args\":{";
+            for(int j = 0; j < static_cast<int>(Counter::count); j ++) {
+                ostream << (j == 0 ? "" : ",") << '"' << counterNames[j] << "\":" << event.values[j];
+            }
+            ostream << "}}";
+        }
+        ostream << (i + 1 < events.size() ? ",\n" : "\n");
+    }
+    ostream << "],\"otherData\":{\"dropped events\":" << dropped << "}}\n";
+}
+
+void profiler::clear() {
+    std::lock_guard lock{mutex};
+    events.clear();
+    events.shrink_to_fit();
+    dropped = 0;
+}
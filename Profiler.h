@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+//Scoped timers and counters that can be switched on while the app runs. When off, every hook is one relaxed load
+//of a flag, so they can stay in hot paths. Timings are kept as Chrome trace events, and counters are sampled into the
+//trace whenever sample() is called, usually once per frame.
+namespace profiler {
+    enum class Counter {
+        cells_visited, glyphs_blitted, labels_drawn, bitmap_cache_hits, bitmap_cache_misses, cells_set, count
+    };
+    extern std::atomic<bool> active;
+    extern std::atomic<int64_t> counters[static_cast<int>(Counter::count)];
+
+    inline bool enabled() {
+        return active.load(std::memory_order_relaxed);
+    }
+    inline void count(Counter counter, int64_t amount = 1) {
+        if(enabled()) counters[static_cast<int>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+    void setEnabled(bool enabled);
+    //Microseconds since the profiler started
+    int64_t now();
+    //Records a complete event, name must outlive the profiler (a string literal)
+    void record(const char* name, int64_t start, int64_t end);
+    //Adds the counters to the trace, returns their values since the last sample through values (if given) and resets them
+    void sample(const char* name, int64_t* values = nullptr);
+    //Writes everything recorded so far as Chrome trace_event JSON. Recording is capped, later events are dropped.
+    void writeTrace(std::ostream& ostream);
+    void clear();
+
+    class Scope {
+    public:
+        explicit Scope(const char* name) : name{name}, start{enabled() ? now() : -1} {}
+        ~Scope() {
+            if(start != -1) record(name, start, now());
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        const char* name;
+        int64_t start;
+    };
+}
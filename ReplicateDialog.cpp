@@ -0,0 +1,66 @@
+#include "ReplicateDialog.h"
+#include "wx/propgrid/props.h"
+
+ReplicateDialog::ReplicateDialog(wxWindow* parent, wxSize selectionSize) : wxDialog(parent, wxID_ANY, "Replicate Selection") {
+    wxNumericPropertyValidator validator{wxNumericPropertyValidator::Unsigned};
+    numRowsCtrl = new wxTextCtrl{this, wxID_ANY, "2", wxDefaultPosition, wxDefaultSize, 0, validator};
+    numColsCtrl = new wxTextCtrl{this, wxID_ANY, "2", wxDefaultPosition, wxDefaultSize, 0, validator};
+    rowStrideCtrl = new wxTextCtrl{this, wxID_ANY, std::to_string(selectionSize.y), wxDefaultPosition, wxDefaultSize, 0, validator};
+    colStrideCtrl = new wxTextCtrl{this, wxID_ANY, std::to_string(selectionSize.x), wxDefaultPosition, wxDefaultSize, 0, validator};
+    auto* sizer = new wxFlexGridSizer{4, wxSize{0, 0}};
+    int dip5 = FromDIP(5);
+    auto addRow = [this, sizer, dip5](const wxString& label, wxTextCtrl* rowsCtrl, wxTextCtrl* colsCtrl) {
+        auto* xSeparator = new wxStaticText{this, wxID_ANY, L"\u00D7"};
+        wxFont font = xSeparator->GetFont();
+        font.SetPointSize(15);
+        xSeparator->SetFont(font);
+        sizer->Add(new wxStaticText{this, wxID_ANY, label}, 0, wxLEFT | wxTOP | wxBOTTOM | wxALIGN_CENTER_VERTICAL, dip5);
+        sizer->Add(rowsCtrl, 1, wxTOP | wxBOTTOM | wxALIGN_CENTER_VERTICAL, dip5);
+        sizer->Add(xSeparator, 0, wxALL | wxALIGN_CENTER_VERTICAL, dip5);
+        sizer->Add(colsCtrl, 1, wxRIGHT | wxTOP | wxBOTTOM | wxALIGN_CENTER_VERTICAL, dip5);
+    };
+    addRow("Copies: ", numRowsCtrl, numColsCtrl);
+    addRow("Stride: ", rowStrideCtrl, colStrideCtrl);
+    auto* mainSizer = new wxBoxSizer{wxVERTICAL};
+    mainSizer->Add(sizer);
+    wxSizer* buttonSizer = wxDialog::CreateButtonSizer(wxOK | wxCANCEL);
+    if(buttonSizer != nullptr) {
+        buttonSizer->Layout();
+        mainSizer->Add(buttonSizer, 0, wxBOTTOM | wxALIGN_CENTER_HORIZONTAL, dip5);
+    }
+    mainSizer->Layout();
+    SetSizerAndFit(mainSizer);
+
+    Bind(wxEVT_BUTTON, [this](wxCommandEvent& evt) {wxDialog::EndModal(wxID_OK);}, wxID_OK);
+    Bind(wxEVT_BUTTON, [this](wxCommandEvent& evt) {wxDialog::EndModal(wxID_CANCEL);}, wxID_CANCEL);
+}
+
+ReplicateDialog::Value ReplicateDialog::getValue() const {
+    wxMessageDialog invalidDialog{nullptr, "", "", wxOK | wxCENTRE | wxICON_WARNING};
+    if(numRowsCtrl->GetValue().IsEmpty() || numColsCtrl->GetValue().IsEmpty() || rowStrideCtrl->GetValue().IsEmpty() || colStrideCtrl->GetValue().IsEmpty()) {
+        invalidDialog.SetMessage("Empty field");
+        invalidDialog.ShowModal();
+        return {};
+    }
+    try {
+        int rows = std::stoi(numRowsCtrl->GetValue().utf8_string());
+        int cols = std::stoi(numColsCtrl->GetValue().utf8_string());
+        int rowStride = std::stoi(rowStrideCtrl->GetValue().utf8_string());
+        int colStride = std::stoi(colStrideCtrl->GetValue().utf8_string());
+        if(cols == 0 || rows == 0 || (rowStride == 0 && colStride == 0)) {
+            invalidDialog.SetMessage("Copies and stride may not be 0");
+            invalidDialog.ShowModal();
+            return {};
+        } else if(cols > 100000 || rows > 100000 || rowStride > 100000 || colStride > 100000) {
+            invalidDialog.SetMessage("Values may not be greater than 100000");
+            invalidDialog.ShowModal();
+            return {};
+        } else {
+            return {{cols, rows}, {colStride, rowStride}};
+        }
+    } catch (std::exception &e) {
+        invalidDialog.SetMessage("Failed to parse");
+        invalidDialog.ShowModal();
+        return {};
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <wx/wx.h>
+
+class ReplicateDialog : public wxDialog {
+public:
+    struct Value {
+        wxSize copies; //columns x rows of copies, including the original
+        wxSize stride; //cells from one copy to the next
+    };
+    ReplicateDialog(wxWindow* parent, wxSize selectionSize);
+    //copies is {0, 0} if the input is invalid
+    Value getValue() const;
+private:
+    wxTextCtrl* numRowsCtrl;
+    wxTextCtrl* numColsCtrl;
+    wxTextCtrl* rowStrideCtrl;
+    wxTextCtrl* colStrideCtrl;
+};
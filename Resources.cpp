@@ -1,24 +1,11 @@
 #include "Resources.h"
-#include "Item.h"
+#include "Components.h"
+#include "Profiler.h"
 #include <wx/graphics.h>
-
-static_assert(sizeof(int) == sizeof(size_t) / 2); //Required for hashing
+#include <wx/mstream.h>
+#include <atomic>
 
 namespace {
-    const wxPoint2DDouble resistorPoints[] {
-            {0, 0.5},
-            {0.140625, 0.5},
-            {0.1875, 0.59375},
-            {0.28125, 0.40625},
-            {0.375, 0.59375},
-            {0.453125, 0.40625},
-            {0.53125, 0.59375},
-            {0.625, 0.40625},
-            {0.703125, 0.59375},
-            {0.796875, 0.40625},
-            {0.84375, 0.5},
-            {1, 0.5}
-    };
     wxBitmap initBitmap(int size) {
         wxImage image{size, size};
         image.InitAlpha();
@@ -26,34 +13,14 @@ namespace {
         return {image};
     }
 
-    double rScale(double d, double scale) { //radial scale (scaling point from center)
-        return 0.5 + (d - 0.5) * scale;
-    }
-}
-
-namespace std { //used by std::unordered_map
-    template<>
-    struct hash<std::pair<int,bool>> {
-        size_t operator() (std::pair<int,bool> key) const {
-            return key.first | (static_cast<size_t>(key.second) << (sizeof(int) * 8 + 1));
-        }
-    };
-    template<>
-    struct hash<std::pair<int,int>> {
-        size_t operator() (std::pair<int,int> key) const {
-            return (static_cast<size_t>(key.first) << (sizeof(int) * 8)) | key.second;
-        }
-    };
-    template<>
-    struct hash<std::tuple<int,bool,bool>> {
-        size_t operator() (std::tuple<int,bool,bool> key) const {
-            return std::get<0>(key) | (static_cast<size_t>(std::get<1>(key)) << (sizeof(int) * 8 + 1)) | (static_cast<size_t>(std::get<2>(key)) << (sizeof(int) * 8 + 2));
-        }
-    };
+    std::atomic<size_t> cacheBytes{0};
 }
 
 wxBitmap resources::getBinBitmap(int size) { //doing it this way instead of image.Scale to get antialiasing
-    static wxImage binImage{"res/bin.png", wxBITMAP_TYPE_PNG};
+    static wxImage binImage = [] {
+        wxMemoryInputStream stream{bin_png.data, bin_png.size};
+        return wxImage{stream, wxBITMAP_TYPE_PNG};
+    }();
     wxBitmap binFullBitmap{binImage};
     wxBitmap bitmap{initBitmap(size)};
     wxMemoryDC dc{bitmap};
@@ -64,36 +31,9 @@ wxBitmap resources::getBinBitmap(int size) { //doing it this way instead of imag
     return bitmap;
 }
 
-wxBitmap resources::getResistorBitmap(int size, bool rotated) {
-    static std::unordered_map<std::pair<int,bool>, wxBitmap> cache{};
-    std::pair<int,bool> key{size, rotated};
-    auto iter = cache.find(key);
-    if(iter != cache.end()) {
-        return iter->second;
-    }
-    wxBitmap bitmap{initBitmap(size)};
-    wxMemoryDC dc{bitmap};
-    wxGraphicsContext* context = wxGraphicsContext::Create(dc);
-    wxPen pen = wxPen{wxPenInfo(*wxBLACK, std::ceil(size * 22.0 / 1024))};
-    context->SetPen(pen);
-    constexpr size_t numPoints = sizeof(resistorPoints) / sizeof(resistorPoints[0]);
-    wxPoint2DDouble points[numPoints];
-    for(int i = 0; i < numPoints; i ++) {
-        if(rotated) {
-            points[i] = {resistorPoints[i].m_y * size, resistorPoints[i].m_x * size};
-        } else {
-            points[i] = resistorPoints[i] * size;
-        }
-    }
-    context->StrokeLines(numPoints, points);
-    delete context;
-    dc.SelectObject(wxNullBitmap);
-    cache[key] = bitmap;
-    return bitmap;
-}
-
 wxIconBundle resources::getResistorIconBundle() {
-    return wxIconBundle("res/resistor-multires.ico", wxBITMAP_TYPE_ICO);
+    wxMemoryInputStream stream{resistor_multires_ico.data, resistor_multires_ico.size};
+    return wxIconBundle{stream, wxBITMAP_TYPE_ICO};
 }
 
 //Only called once, so no need to cache
@@ -109,191 +49,67 @@ wxBitmap resources::getWireBitmap(int size) {
     return bitmap;
 }
 
-wxBitmap resources::getVoltSourceBitmap(int size, int shape, bool toolbar) {
-    static std::unordered_map<std::pair<int,int>, wxBitmap> cache{};
-    std::pair<int, int> key{size, shape};
+wxBitmap resources::getPartBitmap(const components::Component& part, int size, int variant, bool toolbar) {
+    static std::unordered_map<uint64_t, wxBitmap> cache{};
+    uint64_t key = (static_cast<uint64_t>(size) << 16) | (static_cast<uint64_t>(part.type) << 8) | static_cast<uint64_t>(variant);
     if(!toolbar) {
         auto iter = cache.find(key);
-        if (iter != cache.end()) {
+        if(iter != cache.end()) {
+            profiler::count(profiler::Counter::bitmap_cache_hits);
             return iter->second;
         }
+        profiler::count(profiler::Counter::bitmap_cache_misses);
     }
-    double scale = toolbar ? 1 : 0.4 / 0.7;
+    double scale = toolbar ? part.iconScale : 1;
+    auto pixels = [&part, size, variant, scale](components::Point point) {
+        point = part.place(point, variant);
+        return wxPoint2DDouble{(0.5 + (point.x - 0.5) * scale) * size, (0.5 + (point.y - 0.5) * scale) * size};
+    };
     wxBitmap bitmap{initBitmap(size)};
     wxMemoryDC dc{bitmap};
     wxGraphicsContext* context = wxGraphicsContext::Create(dc);
     wxPen pen = wxPen{wxPenInfo(*wxBLACK, std::ceil(size * 22.0 / 1024))};
     context->SetPen(pen);
-    if(shape & Item::DEPENDENT) { //Draw border
-        const wxPoint2DDouble points[] = {
-                {0.5 * size, rScale(0.15, scale) * size},
-                {rScale(0.85, scale) * size, 0.5 * size},
-                {0.5 * size, rScale(0.85, scale) * size},
-                {rScale(0.15, scale) * size, 0.5 * size},
-                {0.5 * size, rScale(0.15, scale) * size}};
-        context->StrokeLines(5, points);
-    }
-    else {
-        context->DrawEllipse(rScale(0.15, scale) * size, rScale(0.15, scale) * size, 0.7 * scale * size, 0.7 * scale * size);
-    }
-    if((shape & Item::UP) || (shape & Item::DOWN)) { //Draw wire connections
-        context->StrokeLine(0.5 * size, 0, 0.5 * size, rScale(0.15, scale) * size);
-        context->StrokeLine(0.5 * size, rScale(0.85, scale) * size, 0.5 * size, size);
-    } else {
-        context->StrokeLine(0, 0.5 * size, rScale(0.15, scale) * size, 0.5 * size);
-        context->StrokeLine(rScale(0.85, scale) * size, 0.5 * size, size, 0.5 * size);
-    }
-    if(shape & Item::UP) { //Draw + and -
-        context->StrokeLine(0.5 * size, rScale(0.3, scale) * size, 0.5 * size, 0.5 * size);
-        context->StrokeLine(rScale(0.4, scale) * size, rScale(0.4, scale) * size, rScale(0.6, scale) * size, rScale(0.4, scale) * size);
-        context->StrokeLine(rScale(0.4, scale) * size, rScale(0.67, scale) * size, rScale(0.6, scale) * size, rScale(0.67, scale) * size);
-    } else if(shape & Item::RIGHT) {
-        context->StrokeLine(rScale(0.7, scale) * size, 0.5 * size, 0.5 * size, 0.5 * size);
-        context->StrokeLine(rScale(0.6, scale) * size, rScale(0.4, scale) * size, rScale(0.6, scale) * size, rScale(0.6, scale) * size);
-        context->StrokeLine(rScale(0.33, scale) * size, rScale(0.4, scale) * size, rScale(0.33, scale) * size, rScale(0.6, scale) * size);
-    } else if(shape & Item::DOWN) {
-        context->StrokeLine(0.5 * size, rScale(0.7, scale) * size, 0.5 * size, 0.5 * size);
-        context->StrokeLine(rScale(0.4, scale) * size, rScale(0.6, scale) * size, rScale(0.6, scale) * size, rScale(0.6, scale) * size);
-        context->StrokeLine(rScale(0.4, scale) * size, rScale(0.32, scale) * size, rScale(0.6, scale) * size, rScale(0.32, scale) * size);
-    } else {
-        context->StrokeLine(rScale(0.3, scale) * size, 0.5 * size, 0.5 * size, 0.5 * size);
-        context->StrokeLine(rScale(0.4, scale) * size, rScale(0.4, scale) * size, rScale(0.4, scale) * size, rScale(0.6, scale) * size);
-        context->StrokeLine(rScale(0.67, scale) * size, rScale(0.4, scale) * size, rScale(0.67, scale) * size, rScale(0.6, scale) * size);
+    std::vector<wxPoint2DDouble> points{};
+    for(const components::Stroke& stroke : part.strokes) {
+        if(!part.draws(stroke, variant)) continue;
+        if(stroke.circle) {
+            wxPoint2DDouble centre = pixels(stroke.points[0]);
+            double radius = stroke.radius * scale * size;
+            context->DrawEllipse(centre.m_x - radius, centre.m_y - radius, 2 * radius, 2 * radius);
+        } else {
+            points.clear();
+            for(components::Point point : stroke.points) {
+                points.push_back(pixels(point));
+            }
+            context->StrokeLines(points.size(), points.data());
+        }
     }
     delete context;
     dc.SelectObject(wxNullBitmap);
-    if(!toolbar) cache[key] = bitmap;
-    return bitmap;
-}
-
-wxBitmap resources::getAmpSourceBitmap(int size, int shape, bool toolbar) {
-    static std::unordered_map<std::pair<int,int>,wxBitmap> cache{};
-    std::pair<int,int> key{size, shape};
     if(!toolbar) {
-        auto iter = cache.find(key);
-        if (iter != cache.end()) {
-            return iter->second;
-        }
+        cacheBytes += bitmapBytes(bitmap);
+        cache[key] = bitmap;
     }
-    wxBitmap bitmap{initBitmap(size)};
-    wxMemoryDC dc{bitmap};
-    wxGraphicsContext* context = wxGraphicsContext::Create(dc);
-    wxPen pen = wxPen{wxPenInfo(*wxBLACK, std::ceil(size * 22.0 / 1024))};
-    context->SetPen(pen);
-    double scale = toolbar ? 1 : 0.4 / 0.7;
-    if(shape & Item::DEPENDENT) { //Draw border
-        const wxPoint2DDouble points[] = {
-                {0.5 * size, rScale(0.15, scale) * size},
-                {rScale(0.85, scale) * size, 0.5 * size},
-                {0.5 * size, rScale(0.85, scale) * size},
-                {rScale(0.15, scale) * size, 0.5 * size},
-                {0.5 * size, rScale(0.15, scale) * size}};
-        context->StrokeLines(5, points);
-    }
-    else {
-        context->DrawEllipse(rScale(0.15, scale) * size, rScale(0.15, scale) * size, 0.7 * scale * size, 0.7 * scale * size);
-    }
-    if((shape & Item::UP) || (shape & Item::DOWN)) { //Draw wire connections and main part of arrow
-        context->StrokeLine(0.5 * size, 0, 0.5 * size, rScale(0.15, scale) * size);
-        context->StrokeLine(0.5 * size, rScale(0.85, scale) * size, 0.5 * size, size);
-        context->StrokeLine(0.5 * size, rScale(0.7, scale) * size, 0.5 * size, rScale(0.3, scale) * size);
-    } else {
-        context->StrokeLine(0, 0.5 * size, rScale(0.15, scale) * size, 0.5 * size);
-        context->StrokeLine(rScale(0.85, scale) * size, 0.5 * size, size, 0.5 * size);
-        context->StrokeLine(rScale(0.3, scale) * size, 0.5 * size, rScale(0.7, scale) * size, 0.5 * size);
-    }
-    if(shape & Item::UP) { //Draw current arrow
-        const wxPoint2DDouble points[] = {{rScale(0.47, scale) * size, rScale(0.4, scale) * size},
-                                          {0.5 * size, rScale(0.3, scale) * size},
-                                          {rScale(0.53, scale) * size, rScale(0.4, scale) * size}};
-        context->StrokeLines(3, points);
-    } else if(shape & Item::RIGHT) {
-        const wxPoint2DDouble points[] = {{rScale(0.6, scale) * size, rScale(0.47, scale) * size},
-                                          {rScale(0.7, scale) * size, 0.5 * size},
-                                          {rScale(0.6, scale) * size, rScale(0.53, scale) * size}};
-        context->StrokeLines(3, points);
-    } else if(shape & Item::DOWN) {
-        const wxPoint2DDouble points[] = {{rScale(0.47, scale) * size, rScale(0.6, scale) * size},
-                                          {0.5 * size, rScale(0.7, scale) * size},
-                                          {rScale(0.53, scale) * size, rScale(0.6, scale) * size}};
-        context->StrokeLines(3, points);
-    } else {
-        const wxPoint2DDouble points[] = {{rScale(0.4, scale) * size, rScale(0.47, scale) * size},
-                                          {rScale(0.3, scale) * size, 0.5 * size},
-                                          {rScale(0.4, scale) * size, rScale(0.53, scale) * size}};
-        context->StrokeLines(3, points);
-    }
-    delete context;
-    dc.SelectObject(wxNullBitmap);
-    if(!toolbar) cache[key] = bitmap;
     return bitmap;
 }
 
-wxBitmap resources::getCapacitorBitmap(int size, bool rotated) {
-    static std::unordered_map<std::pair<int,bool>, wxBitmap> cache{};
-    std::pair<int,bool> key{size, rotated};
-    auto iter = cache.find(key);
-    if(iter != cache.end()) {
-        return iter->second;
-    }
-    wxBitmap bitmap{initBitmap(size)};
-    wxMemoryDC dc{bitmap};
-    wxGraphicsContext* context = wxGraphicsContext::Create(dc);
-    wxPen pen = wxPen{wxPenInfo(*wxBLACK, std::ceil(size * 22.0 / 1024))};
-    context->SetPen(pen);
-    if(rotated) {
-        context->StrokeLine(0.5 * size, 0, 0.5 * size, 0.42 * size);
-        context->StrokeLine(0.5 * size, 0.58 * size, 0.5 * size, size);
-        context->StrokeLine(0.3 * size, 0.42 * size, 0.7 * size, 0.42 * size);
-        context->StrokeLine(0.3 * size, 0.58 * size, 0.7 * size, 0.58 * size);
-    } else {
-        context->StrokeLine(0, 0.5 * size, 0.42 * size, 0.5 * size);
-        context->StrokeLine(0.58 * size, 0.5 * size, size, 0.5 * size);
-        context->StrokeLine(0.42 * size, 0.3 * size, 0.42 * size, 0.7 * size);
-        context->StrokeLine(0.58 * size, 0.3 * size, 0.58 * size, 0.7 * size);
-    }
-    delete context;
-    dc.SelectObject(wxNullBitmap);
-    cache[key] = bitmap;
-    return bitmap;
+size_t resources::bitmapBytes(const wxBitmap& bitmap) {
+    return bitmap.IsOk() ? static_cast<size_t>(bitmap.GetWidth()) * bitmap.GetHeight() * ((bitmap.GetDepth() + 7) / 8) : 0;
 }
 
-wxBitmap resources::getSwitchBitmap(int size, bool rotated, bool closed) {
-    static std::unordered_map<std::tuple<int,bool,bool>, wxBitmap> cache{};
-    std::tuple<int,bool,bool> key {size, rotated, closed};
-    auto iter = cache.find(key);
-    if(iter != cache.end()) {
-        return iter->second;
-    }
-    wxBitmap bitmap{initBitmap(size)};
-    wxMemoryDC dc{bitmap};
-    wxGraphicsContext* context = wxGraphicsContext::Create(dc);
-    int border = std::ceil(size * 22.0 / 1024);
-    wxPen pen = wxPen{wxPenInfo(*wxBLACK, border)};
-    context->SetPen(pen);
-    if(rotated) {
-        context->DrawEllipse(0.45 * size, border, 0.1 * size, 0.1 * size);
-        context->DrawEllipse(0.45 * size, 0.9 * size - border, 0.1 * size, 0.1 * size);
-        context->StrokeLine(0.5 * size, border, 0.5 * size, -1);
-        context->StrokeLine(0.5 * size, size - border, 0.5 * size, size + 1);
-        if(closed) {
-            context->StrokeLine(0.5 * size, 0.1 * size + border, 0.5 * size, 0.9 * size - border);
-        } else {
-            context->StrokeLine(0.5 * size, 0.1 * size + border, 0.2 * size, 0.8 * size - border);
-        }
-    } else {
-        context->DrawEllipse(border, 0.45 * size, 0.1 * size, 0.1 * size);
-        context->DrawEllipse(0.9 * size - border, 0.45 * size, 0.1 * size, 0.1 * size);
-        context->StrokeLine(border, 0.5 * size, -1, 0.5 * size);
-        context->StrokeLine(size - border, 0.5 * size, size + 1, 0.5 * size);
-        if(closed) {
-            context->StrokeLine(0.1 * size + border, 0.5 * size, 0.9 * size - border, 0.5 * size);
-        } else {
-            context->StrokeLine(0.1 * size + border, 0.5 * size, 0.8 * size - border, 0.2 * size);
-        }
-    }
-    delete context;
-    dc.SelectObject(wxNullBitmap);
-    cache[key] = bitmap;
+size_t resources::cachedBytes() {
+    return cacheBytes;
+}
+
+resources::Glyphs::Glyphs(int size) : size{size}, bitmaps(components::limit() * components::MAX_VARIANTS) {}
+
+int resources::Glyphs::getSize() const {
+    return size;
+}
+
+const wxBitmap& resources::Glyphs::get(const components::Component& part, int variant) {
+    wxBitmap& bitmap = bitmaps[static_cast<size_t>(part.type) * components::MAX_VARIANTS + variant];
+    if(!bitmap.IsOk()) bitmap = getPartBitmap(part, size, variant, false);
     return bitmap;
 }
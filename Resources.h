@@ -1,14 +1,43 @@
 #pragma once
 #include <wx/wx.h>
 #include <filesystem>
+#include <vector>
+
+namespace components {
+    struct Component;
+}
 
 namespace resources {
+    //A file of res compiled into the program by Embed.cmake, so nothing is read from beside it at startup
+    struct Embedded {
+        const unsigned char* data;
+        size_t size;
+    };
+    extern const Embedded bin_png;
+    extern const Embedded resistor_multires_ico;
+    extern const Embedded components_txt;
+
+    //The glyphs Item::draw blits at one cell size. Each is drawn the first time it is asked for, so opening a window
+    //or zooming only draws those of the items in view. Like all wx drawing, only for the main thread.
+    class Glyphs {
+    public:
+        Glyphs() = default;
+        explicit Glyphs(int size);
+        int getSize() const;
+        //variant as part.variant gives it
+        const wxBitmap& get(const components::Component& part, int variant);
+    private:
+        int size{0};
+        std::vector<wxBitmap> bitmaps; //components::MAX_VARIANTS for each type below components::limit()
+    };
+
     wxBitmap getBinBitmap(int size);
     wxBitmap getWireBitmap(int size);
-    wxBitmap getResistorBitmap(int size, bool rotated);
     wxIconBundle getResistorIconBundle();
-    wxBitmap getVoltSourceBitmap(int size, int shape, bool toolbar);
-    wxBitmap getAmpSourceBitmap(int size, int shape, bool toolbar);
-    wxBitmap getCapacitorBitmap(int size, bool rotated);
-    wxBitmap getSwitchBitmap(int size, bool rotated, bool closed);
+    //The part's strokes drawn at size for variant. Toolbar glyphs are scaled by its iconScale and not cached.
+    wxBitmap getPartBitmap(const components::Component& part, int size, int variant, bool toolbar);
+    //Pixel data of a bitmap
+    size_t bitmapBytes(const wxBitmap& bitmap);
+    //Bytes held by getPartBitmap's cache
+    size_t cachedBytes();
 }
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include "Simulation.h"
+#include <algorithm>
+
+namespace {
+    void checkCancelled(const std::atomic<bool>* cancel) {
+        if(cancel && cancel->load(std::memory_order_relaxed)) {
+            throw Simulation::Cancelled{};
+        }
+    }
+}
+
+Simulation::Simulation(const Grid& grid, Backend backend, const std::atomic<bool>* cancel, double tolerance) : netlist{grid} {
+    checkCancelled(cancel);
+    if(backend == Backend::iterative) {
+        IterativeSolver::Options options{};
+        options.cancel = cancel;
+        options.tolerance = tolerance;
+        iterative = std::make_unique<IterativeSolver>(netlist, options);
+        checkCancelled(cancel);
+        solution = iterative->solve(edits, statistics);
+    } else {
+        solver = std::make_unique<Solver>(netlist);
+        checkCancelled(cancel);
+        incremental = std::make_unique<Solver::Incremental>(*solver);
+    }
+    checkCancelled(cancel);
+}
+
+bool Simulation::update(uint32_t row, uint32_t col, const Item& item) {
+    size_t element = netlist.find(row, col);
+    if(element == Netlist::npos || !netlist.connectsLike(element, item)) {
+        return false;
+    }
+    double value = Netlist::elementValue(item);
+    if(iterative) { //restart conjugate gradient from the previous solution, which is already close
+        auto iter = std::find_if(edits.begin(), edits.end(), [element](const Solver::Assignment& edit) {return edit.element == element;});
+        if(iter == edits.end()) {
+            edits.push_back(Solver::Assignment{element, value});
+        } else {
+            iter->value = value;
+        }
+        solution = iterative->solve(edits, statistics, &solution);
+    } else {
+        incremental->set(element, value);
+    }
+    return true;
+}
+
+const Netlist& Simulation::getNetlist() const {
+    return netlist;
+}
+
+const Solver::Solution& Simulation::getSolution() const {
+    return iterative ? solution : incremental->getSolution();
+}
+
+size_t Simulation::getUpdateCount() const {
+    return iterative ? 0 : incremental->getUpdateCount();
+}
+
+const IterativeSolver::Statistics* Simulation::getStatistics() const {
+    return iterative ? &statistics : nullptr;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <memory>
+#include <atomic>
+#include <stdexcept>
+#include "Netlist.h"
+#include "Solver.h"
+#include "IterativeSolver.h"
+
+//The netlist, solver and current solution for a Grid, kept together so single-cell edits can be followed incrementally
+class Simulation {
+public:
+    enum class Backend {
+        direct, iterative
+    };
+    //Thrown by the constructor when cancel gets set while it runs
+    class Cancelled : public std::runtime_error {
+    public:
+        Cancelled() : std::runtime_error{"Simulation cancelled"} {}
+    };
+    //cancel, if given, is polled between the stages of building the solution and inside the iterative solve.
+    //tolerance is the iterative backend's, see IterativeSolver::Options.
+    explicit Simulation(const Grid& grid, Backend backend = Backend::direct, const std::atomic<bool>* cancel = nullptr,
+                        double tolerance = IterativeSolver::Options{}.tolerance);
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+    //Follows an edit of one cell. Returns false if the edit changes how the circuit is connected,
+    //in which case the solution no longer applies and a new Simulation is needed.
+    bool update(uint32_t row, uint32_t col, const Item& item);
+    const Netlist& getNetlist() const;
+    const Solver::Solution& getSolution() const;
+    size_t getUpdateCount() const;
+    //Convergence of the last solve, null for the direct backend
+    const IterativeSolver::Statistics* getStatistics() const;
+private:
+    Netlist netlist;
+    std::unique_ptr<Solver> solver;
+    std::unique_ptr<Solver::Incremental> incremental;
+    std::unique_ptr<IterativeSolver> iterative;
+    std::vector<Solver::Assignment> edits; //values changed since the iterative solver was built
+    Solver::Solution solution;
+    IterativeSolver::Statistics statistics;
+};
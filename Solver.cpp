@@ -0,0 +1,479 @@
+#include "Solver.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+namespace {
+    bool stamps(Item::ItemType type) {
+        return type == Item::ItemType::resistor || type == Item::ItemType::toggle || type == Item::ItemType::volt_source;
+    }
+
+    //Reverse Cuthill-McKee ordering of the non-ground nodes, keeps fill-in down for the mesh-like circuits drawn on a grid
+    std::vector<uint32_t> orderNodes(uint32_t nodes, const std::vector<Netlist::Element>& elements) {
+        std::vector<int> start(nodes + 1, 0);
+        for(const Netlist::Element& element : elements) {
+            if(!stamps(element.type) || element.nodeA == element.nodeB) continue;
+            start[element.nodeA + 1] ++;
+            start[element.nodeB + 1] ++;
+        }
+        for(uint32_t i = 0; i < nodes; i ++) {
+            start[i + 1] += start[i];
+        }
+        std::vector<uint32_t> adjacent(start[nodes]);
+        std::vector<int> next{start.begin(), start.end() - 1};
+        for(const Netlist::Element& element : elements) {
+            if(!stamps(element.type) || element.nodeA == element.nodeB) continue;
+            adjacent[next[element.nodeA]++] = element.nodeB;
+            adjacent[next[element.nodeB]++] = element.nodeA;
+        }
+        auto degree = [&](uint32_t node) {return start[node + 1] - start[node];};
+        std::vector<uint32_t> candidates{};
+        for(uint32_t i = 1; i < nodes; i ++) {
+            candidates.push_back(i);
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {return degree(a) < degree(b);});
+        std::vector<bool> visited(nodes, false);
+        visited[Netlist::GROUND] = true; //ground is not an unknown, and going through it would join unrelated parts
+        std::vector<uint32_t> order{};
+        order.reserve(nodes);
+        for(uint32_t candidate : candidates) {
+            if(visited[candidate]) continue;
+            visited[candidate] = true;
+            order.push_back(candidate);
+            for(size_t head = order.size() - 1; head < order.size(); head ++) {
+                size_t first = order.size();
+                uint32_t node = order[head];
+                for(int p = start[node]; p < start[node + 1]; p ++) {
+                    if(!visited[adjacent[p]]) {
+                        visited[adjacent[p]] = true;
+                        order.push_back(adjacent[p]);
+                    }
+                }
+                std::stable_sort(order.begin() + static_cast<std::ptrdiff_t>(first), order.end(), [&](uint32_t a, uint32_t b) {return degree(a) < degree(b);});
+            }
+        }
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+}
+
+Solver::Solver(const Netlist& netlist) : elements{netlist.elements}, nodes{netlist.nodeCount()} {
+    for(const Netlist::Element& element : elements) {
+        if(element.dependent && (element.type == Item::ItemType::volt_source || element.type == Item::ItemType::amp_source)) {
+            throw std::runtime_error{"Dependent sources cannot be simulated"};
+        }
+        if(element.type == Item::ItemType::volt_source && element.nodeA == element.nodeB) {
+            throw std::runtime_error{"Voltage source is shorted"};
+        }
+    }
+
+    //Number the unknowns. Each voltage source's current goes right after the later of its two nodes, which keeps every
+    //leading block of the matrix a complete circuit of its own, so LDL^T never meets a zero pivot without pivoting
+    //unless there is a loop of voltage sources.
+    std::vector<uint32_t> order = orderNodes(nodes, elements);
+    std::vector<int> rank(nodes, -1);
+    for(size_t i = 0; i < order.size(); i ++) {
+        rank[order[i]] = static_cast<int>(i);
+    }
+    std::vector<std::vector<size_t>> branchesAfter(nodes);
+    for(size_t i = 0; i < elements.size(); i ++) {
+        if(elements[i].type == Item::ItemType::volt_source) {
+            uint32_t later = rank[elements[i].nodeA] > rank[elements[i].nodeB] ? elements[i].nodeA : elements[i].nodeB;
+            branchesAfter[later].push_back(i);
+        }
+    }
+    variable.assign(nodes, -1);
+    branch.assign(elements.size(), -1);
+    int next = 0;
+    for(uint32_t node : order) {
+        variable[node] = next++;
+        for(size_t i : branchesAfter[node]) {
+            branch[i] = next++;
+        }
+    }
+    n = next;
+
+    //Pattern of the matrix, stored as (column, row)
+    std::vector<std::pair<int, int>> entries{};
+    for(uint32_t node = 1; node < nodes; node ++) {
+        entries.emplace_back(variable[node], variable[node]);
+    }
+    for(size_t i = 0; i < elements.size(); i ++) {
+        if(!stamps(elements[i].type)) continue;
+        int a = variable[elements[i].nodeA];
+        int b = variable[elements[i].nodeB];
+        int k = branch[i];
+        if(k == -1) {
+            if(a != -1 && b != -1) {
+                entries.emplace_back(a, b);
+                entries.emplace_back(b, a);
+            }
+        } else {
+            if(a != -1) {
+                entries.emplace_back(a, k);
+                entries.emplace_back(k, a);
+            }
+            if(b != -1) {
+                entries.emplace_back(b, k);
+                entries.emplace_back(k, b);
+            }
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+    Ap.assign(n + 1, 0);
+    Ai.resize(entries.size());
+    for(size_t p = 0; p < entries.size(); p ++) {
+        Ap[entries[p].first + 1] ++;
+        Ai[p] = entries[p].second;
+    }
+    for(int j = 0; j < n; j ++) {
+        Ap[j + 1] += Ap[j];
+    }
+    auto position = [this](int row, int col) {
+        if(row == -1 || col == -1) return -1;
+        auto iter = std::lower_bound(Ai.begin() + Ap[col], Ai.begin() + Ap[col + 1], row);
+        return static_cast<int>(iter - Ai.begin());
+    };
+    diagonal.resize(nodes > 0 ? nodes - 1 : 0);
+    for(uint32_t node = 1; node < nodes; node ++) {
+        diagonal[node - 1] = position(variable[node], variable[node]);
+    }
+    slots.resize(elements.size(), {-1, -1, -1, -1});
+    for(size_t i = 0; i < elements.size(); i ++) {
+        if(!stamps(elements[i].type)) continue;
+        int a = variable[elements[i].nodeA];
+        int b = variable[elements[i].nodeB];
+        int k = branch[i];
+        if(k == -1) {
+            slots[i] = {position(a, a), position(b, b), position(a, b), position(b, a)};
+        } else {
+            slots[i] = {position(a, k), position(k, a), position(b, k), position(k, b)};
+        }
+    }
+
+    //Elimination tree and pattern of L
+    parent.assign(n, -1);
+    std::vector<int> flag(n);
+    std::vector<int> lnz(n, 0);
+    for(int k = 0; k < n; k ++) {
+        flag[k] = k;
+        for(int p = Ap[k]; p < Ap[k + 1]; p ++) {
+            for(int i = Ai[p]; i < k && flag[i] != k; i = parent[i]) {
+                if(parent[i] == -1) parent[i] = k;
+                lnz[i] ++;
+                flag[i] = k;
+            }
+        }
+    }
+    Lp.assign(n + 1, 0);
+    for(int k = 0; k < n; k ++) {
+        Lp[k + 1] = Lp[k] + lnz[k];
+    }
+    Li.resize(Lp[n]);
+    std::fill(lnz.begin(), lnz.end(), 0);
+    for(int k = 0; k < n; k ++) {
+        flag[k] = k;
+        for(int p = Ap[k]; p < Ap[k + 1]; p ++) {
+            for(int i = Ai[p]; i < k && flag[i] != k; i = parent[i]) {
+                Li[Lp[i] + lnz[i]++] = k;
+                flag[i] = k;
+            }
+        }
+    }
+}
+
+uint32_t Solver::nodeCount() const {
+    return nodes;
+}
+
+size_t Solver::elementCount() const {
+    return elements.size();
+}
+
+double Solver::conductance(const Netlist::Element& element, double value) {
+    if(element.type == Item::ItemType::toggle) {
+        return value != 0 ? 1 / MIN_RESISTANCE : 0;
+    }
+    return 1 / std::max(value, MIN_RESISTANCE);
+}
+
+std::vector<double> Solver::values(const std::vector<Assignment>& assignments) const {
+    std::vector<double> result(elements.size());
+    for(size_t i = 0; i < elements.size(); i ++) {
+        result[i] = elements[i].value;
+    }
+    for(const Assignment& assignment : assignments) {
+        if(assignment.element >= elements.size()) {
+            throw std::out_of_range{"Assignment to element " + std::to_string(assignment.element) + " outside netlist"};
+        }
+        result[assignment.element] = assignment.value;
+    }
+    return result;
+}
+
+void Solver::assemble(const std::vector<double>& elementValues, std::vector<double>& Ax) const {
+    Ax.assign(Ai.size(), 0);
+    for(int p : diagonal) {
+        Ax[p] += GMIN;
+    }
+    for(size_t i = 0; i < elements.size(); i ++) {
+        const std::array<int, 4>& slot = slots[i];
+        double g;
+        switch(elements[i].type) {
+            case Item::ItemType::resistor: case Item::ItemType::toggle:
+                g = conductance(elements[i], elementValues[i]);
+                break;
+            case Item::ItemType::volt_source:
+                g = 1;
+                break;
+            default: //capacitors are open at DC, current sources only appear on the right hand side
+                continue;
+        }
+        if(slot[0] != -1) Ax[slot[0]] += g;
+        if(slot[1] != -1) Ax[slot[1]] += g;
+        if(slot[2] != -1) Ax[slot[2]] -= g;
+        if(slot[3] != -1) Ax[slot[3]] -= g;
+    }
+}
+
+void Solver::rightHandSide(const std::vector<double>& elementValues, std::vector<double>& b) const {
+    b.assign(n, 0);
+    for(size_t i = 0; i < elements.size(); i ++) {
+        const Netlist::Element& element = elements[i];
+        if(element.type == Item::ItemType::volt_source) {
+            b[branch[i]] = elementValues[i];
+        } else if(element.type == Item::ItemType::amp_source) {
+            if(variable[element.nodeA] != -1) b[variable[element.nodeA]] += elementValues[i];
+            if(variable[element.nodeB] != -1) b[variable[element.nodeB]] -= elementValues[i];
+        }
+    }
+}
+
+Solver::Factorization Solver::factorize(const std::vector<double>& Ax) const {
+    Factorization result{std::vector<double>(Li.size()), std::vector<double>(n)};
+    std::vector<double> y(n, 0);
+    std::vector<int> pattern(n);
+    std::vector<int> flag(n);
+    std::vector<int> lnz(n, 0);
+    for(int k = 0; k < n; k ++) {
+        int top = n;
+        flag[k] = k;
+        for(int p = Ap[k]; p < Ap[k + 1]; p ++) {
+            int i = Ai[p];
+            if(i > k) continue;
+            y[i] += Ax[p];
+            int len = 0;
+            for(; flag[i] != k; i = parent[i]) {
+                pattern[len++] = i;
+                flag[i] = k;
+            }
+            while(len > 0) {
+                pattern[--top] = pattern[--len];
+            }
+        }
+        double d = y[k];
+        double scale = std::abs(d);
+        y[k] = 0;
+        for(; top < n; top ++) {
+            int i = pattern[top];
+            double yi = y[i];
+            y[i] = 0;
+            int end = Lp[i] + lnz[i];
+            for(int p = Lp[i]; p < end; p ++) {
+                y[Li[p]] -= result.Lx[p] * yi;
+            }
+            double lki = yi / result.D[i];
+            d -= lki * yi;
+            scale += std::abs(lki * yi);
+            result.Lx[end] = lki;
+            lnz[i] ++;
+        }
+        if(!(std::abs(d) > 1e-13 * scale)) {
+            throw std::runtime_error{"Circuit has no unique solution, check for loops of voltage sources"};
+        }
+        result.D[k] = d;
+    }
+    return result;
+}
+
+void Solver::solveFactored(const Factorization& factorization, std::vector<double>& x) const {
+    for(int j = 0; j < n; j ++) {
+        for(int p = Lp[j]; p < Lp[j + 1]; p ++) {
+            x[Li[p]] -= factorization.Lx[p] * x[j];
+        }
+    }
+    for(int j = 0; j < n; j ++) {
+        x[j] /= factorization.D[j];
+    }
+    for(int j = n - 1; j >= 0; j --) {
+        for(int p = Lp[j]; p < Lp[j + 1]; p ++) {
+            x[j] -= factorization.Lx[p] * x[Li[p]];
+        }
+    }
+}
+
+Solver::Solution Solver::solve(const std::vector<Assignment>& assignments) const {
+    Solution solution{std::vector<double>(nodes), std::vector<double>(elements.size())};
+    solve(assignments, solution.voltages.data(), solution.currents.data());
+    return solution;
+}
+
+void Solver::solve(const std::vector<Assignment>& assignments, double* voltages, double* currents) const {
+    std::vector<double> elementValues = values(assignments);
+    std::vector<double> Ax, b;
+    assemble(elementValues, Ax);
+    rightHandSide(elementValues, b);
+    Factorization factorization = factorize(Ax);
+    std::vector<double> x = solveRefined(Ax, factorization, b);
+    results(elementValues, x, voltages, currents);
+}
+
+std::vector<double> Solver::solveRefined(const std::vector<double>& Ax, const Factorization& factorization, const std::vector<double>& b) const {
+    std::vector<double> x{b};
+    solveFactored(factorization, x);
+    //One step of iterative refinement recovers the accuracy lost to badly scaled pivots, such as nodes held only by GMIN
+    std::vector<double> residual{b};
+    for(int j = 0; j < n; j ++) {
+        for(int p = Ap[j]; p < Ap[j + 1]; p ++) {
+            residual[Ai[p]] -= Ax[p] * x[j];
+        }
+    }
+    solveFactored(factorization, residual);
+    for(int j = 0; j < n; j ++) {
+        x[j] += residual[j];
+    }
+    return x;
+}
+
+void Solver::results(const std::vector<double>& elementValues, const std::vector<double>& x, double* voltages, double* currents) const {
+    for(uint32_t node = 0; node < nodes; node ++) {
+        voltages[node] = variable[node] == -1 ? 0 : x[variable[node]];
+    }
+    for(size_t i = 0; i < elements.size(); i ++) {
+        const Netlist::Element& element = elements[i];
+        switch(element.type) {
+            case Item::ItemType::resistor: case Item::ItemType::toggle:
+                currents[i] = conductance(element, elementValues[i]) * (voltages[element.nodeA] - voltages[element.nodeB]);
+                break;
+            case Item::ItemType::volt_source:
+                currents[i] = x[branch[i]];
+                break;
+            case Item::ItemType::amp_source:
+                currents[i] = -elementValues[i];
+                break;
+            default:
+                currents[i] = 0;
+        }
+    }
+}
+
+Solver::Incremental::Incremental(const Solver& solver) : solver{solver}, values{solver.values({})},
+        solution{std::vector<double>(solver.nodes), std::vector<double>(solver.elements.size())} {
+    refactorize();
+}
+
+const Solver::Solution& Solver::Incremental::getSolution() const {
+    return solution;
+}
+
+size_t Solver::Incremental::getUpdateCount() const {
+    return updates.size();
+}
+
+void Solver::Incremental::set(size_t element, double value) {
+    if(element >= values.size()) {
+        throw std::out_of_range{"Element " + std::to_string(element) + " outside netlist"};
+    }
+    values[element] = value;
+    const Netlist::Element& changed = solver.elements[element];
+    if(changed.type == Item::ItemType::resistor || changed.type == Item::ItemType::toggle) {
+        double delta = conductance(changed, value) - conductance(changed, factoredValues[element]);
+        auto iter = std::find_if(updates.begin(), updates.end(), [element](const Update& update) {return update.element == element;});
+        if(iter != updates.end()) { //the same element again only changes the size of its existing term
+            if(delta == 0) {
+                updates.erase(iter);
+            } else {
+                iter->delta = delta;
+            }
+        } else if(delta != 0 && changed.nodeA != changed.nodeB) {
+            if(updates.size() == MAX_UPDATES) {
+                refactorize();
+                return;
+            }
+            Update update{element, solver.variable[changed.nodeA], solver.variable[changed.nodeB], delta, std::vector<double>(solver.n, 0)};
+            if(update.a != -1) update.w[update.a] = 1;
+            if(update.b != -1) update.w[update.b] = -1;
+            solver.solveFactored(factorization, update.w);
+            updates.push_back(std::move(update));
+        }
+    }
+    if(!recompute()) {
+        refactorize();
+    }
+}
+
+void Solver::Incremental::refactorize() {
+    std::vector<double> Ax, b;
+    solver.assemble(values, Ax);
+    factorization = solver.factorize(Ax);
+    factoredValues = values;
+    updates.clear();
+    solver.rightHandSide(values, b);
+    solver.results(values, solver.solveRefined(Ax, factorization, b), solution.voltages.data(), solution.currents.data());
+}
+
+//x = x0 - W (I + C U^T W)^-1 C U^T x0, where x0 = A^-1 b, the columns of U are the updated terminal pairs,
+//W = A^-1 U and C holds the conductance changes. Returns false if the small system is too badly conditioned to trust.
+bool Solver::Incremental::recompute() {
+    std::vector<double> x;
+    solver.rightHandSide(values, x);
+    solver.solveFactored(factorization, x);
+    size_t k = updates.size();
+    if(k > 0) {
+        auto across = [](const std::vector<double>& v, const Update& update) {
+            return (update.a == -1 ? 0 : v[update.a]) - (update.b == -1 ? 0 : v[update.b]);
+        };
+        std::vector<double> m(k * k);
+        std::vector<double> z(k);
+        double largest = 0;
+        for(size_t i = 0; i < k; i ++) {
+            z[i] = updates[i].delta * across(x, updates[i]);
+            for(size_t j = 0; j < k; j ++) {
+                m[i * k + j] = (i == j ? 1 : 0) + updates[i].delta * across(updates[j].w, updates[i]);
+                largest = std::max(largest, std::abs(m[i * k + j]));
+            }
+        }
+        for(size_t c = 0; c < k; c ++) { //Gaussian elimination with partial pivoting
+            size_t pivot = c;
+            for(size_t r = c + 1; r < k; r ++) {
+                if(std::abs(m[r * k + c]) > std::abs(m[pivot * k + c])) pivot = r;
+            }
+            if(!(std::abs(m[pivot * k + c]) > 1e-12 * largest)) return false;
+            if(pivot != c) {
+                std::swap_ranges(m.begin() + static_cast<std::ptrdiff_t>(c * k), m.begin() + static_cast<std::ptrdiff_t>((c + 1) * k), m.begin() + static_cast<std::ptrdiff_t>(pivot * k));
+                std::swap(z[c], z[pivot]);
+            }
+            for(size_t r = c + 1; r < k; r ++) {
+                double factor = m[r * k + c] / m[c * k + c];
+                for(size_t j = c; j < k; j ++) {
+                    m[r * k + j] -= factor * m[c * k + j];
+                }
+                z[r] -= factor * z[c];
+            }
+        }
+        for(size_t c = k; c-- > 0;) {
+            for(size_t j = c + 1; j < k; j ++) {
+                z[c] -= m[c * k + j] * z[j];
+            }
+            z[c] /= m[c * k + c];
+        }
+        for(size_t j = 0; j < k; j ++) {
+            for(int i = 0; i < solver.n; i ++) {
+                x[i] -= z[j] * updates[j].w[i];
+            }
+        }
+    }
+    solver.results(values, x, solution.voltages.data(), solution.currents.data());
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include <array>
+#include "Netlist.h"
+
+//DC operating point solver using modified nodal analysis.
+//The constructor does the symbolic analysis (ordering, elimination tree and the pattern of L) once, so the same
+//Solver can be reused from several threads to solve the circuit with different component values.
+class Solver {
+public:
+    //Overrides the value of netlist.elements[element] for one solve
+    struct Assignment {
+        size_t element;
+        double value;
+    };
+    struct Solution {
+        std::vector<double> voltages; //indexed by node, ground is 0
+        std::vector<double> currents; //indexed by element, flowing from nodeA to nodeB through the element
+    };
+    constexpr static double MIN_RESISTANCE = 1e-6; //used for shorts and closed switches
+    constexpr static double GMIN = 1e-12; //conductance from every node to ground, keeps floating nodes solvable
+    explicit Solver(const Netlist& netlist);
+    Solution solve(const std::vector<Assignment>& assignments = {}) const;
+    //Writes nodeCount() voltages and elementCount() currents, for callers that preallocate their results
+    void solve(const std::vector<Assignment>& assignments, double* voltages, double* currents) const;
+    uint32_t nodeCount() const;
+    size_t elementCount() const;
+    //Conductance of a resistor or switch with the given value
+    static double conductance(const Netlist::Element& element, double value);
+private:
+    struct Factorization {
+        std::vector<double> Lx;
+        std::vector<double> D;
+    };
+    std::vector<double> values(const std::vector<Assignment>& assignments) const;
+    void assemble(const std::vector<double>& elementValues, std::vector<double>& Ax) const;
+    void rightHandSide(const std::vector<double>& elementValues, std::vector<double>& b) const;
+    Factorization factorize(const std::vector<double>& Ax) const;
+    void solveFactored(const Factorization& factorization, std::vector<double>& x) const;
+    std::vector<double> solveRefined(const std::vector<double>& Ax, const Factorization& factorization, const std::vector<double>& b) const;
+    void results(const std::vector<double>& elementValues, const std::vector<double>& x, double* voltages, double* currents) const;
+
+    std::vector<Netlist::Element> elements;
+    uint32_t nodes;
+    int n; //number of unknowns
+    std::vector<int> variable; //unknown index of each node, -1 for ground
+    std::vector<int> branch; //unknown index of each voltage source's current, -1 for other elements
+    //Symmetric system matrix in compressed column form, with both triangles stored
+    std::vector<int> Ap;
+    std::vector<int> Ai;
+    //Positions in Ax each element adds to: (a,a), (b,b), (a,b), (b,a) for conductances,
+    //(a,k), (k,a), (b,k), (k,b) for voltage sources with branch k. -1 where a terminal is ground
+    std::vector<std::array<int, 4>> slots;
+    std::vector<int> diagonal; //position of each node unknown's diagonal, where GMIN goes
+    //Symbolic factorization
+    std::vector<int> parent; //elimination tree
+    std::vector<int> Lp;
+    std::vector<int> Li;
+public:
+    //Keeps the factorization of one set of values and follows edits to single elements with a low-rank
+    //(Sherman-Morrison-Woodbury) correction instead of factorizing again. Value changes of sources only touch the right
+    //hand side; each changed resistor or switch adds one rank-one term until MAX_UPDATES forces a full factorization.
+    class Incremental {
+    public:
+        constexpr static size_t MAX_UPDATES = 16;
+        explicit Incremental(const Solver& solver);
+        void set(size_t element, double value);
+        const Solution& getSolution() const;
+        size_t getUpdateCount() const;
+    private:
+        struct Update {
+            size_t element;
+            int a; //unknowns the conductance sits between, -1 for ground
+            int b;
+            double delta; //conductance change since the factorization
+            std::vector<double> w; //A^-1 (e_a - e_b)
+        };
+        void refactorize();
+        bool recompute();
+        const Solver& solver;
+        std::vector<double> values;
+        std::vector<double> factoredValues;
+        Factorization factorization;
+        std::vector<Update> updates;
+        Solution solution;
+    };
+};
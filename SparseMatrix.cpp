@@ -0,0 +1,116 @@
+#include "SparseMatrix.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SCHEMATIC_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SCHEMATIC_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace {
+    constexpr int PARALLEL_ENTRIES = 1 << 16; //below this a product is faster than waking the pool
+
+    void multiplyScalar(const int* rowStart, const int* columns, const double* values, const double* x, double* y, int begin, int end) {
+        for(int row = begin; row < end; row ++) {
+            double sum = 0;
+            for(int p = rowStart[row]; p < rowStart[row + 1]; p ++) {
+                sum += values[p] * x[columns[p]];
+            }
+            y[row] = sum;
+        }
+    }
+
+#ifdef SCHEMATIC_X86
+    TARGET_AVX2 void multiplyAvx2(const int* rowStart, const int* columns, const double* values, const double* x, double* y, int begin, int end) {
+        for(int row = begin; row < end; row ++) {
+            int p = rowStart[row];
+            int rowEnd = rowStart[row + 1];
+            __m256d sum = _mm256_setzero_pd();
+            for(; p + 4 <= rowEnd; p += 4) {
+                __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + p));
+                __m256d gathered = _mm256_i32gather_pd(x, index, 8);
+                sum = _mm256_fmadd_pd(_mm256_loadu_pd(values + p), gathered, sum);
+            }
+            __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+            double total = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+            for(; p < rowEnd; p ++) {
+                total += values[p] * x[columns[p]];
+            }
+            y[row] = total;
+        }
+    }
+#endif
+}
+
+SparseMatrix::SparseMatrix(int rows, std::vector<int> rowStart, std::vector<int> columns) : rows{rows}, rowStart{std::move(rowStart)},
+        columns{std::move(columns)}, values(this->columns.size(), 0) {}
+
+int SparseMatrix::find(int row, int col) const {
+    if(row < 0 || col < 0) return -1;
+    auto begin = columns.begin() + rowStart[row];
+    auto end = columns.begin() + rowStart[row + 1];
+    auto iter = std::lower_bound(begin, end, col);
+    if(iter == end || *iter != col) return -1;
+    return static_cast<int>(iter - columns.begin());
+}
+
+bool SparseMatrix::hasAvx2() {
+#if defined(SCHEMATIC_X86) && defined(_MSC_VER)
+    static const bool result = [] {
+        int info[4];
+        __cpuid(info, 1);
+        bool osSaves = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        bool fma = (info[2] & (1 << 12)) != 0;
+        __cpuidex(info, 7, 0);
+        return osSaves && fma && (info[1] & (1 << 5)) != 0;
+    }();
+    return result;
+#elif defined(SCHEMATIC_X86)
+    static const bool result = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return result;
+#else
+    return false;
+#endif
+}
+
+void SparseMatrix::multiplyRows(const double* x, double* y, int begin, int end) const {
+#ifdef SCHEMATIC_X86
+    if(hasAvx2()) {
+        multiplyAvx2(rowStart.data(), columns.data(), values.data(), x, y, begin, end);
+        return;
+    }
+#endif
+    multiplyScalar(rowStart.data(), columns.data(), values.data(), x, y, begin, end);
+}
+
+void SparseMatrix::multiply(const double* x, double* y, ThreadPool* pool) const {
+    if(pool == nullptr || pool->size() < 2 || columns.size() < PARALLEL_ENTRIES) {
+        multiplyRows(x, y, 0, rows);
+        return;
+    }
+    if(partition.size() != pool->size() + 1) {
+        partition.assign(1, 0);
+        size_t perThread = columns.size() / pool->size();
+        for(unsigned i = 1; i < pool->size(); i ++) {
+            auto iter = std::lower_bound(rowStart.begin(), rowStart.end(), static_cast<int>(perThread * i));
+            partition.push_back(std::max(partition.back(), static_cast<int>(iter - rowStart.begin())));
+        }
+        partition.push_back(rows);
+    }
+    for(size_t i = 0; i + 1 < partition.size(); i ++) {
+        int begin = partition[i];
+        int end = partition[i + 1];
+        if(begin < end) {
+            pool->submit([this, x, y, begin, end] {multiplyRows(x, y, begin, end);});
+        }
+    }
+    pool->wait();
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <vector>
+#include "ThreadPool.h"
+
+//Square matrix in compressed sparse row form, with a matrix-vector product that uses AVX2 when the CPU has it
+//and splits large matrices over a thread pool
+class SparseMatrix {
+public:
+    SparseMatrix() = default;
+    //columns must be sorted within each row
+    SparseMatrix(int rows, std::vector<int> rowStart, std::vector<int> columns);
+    int rows{0};
+    std::vector<int> rowStart;
+    std::vector<int> columns;
+    std::vector<double> values;
+    //Position of (row, col) in values, or -1 if it is not part of the pattern
+    int find(int row, int col) const;
+    //y = Ax. pool may be null, and is only used once the matrix is big enough to be worth splitting.
+    void multiply(const double* x, double* y, ThreadPool* pool = nullptr) const;
+    static bool hasAvx2();
+private:
+    void multiplyRows(const double* x, double* y, int begin, int end) const;
+    //Row ranges holding roughly equal numbers of entries, one per pool thread
+    mutable std::vector<int> partition;
+};
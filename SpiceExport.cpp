@@ -0,0 +1,108 @@
+#include "SpiceExport.h"
+#include "Solver.h"
+#include "OutputBuffer.h"
+#include <algorithm>
+#include <unordered_set>
+#include <string>
+
+namespace {
+    //SPICE names are whitespace separated ASCII, so anything else becomes a full stop
+    std::string spiceName(const std::wstring& name) {
+        std::string result(name.size(), '.');
+        for(size_t i = 0; i < name.size(); i ++) {
+            wchar_t c = name[i];
+            if((c >= L'0' && c <= L'9') || (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') || c == L'.' || c == L'-' || c == L'+' || c == L'_') {
+                result[i] = static_cast<char>(c);
+            }
+        }
+        return result;
+    }
+
+    //Expressions keep their operators and spaces, only characters outside ASCII are replaced
+    std::string spiceExpression(const std::wstring& expression) {
+        std::string result(expression.size(), '_');
+        for(size_t i = 0; i < expression.size(); i ++) {
+            if(expression[i] >= 0x20 && expression[i] < 0x7F && expression[i] != L'{' && expression[i] != L'}') {
+                result[i] = static_cast<char>(expression[i]);
+            }
+        }
+        return result;
+    }
+}
+
+void spice::write(std::ostream& ostream, const Netlist& netlist, const std::string& title) {
+    OutputBuffer writer{ostream};
+    writer << title << '\n';
+    writer << "* " << netlist.elements.size() << " elements, " << netlist.nodeCount() << " nodes\n";
+
+    //Unlabelled nodes are written as _<index>. Cleaning labels up can give two nets the same name, as can case, which
+    //SPICE ignores, so a label whose name is taken gets the first free suffix of _2, _3...
+    std::vector<std::string> labels(netlist.nodeCount());
+    std::unordered_set<std::string> taken{"0"}; //lower case
+    auto lower = [](std::string name) {
+        std::transform(name.begin(), name.end(), name.begin(), [](char c) {return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;});
+        return name;
+    };
+    for(uint32_t node = 1; node < netlist.nodeCount(); node ++) {
+        if(netlist.nodeNames[node].empty()) taken.insert('_' + std::to_string(node));
+    }
+    for(uint32_t node = 1; node < netlist.nodeCount(); node ++) {
+        if(netlist.nodeNames[node].empty()) continue;
+        std::string name = spiceName(netlist.nodeNames[node]);
+        for(int suffix = 2; taken.contains(lower(name)); suffix ++) {
+            name = spiceName(netlist.nodeNames[node]) + '_' + std::to_string(suffix);
+        }
+        taken.insert(lower(name));
+        labels[node] = std::move(name);
+    }
+    auto node = [&](uint32_t node) -> OutputBuffer& {
+        writer << ' ';
+        if(node == Netlist::GROUND) return writer << '0';
+        if(!labels[node].empty()) return writer << labels[node];
+        return writer << '_' << node;
+    };
+
+    auto expression = netlist.expressions.begin();
+    for(size_t i = 0; i < netlist.elements.size(); i ++) {
+        const Netlist::Element& element = netlist.elements[i];
+        const std::wstring* text = nullptr;
+        if(expression != netlist.expressions.end() && expression->first == i) {
+            text = &expression->second;
+            ++expression;
+        }
+        //SPICE current sources push current out of their second node, the netlist's out of the first
+        uint32_t first = element.type == Item::ItemType::amp_source ? element.nodeB : element.nodeA;
+        uint32_t second = element.type == Item::ItemType::amp_source ? element.nodeA : element.nodeB;
+        switch(element.type) {
+            case Item::ItemType::resistor:
+                writer << 'R';
+                break;
+            case Item::ItemType::capacitor:
+                writer << 'C';
+                break;
+            case Item::ItemType::volt_source: case Item::ItemType::amp_source:
+                writer << (element.dependent ? 'B' : element.type == Item::ItemType::volt_source ? 'V' : 'I');
+                break;
+            case Item::ItemType::toggle:
+                writer << (element.value != 0 ? "RSW" : "* SW");
+                break;
+            default:
+                continue;
+        }
+        writer << i;
+        node(first);
+        node(second);
+        writer << ' ';
+        if(element.type == Item::ItemType::toggle) {
+            if(element.value != 0) writer << Solver::MIN_RESISTANCE;
+            else writer << "open";
+        } else {
+            if(element.dependent) writer << (element.type == Item::ItemType::volt_source ? "V=" : "I=");
+            if(text != nullptr) writer << '{' << spiceExpression(*text) << '}';
+            else if(element.type == Item::ItemType::resistor) writer << std::max(element.value, Solver::MIN_RESISTANCE);
+            else writer << element.value;
+        }
+        writer << '\n';
+    }
+    writer << ".op\n.end\n";
+}
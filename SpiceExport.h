@@ -0,0 +1,10 @@
+#pragma once
+#include <ostream>
+#include "Netlist.h"
+
+namespace spice {
+    //Writes the netlist as a SPICE deck with a .op analysis. Nodes take their wire label where they have one, with a
+    //suffix where two labels would otherwise be the same name to SPICE, and ground is node 0. Text values are written as {expressions}, dependent sources as B sources, and switches as a
+    //closed-switch resistance or a comment when open.
+    void write(std::ostream& ostream, const Netlist& netlist, const std::string& title);
+}
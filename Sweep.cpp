@@ -0,0 +1,69 @@
+#include "Sweep.h"
+#include <limits>
+#include <algorithm>
+
+Sweep::Sweep(const Netlist& netlist, std::vector<Point> points) : solver{netlist}, points{std::move(points)},
+        columns{solver.nodeCount() + solver.elementCount()}, table(this->points.size() * columns),
+        errors(this->points.size()), finished{std::make_unique<std::atomic<bool>[]>(this->points.size())} {}
+
+void Sweep::run(ThreadPool& pool) {
+    numCompleted = 0;
+    for(size_t i = 0; i < points.size(); i ++) {
+        finished[i] = false;
+    }
+    //A few chunks per worker, so stealing can even out points that take longer than others
+    size_t chunk = std::max<size_t>(1, points.size() / (pool.size() * 8));
+    for(size_t begin = 0; begin < points.size(); begin += chunk) {
+        size_t end = std::min(begin + chunk, points.size());
+        pool.submit([this, begin, end] {
+            for(size_t i = begin; i < end; i ++) {
+                solvePoint(i);
+            }
+        });
+    }
+    pool.wait();
+}
+
+void Sweep::solvePoint(size_t point) {
+    double* result = table.data() + point * columns;
+    try {
+        solver.solve(points[point], result, result + solver.nodeCount());
+    } catch(std::exception& e) {
+        errors[point] = e.what();
+        std::fill(result, result + columns, std::numeric_limits<double>::quiet_NaN());
+    }
+    finished[point].store(true, std::memory_order_release);
+    numCompleted ++;
+}
+
+size_t Sweep::size() const {
+    return points.size();
+}
+
+size_t Sweep::completed() const {
+    return numCompleted;
+}
+
+bool Sweep::done(size_t point) const {
+    return finished[point].load(std::memory_order_acquire);
+}
+
+const std::string& Sweep::error(size_t point) const {
+    return errors[point];
+}
+
+const double* Sweep::row(size_t point) const {
+    return table.data() + point * columns;
+}
+
+double Sweep::voltage(size_t point, uint32_t node) const {
+    return row(point)[node];
+}
+
+double Sweep::current(size_t point, size_t element) const {
+    return row(point)[solver.nodeCount() + element];
+}
+
+const Solver& Sweep::getSolver() const {
+    return solver;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <atomic>
+#include "Solver.h"
+#include "ThreadPool.h"
+
+//Solves one netlist at many parameter points in parallel.
+//All points share the Solver's symbolic analysis; each point only assembles and factorizes its own values.
+class Sweep {
+public:
+    using Point = std::vector<Solver::Assignment>;
+    Sweep(const Netlist& netlist, std::vector<Point> points);
+    //Solves every point on the pool and returns once they are all done. Rows are written as they finish,
+    //so another thread can watch completed() and read rows whose done() is true while this runs.
+    void run(ThreadPool& pool);
+    size_t size() const;
+    size_t completed() const;
+    bool done(size_t point) const;
+    //Empty if the point solved, otherwise why it failed
+    const std::string& error(size_t point) const;
+    //nodeCount() voltages followed by elementCount() currents
+    const double* row(size_t point) const;
+    double voltage(size_t point, uint32_t node) const;
+    double current(size_t point, size_t element) const;
+    const Solver& getSolver() const;
+private:
+    void solvePoint(size_t point);
+    Solver solver;
+    std::vector<Point> points;
+    size_t columns;
+    std::vector<double> table;
+    std::vector<std::string> errors;
+    std::unique_ptr<std::atomic<bool>[]> finished;
+    std::atomic<size_t> numCompleted{0};
+};
@@ -0,0 +1,92 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if(threads == 0) threads = 1;
+    for(unsigned i = 0; i < threads; i ++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for(unsigned i = 0; i < threads; i ++) {
+        this->threads.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    available.notify_all();
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+unsigned ThreadPool::size() const {
+    return static_cast<unsigned>(threads.size());
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    pending ++;
+    Queue& queue = *queues[nextQueue++ % queues.size()];
+    {
+        std::lock_guard lock{queue.mutex};
+        queue.tasks.push_back(std::move(task));
+        queued ++;
+    }
+    //A worker counts itself idle before it checks queued, so one of the two sees the other and none sleeps through this
+    if(idle > 0) {
+        std::lock_guard lock{mutex};
+        available.notify_one();
+    }
+}
+
+void ThreadPool::wait() {
+    std::unique_lock lock{mutex};
+    finished.wait(lock, [this] {return pending == 0;});
+}
+
+//Newest task from our own queue first, since it is most likely still in cache, otherwise the oldest task of another queue
+bool ThreadPool::take(unsigned index, std::function<void()>& task) {
+    {
+        Queue& own = *queues[index];
+        std::lock_guard lock{own.mutex};
+        if(!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued --;
+            return true;
+        }
+    }
+    for(size_t i = 1; i < queues.size(); i ++) {
+        Queue& other = *queues[(index + i) % queues.size()];
+        std::lock_guard lock{other.mutex};
+        if(!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            queued --;
+            return true;
+        }
+    }
+    return false;
+}
+
+//Only goes to sleep once no queue has a task, so a busy pool takes and runs tasks without touching the shared lock
+void ThreadPool::run(unsigned index) {
+    std::function<void()> task;
+    while(true) {
+        if(take(index, task)) {
+            task();
+            task = nullptr;
+            if(--pending == 0) {
+                std::lock_guard lock{mutex};
+                finished.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock lock{mutex};
+        idle ++;
+        available.wait(lock, [this] {return stopping || queued > 0;});
+        idle --;
+        if(queued == 0) return; //stopping, and nothing left to do
+    }
+}
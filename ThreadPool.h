@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+
+//Work-stealing thread pool: each worker has its own queue and takes from the others once it runs dry
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    //Tasks must not throw
+    void submit(std::function<void()> task);
+    //Blocks until every submitted task has finished
+    void wait();
+    unsigned size() const;
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+    void run(unsigned index);
+    bool take(unsigned index, std::function<void()>& task);
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    //Only for sleeping and waking: tasks are pushed and taken under their queue's lock alone
+    std::mutex mutex;
+    std::condition_variable available;
+    std::condition_variable finished;
+    std::atomic<size_t> queued{0}; //tasks in the queues, changed under the lock of the queue pushed to or taken from
+    std::atomic<size_t> pending{0}; //submitted and not yet finished
+    std::atomic<unsigned> idle{0}; //workers asleep on available, or about to be
+    std::atomic<unsigned> nextQueue{0};
+    bool stopping{false};
+};
@@ -1,44 +1,633 @@
 #include "WindowGrid.h"
 #include "Resources.h"
+#include "Components.h"
 #include "id.h"
+#include "ReplicateDialog.h"
+#include "ImageExport.h"
+#include "Profiler.h"
+#include <wx/dcmemory.h>
+#include <wx/rawbmp.h>
+#include <wx/textdlg.h>
+#include <wx/choicdlg.h>
+#include <wx/msgdlg.h>
 #include <wx/graphics.h>
 #include <utility>
 #include <sstream>
 #include <fstream>
+#include <chrono>
+#include <cmath>
+#include <bit>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include "ThreadPool.h"
 #include <wx/propgrid/props.h>
 
 //Helper functions defined at end of file
 namespace {
+    constexpr int FILE_SCROLL_UNIT = 16; //files keep the view position in the 16 pixel steps scrolling used to move by
+    constexpr int INSTANCE_TILE = 64; //cells along a side of the squares instances are found by when painting
+    constexpr int LINE_PIXELS = 16; //scrolled by an arrow key, a click on a scroll bar arrow or a line of a wheel turn
     Item valueDialog(const Item& currentItem);
     int getDirection(const wxPoint& currentCell, const wxPoint& lastCell);
+    //A file read whole into memory, read from the front. Reading past its end throws.
+    struct Reader {
+        std::vector<char> data;
+        const char* at;
+        const char* end;
+        template<typename T>
+        T read() {
+            T value;
+            if(static_cast<size_t>(end - at) < sizeof(T)) {
+                throw std::runtime_error{"File invalid"};
+            }
+            std::memcpy(&value, at, sizeof(T));
+            at += sizeof(T);
+            return value;
+        }
+        std::wstring readString();
+    };
+    Reader readRest(std::ifstream& ifstream);
+    std::vector<std::pair<uint32_t, GridVersion::Runs>> readLines(Reader& reader);
     int flip(int direction);
     int rotateCW(int direction);
     int rotateCCW(int direction);
+    wxColour voltageColour(double fraction);
 }
 
 void WindowGrid::OnDraw(wxDC& dc) {
+    int64_t frameStart = profiler::enabled() ? profiler::now() : -1;
+    framesDrawn ++;
+    int cellSize = 128 + 16 * zoomLevels;
+    updateBacking(cellSize);
+    if(backing.IsOk()) dc.DrawBitmap(backing, backingArea.GetPosition());
     dc.SetBrush(*wxBLACK_BRUSH);
     dc.SetPen(pen);
     dc.SetFont(font);
     wxRect updateRect = GetUpdateRegion().GetBox();
     wxPoint tl = CalcUnscrolledPosition(wxPoint{updateRect.GetLeft(), updateRect.GetTop()});
     wxPoint br = CalcUnscrolledPosition(wxPoint{updateRect.GetRight(), updateRect.GetBottom()});
-    int cellSize = 128 + 16 * zoomLevels;
     wxPoint origin = dc.GetDeviceOrigin();
-    for (int r = (tl.y - cellSize + 1) / cellSize; r < std::min((br.y + cellSize - 1) / cellSize, static_cast<int>(grid.getHeight())); r++) {
-        for (int c = (tl.x - cellSize + 1) / cellSize; c < std::min((br.x + cellSize - 1) / cellSize, static_cast<int>(grid.getWidth())); c++) {
-            dc.SetDeviceOrigin(origin.x + cellSize * c, origin.y + cellSize * r);
-            grid.get(r, c).draw(dc, cellSize, dotSize, rotatedText, resistorBitmaps, capacitorBitmaps, ampSourceBitmaps, voltSourceBitmaps, switchBitmaps);
+    int rowBegin = (tl.y - cellSize + 1) / cellSize;
+    int rowEnd = std::min((br.y + cellSize - 1) / cellSize, static_cast<int>(grid.getHeight()));
+    int colBegin = (tl.x - cellSize + 1) / cellSize;
+    int colEnd = std::min((br.x + cellSize - 1) / cellSize, static_cast<int>(grid.getWidth()));
+    //A live snapshot stays valid while this reference is held, however many newer ones the solver publishes meanwhile
+    std::shared_ptr<const LiveSimulation::Snapshot> snapshot = live ? live->getSnapshot() : nullptr;
+    const Overlay* results = snapshot ? snapshot->overlay.get() : overlay.get();
+    if(results && rowBegin < rowEnd && colBegin < colEnd) {
+        drawOverlay(dc, *results, origin, cellSize, rowBegin, rowEnd, colBegin, colEnd);
+    }
+    if(counterpart && rowBegin < rowEnd && colBegin < colEnd) {
+        drawDifferences(dc, origin, cellSize, rowBegin, rowEnd, colBegin, colEnd);
+    }
+    if(!selection.IsEmpty()) {
+        wxRect shown = selection;
+        if(moving && currentCell != wxPoint{-1, -1}) shown.Offset(currentCell - dragStart);
+        dc.SetDeviceOrigin(origin.x, origin.y);
+        dc.SetPen(wxPen{wxPenInfo(wxColour{0, 120, 215}, std::max(pen.GetWidth() / 2, 1)).Style(wxPENSTYLE_SHORT_DASH)});
+        dc.SetBrush(*wxTRANSPARENT_BRUSH);
+        dc.DrawRectangle(shown.x * cellSize, shown.y * cellSize, shown.width * cellSize, shown.height * cellSize);
+    }
+    if(frameStart != -1) {
+        int64_t frameEnd = profiler::now();
+        profiler::record("OnDraw", frameStart, frameEnd);
+        int64_t counts[static_cast<int>(profiler::Counter::count)];
+        profiler::sample("frame", counts);
+        dc.SetDeviceOrigin(origin.x, origin.y);
+        drawProfile(dc, frameEnd - frameStart, counts);
+    }
+}
+
+//Brings the backing store up to date with the window's size, scroll position and zoom. What is still in view is
+//shifted across in memory, and cells are only drawn where they have come into view or been refreshed since.
+void WindowGrid::updateBacking(int cellSize) {
+    wxRect area{CalcUnscrolledPosition(wxPoint{0, 0}), GetClientSize()};
+    if(area.IsEmpty()) return;
+    bool resized = !backing.IsOk() || backing.GetWidth() != area.width || backing.GetHeight() != area.height;
+    if(resized) {
+        backing = wxBitmap{area.width, area.height, 24};
+        backingSpare = wxBitmap{area.width, area.height, 24};
+    }
+    if(resized || !backingValid || backingCellSize != cellSize) {
+        stale = wxRegion{area};
+        backingValid = true;
+        backingCellSize = cellSize;
+    } else if(area.GetPosition() != backingArea.GetPosition()) {
+        wxRect kept = area.Intersect(backingArea);
+        wxRegion exposed{area};
+        if(!kept.IsEmpty()) {
+            wxMemoryDC from{backing};
+            wxMemoryDC to{backingSpare};
+            to.Blit(kept.x - area.x, kept.y - area.y, kept.width, kept.height, &from, kept.x - backingArea.x, kept.y - backingArea.y);
+            exposed.Subtract(kept);
+        }
+        std::swap(backing, backingSpare);
+        stale.Union(exposed);
+    }
+    backingArea = area;
+    stale.Intersect(area);
+    if(stale.IsEmpty()) return;
+    wxMemoryDC dc{backing};
+    dc.SetDeviceOrigin(-area.x, -area.y);
+    for(wxRegionIterator rect{stale}; rect; ++rect) {
+        drawArea(dc, wxPoint{-area.x, -area.y}, cellSize, rect.GetRect());
+    }
+    stale.Clear();
+}
+
+//Draws the background, cells and instances of area, in logical coordinates, and nothing outside it
+void WindowGrid::drawArea(wxDC& dc, wxPoint origin, int cellSize, const wxRect& area) {
+    dc.SetDeviceOrigin(origin.x, origin.y);
+    dc.SetClippingRegion(area);
+    dc.SetPen(*wxTRANSPARENT_PEN);
+    dc.SetBrush(wxBrush{GetBackgroundColour()});
+    dc.DrawRectangle(area);
+    dc.SetBrush(*wxBLACK_BRUSH);
+    dc.SetPen(pen);
+    dc.SetFont(font);
+    //From a cell early, as text can reach past the cell it belongs to
+    int rowBegin = std::max((area.GetTop() - cellSize + 1) / cellSize, 0);
+    int rowEnd = std::min((area.GetBottom() + cellSize - 1) / cellSize, static_cast<int>(grid.getHeight()));
+    int colBegin = std::max((area.GetLeft() - cellSize + 1) / cellSize, 0);
+    int colEnd = std::min((area.GetRight() + cellSize - 1) / cellSize, static_cast<int>(grid.getWidth()));
+    if(renderer == Renderer::per_cell) {
+        for (int r = rowBegin; r < rowEnd; r++) {
+            for (int c = colBegin; c < colEnd; c++) {
+                dc.SetDeviceOrigin(origin.x + cellSize * c, origin.y + cellSize * r);
+                grid.get(r, c).draw(dc, cellSize, dotSize, rotatedText, glyphs);
+            }
+        }
+    } else if(renderer == Renderer::software) {
+        composeCells(dc, origin, cellSize, batchCells(cellSize, rowBegin, rowEnd, colBegin, colEnd), area);
+    } else {
+        drawCells(dc, origin, cellSize, batchCells(cellSize, rowBegin, rowEnd, colBegin, colEnd));
+    }
+    if(rowBegin < rowEnd && colBegin < colEnd) {
+        profiler::count(profiler::Counter::cells_visited, static_cast<int64_t>(rowEnd - rowBegin) * (colEnd - colBegin));
+        drawInstances(dc, origin, cellSize, wxRect{wxPoint{colBegin, rowBegin}, wxPoint{colEnd - 1, rowEnd - 1}});
+    }
+    dc.SetDeviceOrigin(origin.x, origin.y);
+    dc.DestroyClippingRegion();
+}
+
+void WindowGrid::Refresh(bool eraseBackground, const wxRect* rect) {
+    if(rect == nullptr) {
+        backingValid = false;
+    } else {
+        stale.Union(wxRect{CalcUnscrolledPosition(rect->GetPosition()), rect->GetSize()});
+    }
+    wxScrolledCanvas::Refresh(eraseBackground, rect);
+}
+
+//Scrolling paints the whole window again from the backing store instead of moving what is on screen, which would
+//leave the backing store behind
+void WindowGrid::ScrollWindow(int dx, int dy, const wxRect* rect) {
+    wxScrolledCanvas::Refresh(false);
+    viewMoved();
+}
+
+void WindowGrid::repaint() {
+    wxScrolledCanvas::Refresh(false);
+}
+
+//Sorts the cells in view by what draws them, so a renderer can draw a kind of thing at a time: the dots of empty
+//cells, then each glyph bitmap in one run, then wires joined into straight lines, then every label
+WindowGrid::CellBatch WindowGrid::batchCells(int cellSize, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    CellBatch batch{};
+    if(rowBegin >= rowEnd || colBegin >= colEnd) return batch;
+    struct Line {
+        int from, to; //along the line, -1 when no line is being joined
+        int at; //across it
+    };
+    std::vector<Line> columns(colEnd - colBegin, Line{-1, -1, 0});
+    int half = cellSize / 2;
+    auto extend = [&batch](Line& line, int from, int to, int at, bool vertical) {
+        if(line.from != -1 && line.to == from && line.at == at) {
+            line.to = to;
+            return;
+        }
+        if(line.from != -1) {
+            batch.lines.push_back(vertical ? wxPoint{line.at, line.from} : wxPoint{line.from, line.at});
+            batch.lines.push_back(vertical ? wxPoint{line.at, line.to} : wxPoint{line.to, line.at});
+        }
+        line = Line{from, to, at};
+    };
+    //Wires kept in runs are drawn a run at a time, clipped to the view. Piece boundary p is p / 2 cells along, and half a
+    //cell more if p is odd.
+    auto runLines = [&batch, cellSize, half](const GridVersion::Lines& lines, int begin, int end, int alongBegin, int alongEnd, bool vertical) {
+        auto line = std::lower_bound(lines.begin(), lines.end(), static_cast<uint32_t>(begin), [](const auto& line, uint32_t at) {return line.first < at;});
+        for(; line != lines.end() && line->first < static_cast<uint32_t>(end); ++ line) {
+            int across = cellSize * static_cast<int>(line->first) + half;
+            for(auto [first, second] : *line->second) {
+                int from = std::max(static_cast<int>(first), 2 * alongBegin);
+                int to = std::min(static_cast<int>(second), 2 * alongEnd);
+                if(from >= to) continue;
+                int fromPixel = from / 2 * cellSize + from % 2 * half;
+                int toPixel = to / 2 * cellSize + to % 2 * half;
+                batch.lines.push_back(vertical ? wxPoint{across, fromPixel} : wxPoint{fromPixel, across});
+                batch.lines.push_back(vertical ? wxPoint{across, toPixel} : wxPoint{toPixel, across});
+            }
+        }
+    };
+    runLines(grid.gridMap.rowRuns(), rowBegin, rowEnd, colBegin, colEnd, false);
+    runLines(grid.gridMap.columnRuns(), colBegin, colEnd, rowBegin, rowEnd, true);
+    for(int r = rowBegin; r < rowEnd; r ++) {
+        Line row{-1, -1, 0};
+        for(int c = colBegin; c < colEnd; c ++) {
+            const Item* item = grid.gridMap.find((static_cast<uint64_t>(r) << 32) | static_cast<uint32_t>(c));
+            wxPoint cell{cellSize * c, cellSize * r};
+            if(item == nullptr) {
+                if(dotSize != -1) batch.dots.emplace_back(cell.x + half, cell.y + half);
+                continue;
+            }
+            if(item->type == Item::ItemType::instance) continue;
+            if(item->type == Item::ItemType::wire) {
+                int shape = item->shape;
+                bool inRuns = GridVersion::inRuns(*item);
+                if(!inRuns && (shape & (Item::LEFT | Item::RIGHT))) {
+                    extend(row, cell.x + ((shape & Item::LEFT) ? 0 : half), cell.x + ((shape & Item::RIGHT) ? cellSize : half), cell.y + half, false);
+                }
+                if(!inRuns && (shape & (Item::UP | Item::DOWN))) {
+                    extend(columns[c - colBegin], cell.y + ((shape & Item::UP) ? 0 : half), cell.y + ((shape & Item::DOWN) ? cellSize : half), cell.x + half, true);
+                }
+                if(std::popcount(static_cast<unsigned>(shape & (Item::UP | Item::DOWN | Item::LEFT | Item::RIGHT))) > 2) {
+                    batch.junctions.emplace_back(cell.x + half, cell.y + half);
+                }
+                if(!item->extraData.empty()) batch.labels.emplace_back(item, cell);
+                continue;
+            }
+            batch.glyphs.emplace_back(item->glyph(glyphs), cell);
+            batch.labels.emplace_back(item, cell);
+        }
+        extend(row, -1, -1, 0, false);
+    }
+    for(Line& column : columns) {
+        extend(column, -1, -1, 0, true);
+    }
+    //Stable so each glyph's cells are still drawn in row order
+    std::stable_sort(batch.glyphs.begin(), batch.glyphs.end(), [](const auto& a, const auto& b) {return a.first < b.first;});
+    profiler::count(profiler::Counter::glyphs_blitted, static_cast<int64_t>(batch.glyphs.size()));
+    profiler::count(profiler::Counter::labels_drawn, static_cast<int64_t>(batch.labels.size()));
+    return batch;
+}
+
+//Draws the same as Item::draw for every cell in the batch, but the device origin, pen and bitmap change a handful of
+//times a frame instead of for each cell
+void WindowGrid::drawCells(wxDC& dc, wxPoint origin, int cellSize, const CellBatch& batch) {
+    dc.SetDeviceOrigin(origin.x, origin.y);
+    int dotRadius = std::max(cellSize * dotSize / 128, 1);
+    for(wxPoint dot : batch.dots) {
+        dc.DrawCircle(dot, dotRadius);
+    }
+    for(const auto& [bitmap, cell] : batch.glyphs) {
+        dc.DrawBitmap(*bitmap, cell);
+    }
+    for(size_t i = 0; i < batch.lines.size(); i += 2) {
+        dc.DrawLine(batch.lines[i], batch.lines[i + 1]);
+    }
+    int junctionRadius = std::max(cellSize * 3 / 128, 1);
+    for(wxPoint junction : batch.junctions) {
+        dc.DrawCircle(junction, junctionRadius);
+    }
+    drawLabels(dc, origin, cellSize, batch);
+}
+
+//Draws the batch into area of the Compositor's buffer, in logical coordinates, and shows it with one blit. Labels
+//are still drawn by dc over the top.
+void WindowGrid::composeCells(wxDC& dc, wxPoint origin, int cellSize, const CellBatch& batch, const wxRect& area) {
+    if(area.IsEmpty()) return;
+    int penWidth = pen.GetWidth();
+    if(spriteCellSize != cellSize || spriteDotSize != dotSize) {
+        //A circle drawn by wxDC is filled to its radius and stroked with the pen around it
+        glyphSprites.clear();
+        dotSprite = Compositor::disc(std::max(cellSize * dotSize / 128, 1) + penWidth / 2.0, Compositor::pack(0, 0, 0));
+        junctionSprite = Compositor::disc(std::max(cellSize * 3 / 128, 1) + penWidth / 2.0, Compositor::pack(0, 0, 0));
+        spriteCellSize = cellSize;
+        spriteDotSize = dotSize;
+    }
+    wxColour background = GetBackgroundColour();
+    compositor.resize(area.width, area.height);
+    compositor.clear(Compositor::pack(background.Red(), background.Green(), background.Blue()));
+    for(wxPoint dot : batch.dots) {
+        compositor.blend(dotSprite, dot.x - area.x - dotSprite.width / 2, dot.y - area.y - dotSprite.height / 2);
+    }
+    const Compositor::Sprite* sprite = nullptr;
+    const wxBitmap* spriteOf = nullptr;
+    for(const auto& [bitmap, cell] : batch.glyphs) {
+        if(bitmap != spriteOf) {
+            auto iterator = glyphSprites.find(bitmap);
+            if(iterator == glyphSprites.end()) {
+                wxImage image = bitmap->ConvertToImage();
+                iterator = glyphSprites.emplace(bitmap, Compositor::fromRgb(image.GetWidth(), image.GetHeight(), image.GetData(),
+                        image.HasAlpha() ? image.GetAlpha() : nullptr)).first;
+            }
+            sprite = &iterator->second;
+            spriteOf = bitmap;
+        }
+        compositor.blend(*sprite, cell.x - area.x, cell.y - area.y);
+    }
+    //Square ends that reach half the pen past each end, so corners join without a notch
+    for(size_t i = 0; i < batch.lines.size(); i += 2) {
+        wxRect line{batch.lines[i], batch.lines[i + 1]};
+        compositor.fill(line.x - area.x - penWidth / 2, line.y - area.y - penWidth / 2, line.width - 1 + penWidth, line.height - 1 + penWidth,
+                Compositor::pack(0, 0, 0));
+    }
+    for(wxPoint junction : batch.junctions) {
+        compositor.blend(junctionSprite, junction.x - area.x - junctionSprite.width / 2, junction.y - area.y - junctionSprite.height / 2);
+    }
+    if(frame.GetWidth() != area.width || frame.GetHeight() != area.height) {
+        frame = wxBitmap{area.width, area.height, 24};
+    }
+    {
+        wxNativePixelData pixels{frame};
+        wxNativePixelData::Iterator target{pixels};
+        const uint32_t* source = compositor.data();
+        for(int y = 0; y < area.height; y ++) {
+            wxNativePixelData::Iterator rowStart = target;
+            for(int x = 0; x < area.width; x ++, source ++) {
+                target.Red() = static_cast<uint8_t>(*source);
+                target.Green() = static_cast<uint8_t>(*source >> 8);
+                target.Blue() = static_cast<uint8_t>(*source >> 16);
+                ++target;
+            }
+            target = rowStart;
+            target.OffsetY(pixels, 1);
+        }
+    }
+    dc.SetDeviceOrigin(origin.x, origin.y);
+    dc.DrawBitmap(frame, area.GetPosition());
+    drawLabels(dc, origin, cellSize, batch);
+}
+
+void WindowGrid::drawLabels(wxDC& dc, wxPoint origin, int cellSize, const CellBatch& batch) {
+    for(const auto& [item, cell] : batch.labels) {
+        dc.SetDeviceOrigin(origin.x + cell.x, origin.y + cell.y);
+        item->drawLabel(dc, cellSize, rotatedText);
+    }
+}
+
+//Frame time and counts of the frame just drawn, in the top left corner of the window
+void WindowGrid::drawProfile(wxDC& dc, int64_t frameTime, const int64_t* counts) {
+    averageFrameTime = averageFrameTime == 0 ? frameTime : averageFrameTime * 0.9 + frameTime * 0.1;
+    auto at = [counts](profiler::Counter counter) {
+        return static_cast<long long>(counts[static_cast<int>(counter)]);
+    };
+    wxString text = wxString::Format("Frame %.2f ms (average %.2f ms)\n%lld cells, %lld glyphs, %lld labels\nBitmap cache %lld hits, %lld misses",
+            frameTime / 1000.0, averageFrameTime / 1000.0, at(profiler::Counter::cells_visited), at(profiler::Counter::glyphs_blitted),
+            at(profiler::Counter::labels_drawn), at(profiler::Counter::bitmap_cache_hits), at(profiler::Counter::bitmap_cache_misses));
+    wxFont profileFont = wxSystemSettings::GetFont(wxSYS_DEFAULT_GUI_FONT);
+    dc.SetFont(profileFont);
+    wxSize size = dc.GetMultiLineTextExtent(text);
+    wxPoint corner = CalcUnscrolledPosition(wxPoint{8, 8});
+    dc.SetPen(*wxBLACK_PEN);
+    dc.SetBrush(*wxWHITE_BRUSH);
+    dc.DrawRectangle(wxRect{corner, size}.Inflate(4));
+    dc.DrawLabel(text, wxRect{corner, size});
+    dc.SetFont(font);
+}
+
+//Each instance is one cached bitmap of its sub-circuit. Cells drawn over an instance are drawn again on top of it.
+void WindowGrid::drawInstances(wxDC& dc, wxPoint origin, int cellSize, const wxRect& visible) {
+    wxPen outlinePen{wxPenInfo(wxColour{128, 128, 128}, std::max(pen.GetWidth() / 2, 1)).Style(wxPENSTYLE_DOT)};
+    for(const auto& [key, bounds] : instancesIn(visible)) {
+        const Item& instance = *grid.gridMap.find(key);
+        wxRect overlap = bounds.Intersect(visible);
+        dc.SetDeviceOrigin(origin.x + cellSize * bounds.x, origin.y + cellSize * bounds.y);
+        const wxBitmap* bitmap = instanceBitmap(instance, bounds.GetSize(), cellSize);
+        if(bitmap != nullptr) {
+            dc.DrawBitmap(*bitmap, 0, 0);
+        } else { //too big to cache at this zoom, draw the cells in view from the expanded definition
+            dc.SetPen(pen);
+            dc.SetBrush(*wxBLACK_BRUSH);
+            const std::vector<std::pair<uint64_t, Item>>& cells = instanceCells(instance);
+            for(int r = overlap.GetTop(); r <= overlap.GetBottom(); r ++) {
+                uint64_t rowKey = static_cast<uint64_t>(r - bounds.y) << 32;
+                auto iterator = std::lower_bound(cells.begin(), cells.end(), rowKey | static_cast<uint32_t>(overlap.GetLeft() - bounds.x),
+                    [](const std::pair<uint64_t, Item>& cell, uint64_t key) {return cell.first < key;});
+                uint64_t end = rowKey | static_cast<uint32_t>(overlap.GetRight() - bounds.x);
+                for(; iterator != cells.end() && iterator->first <= end; ++iterator) {
+                    auto c = bounds.x + static_cast<int>(static_cast<uint32_t>(iterator->first));
+                    dc.SetDeviceOrigin(origin.x + cellSize * c, origin.y + cellSize * r);
+                    iterator->second.draw(dc, cellSize, dotSize, rotatedText, glyphs);
+                }
+            }
+            dc.SetDeviceOrigin(origin.x + cellSize * bounds.x, origin.y + cellSize * bounds.y);
+        }
+        dc.SetPen(outlinePen);
+        dc.SetBrush(*wxTRANSPARENT_BRUSH);
+        dc.DrawRectangle(0, 0, bounds.width * cellSize, bounds.height * cellSize);
+        dc.SetPen(pen);
+        dc.SetBrush(*wxBLACK_BRUSH);
+        for(int r = overlap.GetTop(); r <= overlap.GetBottom(); r ++) {
+            for(int c = overlap.GetLeft(); c <= overlap.GetRight(); c ++) {
+                const Item* item = grid.gridMap.find((static_cast<uint64_t>(r) << 32) | static_cast<uint32_t>(c));
+                if(item == nullptr || item->type == Item::ItemType::instance) continue;
+                dc.SetDeviceOrigin(origin.x + cellSize * c, origin.y + cellSize * r);
+                item->draw(dc, cellSize, dotSize, rotatedText, glyphs);
+            }
         }
     }
 }
 
+//Looks only at the tiles visible covers, and builds the tiles again first if instances have been placed or removed
+std::vector<std::pair<uint64_t, wxRect>> WindowGrid::instancesIn(const wxRect& visible) {
+    const GridIndex& index = grid.getIndex();
+    if(instanceTilesStamp != index.getInstanceStamp()) {
+        instanceBounds.clear();
+        instanceTiles.clear();
+        for(uint64_t key : index.getInstances()) {
+            auto [rows, cols] = grid.instanceSize(*grid.gridMap.find(key));
+            wxRect bounds{static_cast<int>(static_cast<uint32_t>(key)), static_cast<int>(key >> 32), static_cast<int>(cols), static_cast<int>(rows)};
+            if(bounds.IsEmpty()) continue;
+            auto position = static_cast<uint32_t>(instanceBounds.size());
+            instanceBounds.emplace_back(key, bounds);
+            for(int row = bounds.GetTop() / INSTANCE_TILE; row <= bounds.GetBottom() / INSTANCE_TILE; row ++) {
+                for(int col = bounds.GetLeft() / INSTANCE_TILE; col <= bounds.GetRight() / INSTANCE_TILE; col ++) {
+                    instanceTiles[(static_cast<uint64_t>(row) << 32) | static_cast<uint32_t>(col)].push_back(position);
+                }
+            }
+        }
+        instanceTilesStamp = index.getInstanceStamp();
+    }
+    std::vector<uint32_t> found{};
+    for(int row = visible.GetTop() / INSTANCE_TILE; row <= visible.GetBottom() / INSTANCE_TILE; row ++) {
+        for(int col = visible.GetLeft() / INSTANCE_TILE; col <= visible.GetRight() / INSTANCE_TILE; col ++) {
+            auto iterator = instanceTiles.find((static_cast<uint64_t>(row) << 32) | static_cast<uint32_t>(col));
+            if(iterator != instanceTiles.end()) found.insert(found.end(), iterator->second.begin(), iterator->second.end());
+        }
+    }
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    std::vector<std::pair<uint64_t, wxRect>> result{};
+    for(uint32_t position : found) {
+        if(instanceBounds[position].second.Intersects(visible)) result.push_back(instanceBounds[position]);
+    }
+    return result;
+}
+
+//Expands a sub-circuit once per rotation, for drawing instances too big to keep as a bitmap
+const std::vector<std::pair<uint64_t, Item>>& WindowGrid::instanceCells(const Item& instance) {
+    auto [iterator, inserted] = instanceCellCache.try_emplace({instance.extraData, instance.shape & 3});
+    if(inserted) {
+        iterator->second = grid.expandInstance(0, instance);
+        std::stable_sort(iterator->second.begin(), iterator->second.end(), [](const auto& a, const auto& b) {return a.first < b.first;});
+    }
+    return iterator->second;
+}
+
+//Sub-circuits were defined again or drawing settings changed, so nothing drawn or expanded from them before holds
+void WindowGrid::clearInstanceCaches() {
+    instanceBitmaps.clear();
+    instanceCellCache.clear();
+    instanceTilesStamp = ~0ull;
+}
+
+//Renders a sub-circuit once per zoom level and rotation, null if the bitmap would be too large to keep
+const wxBitmap* WindowGrid::instanceBitmap(const Item& instance, wxSize size, int cellSize) {
+    constexpr int64_t MAX_PIXELS = 1 << 24;
+    if(static_cast<int64_t>(size.x) * size.y * cellSize * cellSize > MAX_PIXELS) return nullptr;
+    auto [iterator, inserted] = instanceBitmaps.try_emplace({instance.extraData, instance.shape & 3});
+    if(!inserted) return &iterator->second;
+    wxBitmap& bitmap = iterator->second;
+    bitmap.Create(size.x * cellSize, size.y * cellSize);
+    wxMemoryDC memoryDC{bitmap};
+    memoryDC.SetBackground(wxBrush{GetBackgroundColour()});
+    memoryDC.Clear();
+    memoryDC.SetBrush(*wxBLACK_BRUSH);
+    memoryDC.SetPen(pen);
+    memoryDC.SetFont(font);
+    std::vector<bool> occupied(static_cast<size_t>(size.x) * size.y, false);
+    for(auto& [key, item] : grid.expandInstance(0, instance)) {
+        auto row = static_cast<int>(key >> 32);
+        auto col = static_cast<int>(static_cast<uint32_t>(key));
+        occupied[static_cast<size_t>(row) * size.x + col] = true;
+        memoryDC.SetDeviceOrigin(cellSize * col, cellSize * row);
+        item.draw(memoryDC, cellSize, dotSize, rotatedText, glyphs);
+    }
+    for(int row = 0; row < size.y; row ++) {
+        for(int col = 0; col < size.x; col ++) {
+            if(occupied[static_cast<size_t>(row) * size.x + col]) continue;
+            memoryDC.SetDeviceOrigin(cellSize * col, cellSize * row);
+            Item{}.draw(memoryDC, cellSize, dotSize, rotatedText, glyphs);
+        }
+    }
+    return &bitmap;
+}
+
+//Results are drawn in their own pass over the overlay's tiles, on top of the finished component layer
+void WindowGrid::drawOverlay(wxDC& dc, const Overlay& results, wxPoint origin, int cellSize, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    constexpr int numColours = 32;
+    wxPen voltagePens[numColours];
+    for(int i = 0; i < numColours; i ++) {
+        voltagePens[i] = wxPen{wxPenInfo(voltageColour(static_cast<double>(i) / (numColours - 1)), pen.GetWidth())};
+    }
+    wxColour currentColour{200, 0, 0};
+    wxPen currentPen{wxPenInfo(currentColour, std::max(pen.GetWidth() / 2, 1))};
+    dc.SetTextForeground(currentColour);
+    double minVoltage = results.getMinVoltage();
+    double range = results.getMaxVoltage() - minVoltage;
+    int middle = cellSize / 2;
+    int head = cellSize / 16;
+    constexpr uint32_t tileSize = Overlay::TILE_SIZE;
+    for(uint32_t tileRow = rowBegin / tileSize; tileRow <= (rowEnd - 1) / tileSize; tileRow ++) {
+        for(uint32_t tileCol = colBegin / tileSize; tileCol <= (colEnd - 1) / tileSize; tileCol ++) {
+            const Overlay::Cell* cells = results.tile(tileRow, tileCol);
+            if(cells == nullptr) continue;
+            int firstRow = std::max(rowBegin, static_cast<int>(tileRow * tileSize));
+            int lastRow = std::min(rowEnd, static_cast<int>((tileRow + 1) * tileSize));
+            int firstCol = std::max(colBegin, static_cast<int>(tileCol * tileSize));
+            int lastCol = std::min(colEnd, static_cast<int>((tileCol + 1) * tileSize));
+            for(int r = firstRow; r < lastRow; r ++) {
+                const Overlay::Cell* row = cells + (r - tileRow * tileSize) * tileSize;
+                for(int c = firstCol; c < lastCol; c ++) {
+                    const Overlay::Cell& cell = row[c - tileCol * tileSize];
+                    if(cell.kind == Overlay::Kind::empty) continue;
+                    dc.SetDeviceOrigin(origin.x + cellSize * c, origin.y + cellSize * r);
+                    if(cell.kind == Overlay::Kind::voltage) {
+                        int colour = range > 0 ? static_cast<int>((cell.value - minVoltage) / range * (numColours - 1) + 0.5) : 0;
+                        dc.SetPen(voltagePens[colour]);
+                        wxPoint centre{middle, middle};
+                        if(cell.shape & Item::UP) dc.DrawLine(wxPoint{middle, 0}, centre);
+                        if(cell.shape & Item::DOWN) dc.DrawLine(wxPoint{middle, cellSize}, centre);
+                        if(cell.shape & Item::LEFT) dc.DrawLine(wxPoint{0, middle}, centre);
+                        if(cell.shape & Item::RIGHT) dc.DrawLine(wxPoint{cellSize, middle}, centre);
+                    } else if(std::abs(cell.value) > 1e-15) {
+                        int direction = cell.value >= 0 ? cell.shape : flip(cell.shape);
+                        dc.SetPen(currentPen);
+                        std::wstring label = Item::formatValue(std::abs(cell.value), 'A');
+                        if(direction == Item::LEFT || direction == Item::RIGHT) { //arrow under the component, pointing the way current flows
+                            int y = cellSize * 13 / 16;
+                            int tip = direction == Item::RIGHT ? cellSize * 11 / 16 : cellSize * 5 / 16;
+                            int back = direction == Item::RIGHT ? -head : head;
+                            dc.DrawLine(cellSize * 5 / 16, y, cellSize * 11 / 16, y);
+                            dc.DrawLine(tip, y, tip + back, y - head);
+                            dc.DrawLine(tip, y, tip + back, y + head);
+                            dc.DrawLabel(label, wxRect{0, y + head, cellSize, 0}, wxALIGN_CENTER_HORIZONTAL | wxALIGN_TOP);
+                        } else { //arrow left of the component
+                            int x = cellSize * 3 / 16;
+                            int tip = direction == Item::DOWN ? cellSize * 11 / 16 : cellSize * 5 / 16;
+                            int back = direction == Item::DOWN ? -head : head;
+                            dc.DrawLine(x, cellSize * 5 / 16, x, cellSize * 11 / 16);
+                            dc.DrawLine(x, tip, x - head, tip + back);
+                            dc.DrawLine(x, tip, x + head, tip + back);
+                            dc.DrawLabel(label, wxRect{0, 0, x - head, cellSize}, wxALIGN_CENTER_VERTICAL | wxALIGN_RIGHT);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+//Outlines each cell in view that differs from the counterpart's, by the colour of how it differs
+void WindowGrid::drawDifferences(wxDC& dc, wxPoint origin, int cellSize, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    updateDifferences();
+    int width = std::max(pen.GetWidth() / 2, 1);
+    const wxPen pens[] {wxPen{wxPenInfo(wxColour{0, 160, 0}, width)}, wxPen{wxPenInfo(wxColour{220, 0, 0}, width)}, wxPen{wxPenInfo(wxColour{230, 140, 0}, width)}};
+    dc.SetDeviceOrigin(origin.x, origin.y);
+    dc.SetBrush(*wxTRANSPARENT_BRUSH);
+    for(int r = rowBegin; r < rowEnd; r ++) {
+        uint64_t first = (static_cast<uint64_t>(r) << 32) | static_cast<uint32_t>(colBegin);
+        uint64_t last = (static_cast<uint64_t>(r) << 32) | static_cast<uint32_t>(colEnd);
+        auto cell = std::lower_bound(differences.begin(), differences.end(), first, [](const auto& difference, uint64_t key) {return difference.first < key;});
+        for(; cell != differences.end() && cell->first < last; cell ++) {
+            dc.SetPen(pens[static_cast<int>(cell->second)]);
+            dc.DrawRectangle(static_cast<int>(static_cast<uint32_t>(cell->first)) * cellSize + width, r * cellSize + width, cellSize - 2 * width, cellSize - 2 * width);
+        }
+    }
+}
+
+//Finds the differences again if either grid has changed since. Digests give it away without looking at any cell, and
+//finding them only looks inside the tiles that differ.
+void WindowGrid::updateDifferences() {
+    std::pair<uint64_t, uint64_t> digests{grid.gridMap.digest(), counterpart->grid.gridMap.digest()};
+    if(digests == differencesOf) return;
+    differencesOf = digests;
+    differences.clear();
+    const GridVersion& from = older ? grid.gridMap : counterpart->grid.gridMap;
+    const GridVersion& to = older ? counterpart->grid.gridMap : grid.gridMap;
+    size_t counts[3]{};
+    from.diff(to, [this, &counts](uint64_t key, const Item* before, const Item* after) {
+        Difference difference = before == nullptr ? Difference::added : after == nullptr ? Difference::removed : Difference::changed;
+        counts[static_cast<int>(difference)] ++;
+        differences.emplace_back(key, difference);
+    });
+    std::sort(differences.begin(), differences.end(), [](const auto& a, const auto& b) {return a.first < b.first;});
+    wxLogStatus("%zu cells added, %zu removed and %zu changed", counts[0], counts[1], counts[2]);
+    counterpart->repaint(); //its outlines are out of date too
+}
+
 WindowGrid::WindowGrid(wxWindow *parent, wxWindowID id, const wxPoint &pos, const wxSize &size, const LoadStruct& load)
         : wxScrolledCanvas(parent, id, pos, size), grid{load.grid}, zoomLevels{load.zoom}, dotSize{load.dotSize}, rotatedText{load.rotatedText}, shadedBackground{load.shadedBackground} {
     Bind(wxEVT_MOUSEWHEEL, &WindowGrid::onScroll, this);
     Bind(wxEVT_LEFT_DOWN, &WindowGrid::onLeftDown, this);
     Bind(wxEVT_MOTION, &WindowGrid::onMotion, this);
     Bind(wxEVT_RIGHT_DOWN, &WindowGrid::onRightDown, this);
+    Bind(wxEVT_LEFT_UP, &WindowGrid::onLeftUp, this);
+    Bind(wxEVT_SCROLLWIN_LINEUP, &WindowGrid::onScrollLine, this);
+    Bind(wxEVT_SCROLLWIN_LINEDOWN, &WindowGrid::onScrollLine, this);
+    SetBackgroundStyle(wxBG_STYLE_PAINT); //every pixel comes from the backing store
 
     twoWayMenu.Append(id::set_value, "Set value");
     twoWayMenu.Append(id::rotate, "Rotate");
@@ -55,44 +644,29 @@ WindowGrid::WindowGrid(wxWindow *parent, wxWindowID id, const wxPoint &pos, cons
     switchMenu.Append(id::set_value, "Set label");
     switchMenu.Append(id::rotate, "Rotate");
     switchMenu.Append(id::toggle_closed, "Toggle closed");
+    instanceMenu.Append(id::rotate_cw, "Rotate CW");
+    instanceMenu.Append(id::rotate_ccw, "Rotate CCW");
 
-    refreshAll(load.xScroll, load.yScroll);
+    refreshAll(load.xScroll * FILE_SCROLL_UNIT, load.yScroll * FILE_SCROLL_UNIT);
 }
 
 void WindowGrid::refreshAll(int xPos, int yPos) {
+    profiler::Scope scope{"refreshAll"};
     if(xPos != -1 && yPos != -1) {
-        wxScrolledCanvas::SetScrollbars(16, 16, static_cast<int>(grid.getWidth()) * (8 + zoomLevels), static_cast<int>(grid.getHeight()) * (8 + zoomLevels),xPos, yPos);
+        //A scroll unit is a pixel, so panning moves smoothly
+        int cellSize = 128 + 16 * zoomLevels;
+        wxScrolledCanvas::SetScrollbars(1, 1, static_cast<int>(grid.getWidth()) * cellSize, static_cast<int>(grid.getHeight()) * cellSize, xPos, yPos);
     }
     font = wxSystemSettings::GetFont(wxSYS_DEFAULT_GUI_FONT);
     font.SetPixelSize(wxSize{0, 16 + 2 * zoomLevels});
     pen = wxPen{wxPenInfo(*wxBLACK, std::ceil(22.0 / 1024 * (128 + 16 * zoomLevels)))};
     int size = 128 + zoomLevels * 16;
-    resistorBitmaps[0] = resources::getResistorBitmap(size, false);
-    resistorBitmaps[1] = resources::getResistorBitmap(size, true);
-    voltSourceBitmaps[0] = resources::getVoltSourceBitmap(size, Item::UP, false);
-    voltSourceBitmaps[1] = resources::getVoltSourceBitmap(size, Item::DOWN, false);
-    voltSourceBitmaps[2] = resources::getVoltSourceBitmap(size, Item::RIGHT, false);
-    voltSourceBitmaps[3] = resources::getVoltSourceBitmap(size, Item::LEFT, false);
-    voltSourceBitmaps[4] = resources::getVoltSourceBitmap(size, Item::UP | Item::DEPENDENT, false);
-    voltSourceBitmaps[5] = resources::getVoltSourceBitmap(size, Item::DOWN | Item::DEPENDENT, false);
-    voltSourceBitmaps[6] = resources::getVoltSourceBitmap(size, Item::RIGHT | Item::DEPENDENT, false);
-    voltSourceBitmaps[7] = resources::getVoltSourceBitmap(size, Item::LEFT | Item::DEPENDENT, false);
-    ampSourceBitmaps[0] = resources::getAmpSourceBitmap(size, Item::UP, false);
-    ampSourceBitmaps[1] = resources::getAmpSourceBitmap(size, Item::DOWN, false);
-    ampSourceBitmaps[2] = resources::getAmpSourceBitmap(size, Item::RIGHT, false);
-    ampSourceBitmaps[3] = resources::getAmpSourceBitmap(size, Item::LEFT, false);
-    ampSourceBitmaps[4] = resources::getAmpSourceBitmap(size, Item::UP | Item::DEPENDENT, false);
-    ampSourceBitmaps[5] = resources::getAmpSourceBitmap(size, Item::DOWN | Item::DEPENDENT, false);
-    ampSourceBitmaps[6] = resources::getAmpSourceBitmap(size, Item::RIGHT | Item::DEPENDENT, false);
-    ampSourceBitmaps[7] = resources::getAmpSourceBitmap(size, Item::LEFT | Item::DEPENDENT, false);
-    capacitorBitmaps[0] = resources::getCapacitorBitmap(size, false);
-    capacitorBitmaps[1] = resources::getCapacitorBitmap(size, true);
-    switchBitmaps[0] = resources::getSwitchBitmap(size, false, false);
-    switchBitmaps[1] = resources::getSwitchBitmap(size, true, false);
-    switchBitmaps[2] = resources::getSwitchBitmap(size, false, true);
-    switchBitmaps[3] = resources::getSwitchBitmap(size, true, true);
+    glyphs = resources::Glyphs{size}; //drawn as items of each kind come into view
+    glyphSprites.clear(); //keyed by the bitmaps just replaced
+    clearInstanceCaches();
     SetBackgroundColour(wxTheColourDatabase->Find(shadedBackground ? "LIGHT GREY" : "WHITE"));
     Refresh();
+    if(xPos != -1 && yPos != -1) viewMoved();
 }
 
 void WindowGrid::reload(const WindowGrid::LoadStruct& load) {
@@ -102,7 +676,11 @@ void WindowGrid::reload(const WindowGrid::LoadStruct& load) {
     rotatedText = load.rotatedText;
     shadedBackground = load.shadedBackground;
     dirty = false;
-    refreshAll(load.xScroll, load.yScroll);
+    simulation.reset();
+    overlay.reset();
+    if(live) live->reset(grid);
+    selection = wxRect{};
+    refreshAll(load.xScroll * FILE_SCROLL_UNIT, load.yScroll * FILE_SCROLL_UNIT);
 }
 
 
@@ -115,8 +693,6 @@ void WindowGrid::onScroll(wxMouseEvent &event) {
             int mouseX, mouseY, scrollX, scrollY;
             event.GetPosition(&mouseX, &mouseY);
             GetViewStart(&scrollX, &scrollY);
-            scrollX *= 16; //scroll is in scroll units, not pixels
-            scrollY *= 16;
             //Fractional location of the mouse in the grid
             double mouseXFraction = static_cast<double>(mouseX + scrollX) / (grid.getWidth() * (8 + zoomLevels)) / 16;
             double mouseYFraction = static_cast<double>(mouseY + scrollY) / (grid.getHeight() * (8 + zoomLevels)) / 16;
@@ -133,7 +709,7 @@ void WindowGrid::onScroll(wxMouseEvent &event) {
                 double mouseYLogical = (grid.getHeight() * (8 + zoomLevels)) * 16 * mouseYFraction;
                 int newScrollX = static_cast<int>(std::max(mouseXLogical - mouseX, 0.0));
                 int newScrollY = static_cast<int>(std::max(mouseYLogical - mouseY, 0.0));
-                refreshAll(newScrollX / 16, newScrollY / 16);
+                refreshAll(newScrollX, newScrollY);
             }
         }
     } else {
@@ -141,6 +717,18 @@ void WindowGrid::onScroll(wxMouseEvent &event) {
     }
 }
 
+//Scroll units are pixels so panning is smooth, but a line still moves as far as a unit used to
+void WindowGrid::onScrollLine(wxScrollWinEvent& event) {
+    int step = event.GetEventType() == wxEVT_SCROLLWIN_LINEUP ? -LINE_PIXELS : LINE_PIXELS;
+    wxPoint start = GetViewStart();
+    if(event.GetOrientation() == wxHORIZONTAL) {
+        start.x += step;
+    } else {
+        start.y += step;
+    }
+    Scroll(start);
+}
+
 void WindowGrid::onMotion(wxMouseEvent &event) {
     static wxPoint lastMousePos{-1, -1};
     static wxPoint lastScrolledMousePos{0, 0};
@@ -154,19 +742,22 @@ void WindowGrid::onMotion(wxMouseEvent &event) {
     if (cell != currentCell) {
         lastCell = currentCell;
         currentCell = cell;
-        if (event.LeftIsDown() && currentCell != wxPoint{-1,-1}) {
+        updateProbe();
+        if (selecting || moving) {
+            if (!event.LeftIsDown()) {
+                finishDrag(); //the button was released outside the window
+            } else if (currentCell != wxPoint{-1,-1}) {
+                if (selecting) {
+                    selection = wxRect{wxPoint{std::min(dragStart.x, currentCell.x), std::min(dragStart.y, currentCell.y)},
+                                       wxPoint{std::max(dragStart.x, currentCell.x), std::max(dragStart.y, currentCell.y)}};
+                }
+                repaint();
+            }
+        } else if (event.LeftIsDown() && currentCell != wxPoint{-1,-1} && !readOnly) {
             switch(selectedTool) {
                 case Item::ItemType::none:
                     placePartial(currentCell, Item{});
                     break;
-                case Item::ItemType::resistor: case Item::ItemType::capacitor: case Item::ItemType::toggle: {
-                    int shape = Item::VERTICAL;
-                    if (lastCell.x != currentCell.x) {
-                        shape = Item::HORIZONTAL;
-                    }
-                    placePartial(currentCell, Item{selectedTool, shape, Item::defaultValue(selectedTool)});
-                    break;
-                }
                 case Item::ItemType::wire: {
                     int shape = getDirection(lastCell, currentCell);
                     placePartial(currentCell, Item{Item::ItemType::wire, shape, 0});
@@ -175,30 +766,21 @@ void WindowGrid::onMotion(wxMouseEvent &event) {
                     }
                     break;
                 }
-                case Item::ItemType::volt_source: case Item::ItemType::amp_source:
-                    placePartial(currentCell, Item{selectedTool, getDirection(currentCell, lastCell), Item::defaultValue(selectedTool)});
+                default:
+                    if(const components::Component* part = components::find(selectedTool)) {
+                        placePartial(currentCell, Item{selectedTool, part->placed(getDirection(currentCell, lastCell)), part->value});
+                    }
                     break;
             }
         }
     }
     if (event.MiddleIsDown()) {
         wxPoint diff = lastScrolledMousePos - mousePos;
-        wxPoint scrollCurrent = GetViewStart();
-        wxPoint scrollChange{0, 0};
-        if (diff.x >= 16 || diff.x <= -16) {
-            scrollChange.x = diff.x / 16;
-            lastScrolledMousePos.x = mousePos.x;
-        }
-        if (diff.y >= 16 || diff.y <= -16) {
-            scrollChange.y = diff.y / 16;
-            lastScrolledMousePos.y = mousePos.y;
+        if (diff != wxPoint{0, 0}) {
+            Scroll(GetViewStart() + diff);
         }
-        if (scrollChange != wxPoint{0, 0}) {
-            Scroll(scrollCurrent + scrollChange);
-        }
-    } else {
-        lastScrolledMousePos = mousePos;
     }
+    lastScrolledMousePos = mousePos;
     lastMousePos = mousePos;
     event.Skip();
 }
@@ -209,8 +791,12 @@ void WindowGrid::placePartial(wxPoint cell, const Item& item) {
     Item currentItem = grid.get(cell.y, cell.x);
     switch (item.type) {
         case Item::ItemType::none: {
-            if (currentItem.type != Item::ItemType::none) {
+            if (currentItem.type == Item::ItemType::instance) { //erasing an instance clears its whole area
+                grid.set(cell.y, cell.x, item);
+                blockChanged();
+            } else if (currentItem.type != Item::ItemType::none) {
                 grid.set(cell.y, cell.x, item);
+                cellChanged(cell, item);
                 dirty = true;
                 RefreshRect(affectedRect);
             }
@@ -219,26 +805,31 @@ void WindowGrid::placePartial(wxPoint cell, const Item& item) {
         case Item::ItemType::wire: {
             if (currentItem.type == Item::ItemType::none) {
                 grid.set(cell.y, cell.x, item);
+                cellChanged(cell, item);
                 dirty = true;
                 RefreshRect(affectedRect);
             } else if (currentItem.type == Item::ItemType::wire && !(currentItem.shape & item.shape)) {
                 currentItem.shape |= item.shape;
                 grid.set(cell.y, cell.x, currentItem);
+                cellChanged(cell, currentItem);
                 dirty = true;
                 RefreshRect(affectedRect);
             }
             break;
         }
-        case Item::ItemType::resistor: case Item::ItemType::volt_source: case Item::ItemType::amp_source: case Item::ItemType::capacitor: case Item::ItemType::toggle: {
+        default: {
+            if (components::find(item.type) == nullptr) break;
             if (currentItem.type == item.type) {
                 if (currentItem.shape != item.shape) {
                     currentItem.shape = item.shape;
                     grid.set(cell.y, cell.x, currentItem);
+                    cellChanged(cell, currentItem);
                     dirty = true;
                     RefreshRect(affectedRect);
                 }
             } else if (currentItem.type == Item::ItemType::none || currentItem.type == Item::ItemType::wire) {
                 grid.set(cell.y, cell.x, item);
+                cellChanged(cell, item);
                 dirty = true;
                 RefreshRect(affectedRect);
             }
@@ -248,50 +839,298 @@ void WindowGrid::placePartial(wxPoint cell, const Item& item) {
 }
 
 void WindowGrid::onLeftDown(wxMouseEvent &event) {
+    if (readOnly) {
+        event.Skip();
+        return;
+    }
+    if (currentCell != wxPoint{-1, -1} && (event.ShiftDown() || selection.Contains(currentCell))) {
+        //Shift starts a new selection, pressing inside the current one drags it
+        selecting = event.ShiftDown();
+        moving = !selecting;
+        dragStart = currentCell;
+        if (selecting) {
+            selection = wxRect{currentCell, wxSize{1, 1}};
+        }
+        repaint();
+        event.Skip();
+        return;
+    }
+    if (!selection.IsEmpty()) {
+        clearSelection();
+    }
     if (currentCell != wxPoint{-1, -1}) {
         switch (selectedTool) {
             case Item::ItemType::none:
                 placePartial(currentCell, Item{});
                 break;
-            case Item::ItemType::resistor: case Item::ItemType::capacitor: case Item::ItemType::toggle: {
-                int shape = Item::VERTICAL;
-                if (lastCell.x != currentCell.x) {
-                    shape = Item::HORIZONTAL;
-                }
-                placePartial(currentCell, Item{selectedTool, shape, Item::defaultValue(selectedTool)});
-                break;
-            }
             case Item::ItemType::wire:
                 placePartial(currentCell, Item{Item::ItemType::wire, getDirection(lastCell, currentCell), 0});
                 break;
-            case Item::ItemType::volt_source: case Item::ItemType::amp_source:
-                placePartial(currentCell, Item{selectedTool, getDirection(currentCell, lastCell), Item::defaultValue(selectedTool)});
+            default:
+                if(const components::Component* part = components::find(selectedTool)) {
+                    placePartial(currentCell, Item{selectedTool, part->placed(getDirection(currentCell, lastCell)), part->value});
+                }
                 break;
         }
     }
     event.Skip();
 }
 
+void WindowGrid::onLeftUp(wxMouseEvent& event) {
+    finishDrag();
+    event.Skip();
+}
+
+void WindowGrid::finishDrag() {
+    if (moving && currentCell != wxPoint{-1, -1} && currentCell != dragStart) {
+        moving = false;
+        moveSelection(currentCell - dragStart);
+    } else if (moving || selecting) {
+        repaint();
+    }
+    selecting = false;
+    moving = false;
+}
+
+void WindowGrid::clearSelection() {
+    if (!selection.IsEmpty()) {
+        selection = wxRect{};
+        repaint();
+    }
+}
+
+void WindowGrid::copySelection() {
+    if (!selection.IsEmpty()) {
+        clipboard = grid.copy(selection.y, selection.x, selection.height, selection.width);
+    }
+}
+
+void WindowGrid::cutSelection() {
+    copySelection();
+    deleteSelection();
+}
+
+void WindowGrid::deleteSelection() {
+    if (selection.IsEmpty()) return;
+    Block block = grid.copy(selection.y, selection.x, selection.height, selection.width);
+    std::vector<std::pair<uint64_t, Item>> changes{};
+    changes.reserve(block.cells.size());
+    uint64_t offset = (static_cast<uint64_t>(selection.y) << 32) | static_cast<uint32_t>(selection.x);
+    for (const auto& cell : block.cells) {
+        changes.emplace_back(cell.first + offset, Item{});
+    }
+    grid.apply(std::move(changes));
+    blockChanged();
+}
+
+void WindowGrid::paste() {
+    if (clipboard.cells.empty()) return;
+    wxPoint corner = currentCell;
+    if (corner == wxPoint{-1, -1}) {
+        if (selection.IsEmpty()) return;
+        corner = selection.GetTopLeft();
+    }
+    std::vector<std::pair<uint64_t, Item>> changes{};
+    changes.reserve(clipboard.cells.size());
+    for (const auto& [key, item] : clipboard.cells) {
+        uint64_t row = (key >> 32) + corner.y;
+        uint64_t col = static_cast<uint32_t>(key) + corner.x;
+        if (row < grid.getHeight() && col < grid.getWidth()) {
+            changes.emplace_back((row << 32) | col, item);
+        }
+    }
+    grid.apply(std::move(changes));
+    selection = wxRect{corner, wxSize{static_cast<int>(clipboard.width), static_cast<int>(clipboard.height)}};
+    selection.Intersect(wxRect{0, 0, static_cast<int>(grid.getWidth()), static_cast<int>(grid.getHeight())});
+    blockChanged();
+}
+
+//Clears the selected cells and places them again offset by (x, y) cells, as a single undo step
+void WindowGrid::moveSelection(wxPoint offset) {
+    wxRect bounds{0, 0, static_cast<int>(grid.getWidth()), static_cast<int>(grid.getHeight())};
+    Block block = grid.copy(selection.y, selection.x, selection.height, selection.width);
+    std::vector<std::pair<uint64_t, Item>> changes{};
+    changes.reserve(2 * block.cells.size());
+    uint64_t from = (static_cast<uint64_t>(selection.y) << 32) | static_cast<uint32_t>(selection.x);
+    for (const auto& cell : block.cells) {
+        changes.emplace_back(cell.first + from, Item{});
+    }
+    selection.Offset(offset);
+    for (const auto& [key, item] : block.cells) {
+        wxPoint to{static_cast<int>(static_cast<uint32_t>(key)) + selection.x, static_cast<int>(key >> 32) + selection.y};
+        if (bounds.Contains(to)) {
+            changes.emplace_back((static_cast<uint64_t>(to.y) << 32) | static_cast<uint32_t>(to.x), item);
+        }
+    }
+    selection.Intersect(bounds);
+    grid.apply(std::move(changes));
+    blockChanged();
+}
+
+const Grid& WindowGrid::getGrid() const {
+    return grid;
+}
+
+void WindowGrid::showCell(uint32_t row, uint32_t col) {
+    int cellSize = 128 + 16 * zoomLevels;
+    wxSize client = GetClientSize();
+    int x = std::max(static_cast<int>(col) * cellSize + (cellSize - client.x) / 2, 0);
+    int y = std::max(static_cast<int>(row) * cellSize + (cellSize - client.y) / 2, 0);
+    Scroll(x, y);
+    selection = wxRect{static_cast<int>(col), static_cast<int>(row), 1, 1};
+    repaint();
+}
+
+void WindowGrid::makeSubCircuit() {
+    if (selection.IsEmpty()) {
+        wxLogStatus("Select a block to make a sub-circuit from first");
+        return;
+    }
+    wxTextEntryDialog dialog{this, "Name:", "Make Sub-circuit"};
+    if (dialog.ShowModal() != wxID_OK || dialog.GetValue().IsEmpty()) return;
+    std::wstring name = dialog.GetValue().ToStdWstring();
+    if (grid.subCircuits.count(name) != 0 &&
+        wxMessageDialog{this, "Replace the existing sub-circuit? Every instance of it will change.", "Sub-circuit exists", wxYES_NO | wxICON_QUESTION}.ShowModal() != wxID_YES) {
+        return;
+    }
+    Block block = grid.copy(selection.y, selection.x, selection.height, selection.width);
+    std::vector<std::pair<uint64_t, Item>> changes{};
+    changes.reserve(block.cells.size() + 1);
+    uint64_t corner = (static_cast<uint64_t>(selection.y) << 32) | static_cast<uint32_t>(selection.x);
+    for (const auto& cell : block.cells) {
+        changes.emplace_back(cell.first + corner, Item{});
+    }
+    changes.emplace_back(corner, Item{Item::ItemType::instance, 0, 0, name});
+    grid.subCircuits[name] = std::make_shared<const SubCircuit>(SubCircuit{name, std::move(block)});
+    clearInstanceCaches();
+    grid.apply(std::move(changes));
+    blockChanged();
+}
+
+//Places an instance at the cell under the mouse, otherwise at the selection, otherwise at the top left of the view
+void WindowGrid::placeSubCircuit() {
+    if (grid.subCircuits.empty()) {
+        wxLogStatus("No sub-circuits defined, make one from a selection first");
+        return;
+    }
+    wxPoint corner = currentCell;
+    if (corner == wxPoint{-1, -1}) {
+        corner = selection.IsEmpty() ? CalcUnscrolledPosition(wxPoint{0, 0}) / (128 + 16 * zoomLevels) : selection.GetTopLeft();
+    }
+    wxArrayString names{};
+    for (const auto& pair : grid.subCircuits) {
+        names.Add(pair.first);
+    }
+    wxSingleChoiceDialog dialog{this, "Sub-circuit:", "Place Sub-circuit", names};
+    if (dialog.ShowModal() != wxID_OK) return;
+    grid.set(corner.y, corner.x, Item{Item::ItemType::instance, 0, 0, dialog.GetStringSelection().ToStdWstring()});
+    blockChanged();
+}
+
+void WindowGrid::exportImage(std::ostream& ostream, bool svg, int cellSize) const {
+    ImageExport image{grid, ImageExport::Options{cellSize, dotSize, rotatedText, shadedBackground}};
+    if (svg) {
+        image.writeSvg(ostream);
+    } else {
+        ThreadPool pool{};
+        image.writePng(ostream, pool);
+    }
+}
+
+void WindowGrid::toggleProfiling() {
+    profiler::setEnabled(!profiler::enabled());
+    averageFrameTime = 0;
+    repaint();
+}
+
+void WindowGrid::setView(int zoom, wxPoint viewStart) {
+    zoomLevels = zoom;
+    refreshAll(viewStart.x, viewStart.y);
+}
+
+void WindowGrid::compare(WindowGrid* other, bool older) {
+    counterpart = other;
+    this->older = older;
+    differences.clear();
+    differencesOf = {};
+    repaint();
+}
+
+//Brings the counterpart to this view, unless this is being brought to the counterpart's
+void WindowGrid::viewMoved() {
+    if(counterpart == nullptr || counterpart->following) return;
+    following = true;
+    if(counterpart->zoomLevels == zoomLevels) {
+        counterpart->Scroll(GetViewStart());
+    } else {
+        counterpart->setView(zoomLevels, GetViewStart());
+    }
+    following = false;
+}
+
+memory::Report WindowGrid::memoryUsage() const {
+    memory::Report report = grid.memoryUsage();
+    report.clipboard = clipboard.cells.capacity() * sizeof(clipboard.cells[0]);
+    //The glyphs share their pixels with the caches
+    report.bitmaps = resources::cachedBytes();
+    for(const auto& [key, bitmap] : instanceBitmaps) {
+        report.bitmaps += resources::bitmapBytes(bitmap);
+    }
+    report.bitmaps += compositor.memoryUsage() + resources::bitmapBytes(frame) + resources::bitmapBytes(backing) + resources::bitmapBytes(backingSpare);
+    for(const auto& [bitmap, sprite] : glyphSprites) {
+        report.bitmaps += sprite.pixels.capacity() * sizeof(uint32_t);
+    }
+    return report;
+}
+
+//Tiles the grid with copies of the selection, the selection grows to cover them
+void WindowGrid::replicateSelection() {
+    if (selection.IsEmpty()) {
+        wxLogStatus("Select a block to replicate first");
+        return;
+    }
+    ReplicateDialog dialog{this, selection.GetSize()};
+    if (dialog.ShowModal() != wxID_OK) return;
+    ReplicateDialog::Value value = dialog.getValue();
+    if (value.copies == wxSize{0, 0}) return;
+    auto start = std::chrono::steady_clock::now();
+    Block block = grid.copy(selection.y, selection.x, selection.height, selection.width);
+    grid.replicate(block, selection.y, selection.x, value.copies.y, value.copies.x, value.stride.y, value.stride.x);
+    //The copies can reach far past the grid, so the selection is clipped to it before it can overflow
+    auto extent = [](int copies, int stride, int size, int space) {
+        return static_cast<int>(std::min<int64_t>((copies - 1) * static_cast<int64_t>(stride) + size, space));
+    };
+    selection.SetSize(wxSize{extent(value.copies.x, value.stride.x, selection.width, static_cast<int>(grid.getWidth()) - selection.x),
+                             extent(value.copies.y, value.stride.y, selection.height, static_cast<int>(grid.getHeight()) - selection.y)});
+    blockChanged();
+    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    wxLogStatus("Placed %llu copies in %.1f ms", static_cast<unsigned long long>(value.copies.x) * value.copies.y - 1, time.count());
+}
+
+//Edits to whole blocks are too many for incremental simulation updates, so results are recomputed from scratch
+void WindowGrid::blockChanged() {
+    dirty = true;
+    gridReplaced();
+    Refresh();
+}
+
 void WindowGrid::onRightDown(wxMouseEvent &event) {
+    if (readOnly) return;
     Item currentItem = grid.get(currentCell.y, currentCell.x);
     int cellSize = 128 + 16 * zoomLevels;
     wxRect affectedRect{CalcScrolledPosition(cellSize * currentCell) - wxPoint{5,5}, wxSize{cellSize + 10, cellSize + 10}};
     wxMenu* menu;
-    switch(currentItem.type) {
-        case Item::ItemType::none:
-            return;
-        case Item::ItemType::resistor: case Item::ItemType::capacitor:
-            menu = &twoWayMenu;
-            break;
-        case Item::ItemType::wire:
-            menu = &wireMenu;
-            break;
-        case Item::ItemType::volt_source: case Item::ItemType::amp_source:
-            menu = &fourWayMenu;
-            break;
-        case Item::ItemType::toggle:
-            menu = &switchMenu;
-            break;
+    const components::Component* part = components::find(currentItem.type);
+    if(currentItem.type == Item::ItemType::wire) {
+        menu = &wireMenu;
+    } else if(currentItem.type == Item::ItemType::instance) {
+        menu = &instanceMenu;
+    } else if(part == nullptr) {
+        return;
+    } else if(part->terminals == components::Terminals::four_way) {
+        menu = &fourWayMenu;
+    } else {
+        menu = part->model == Item::ItemType::toggle ? &switchMenu : &twoWayMenu;
     }
     int shape = currentItem.shape;
     Item directItem{};
@@ -321,10 +1160,18 @@ void WindowGrid::onRightDown(wxMouseEvent &event) {
             shape ^= Item::CLOSED;
             break;
         case id::rotate_cw:
-            shape = (shape & Item::DEPENDENT) | rotateCW(shape & (Item::UP | Item::RIGHT | Item::DOWN | Item::LEFT));
+            if(currentItem.type == Item::ItemType::instance) {
+                shape = currentItem.rotated(1).shape;
+            } else {
+                shape = (shape & Item::DEPENDENT) | rotateCW(shape & (Item::UP | Item::RIGHT | Item::DOWN | Item::LEFT));
+            }
             break;
         case id::rotate_ccw:
-            shape = (shape & Item::DEPENDENT) | rotateCCW(shape & (Item::UP | Item::RIGHT | Item::DOWN | Item::LEFT));
+            if(currentItem.type == Item::ItemType::instance) {
+                shape = currentItem.rotated(3).shape;
+            } else {
+                shape = (shape & Item::DEPENDENT) | rotateCCW(shape & (Item::UP | Item::RIGHT | Item::DOWN | Item::LEFT));
+            }
             break;
         case id::flip:
             shape = (shape & Item::DEPENDENT) | flip(shape & (Item::UP | Item::RIGHT | Item::DOWN | Item::LEFT));
@@ -334,52 +1181,161 @@ void WindowGrid::onRightDown(wxMouseEvent &event) {
         directItem = currentItem;
         directItem.shape = shape;
     }
-    if(directItem.type != Item::ItemType::none) {
+    if(directItem.type == Item::ItemType::instance) { //covers more than its own cell
+        grid.set(currentCell.y, currentCell.x, directItem);
+        blockChanged();
+    } else if(directItem.type != Item::ItemType::none) {
         grid.set(currentCell.y, currentCell.x, directItem);
+        cellChanged(currentCell, directItem);
         dirty = true;
         RefreshRect(affectedRect);
     }
 }
 
 void WindowGrid::save(std::ofstream& ofstream) {
-    ofstream.write("schematic", 10);
     int xScroll, yScroll;
     GetViewStart(&xScroll, &yScroll);
-    uint32_t toWrite[] = {static_cast<uint32_t>(zoomLevels), static_cast<uint32_t>(xScroll), static_cast<uint32_t>(yScroll), static_cast<uint32_t>(dotSize), grid.getWidth(), grid.getHeight()};
+    save(ofstream, grid, zoomLevels, xScroll / FILE_SCROLL_UNIT, yScroll / FILE_SCROLL_UNIT, dotSize, rotatedText, shadedBackground);
+    dirty = false;
+}
+
+void WindowGrid::save(std::ofstream& ofstream, const Grid& grid, int zoom, int xScroll, int yScroll, int dotSize, bool rotatedText, bool shadedBackground) {
+    profiler::Scope scope{"save"};
+    ofstream.write("schematic", 10);
+    uint32_t toWrite[] = {static_cast<uint32_t>(zoom), static_cast<uint32_t>(xScroll), static_cast<uint32_t>(yScroll), static_cast<uint32_t>(dotSize), grid.getWidth(), grid.getHeight()};
     ofstream.write(reinterpret_cast<const char*>(toWrite), sizeof(toWrite));
     uint8_t boolOptions = 0; //doing it this way to make it easier to add more bool options in the future without breaking the file format again
     if(rotatedText) boolOptions |= 1;
     if(shadedBackground) boolOptions |= 2;
     ofstream.write(reinterpret_cast<const char *>(&boolOptions), sizeof(uint8_t));
-    size_t numElements = grid.gridMap.size();
+    size_t numElements = grid.gridMap.size() - grid.gridMap.runCells();
     ofstream.write(reinterpret_cast<const char*>(&numElements), sizeof(size_t));
-    for(auto pair : grid.gridMap) {
+    for(const auto& pair : grid.gridMap) {
+        if(GridVersion::inRuns(pair.second)) continue;
         ofstream.write(reinterpret_cast<const char *>(&pair.first), sizeof(uint64_t));
         pair.second.save(ofstream);
     }
-    dirty = false;
+    //Sub-circuits follow the cells, files from before they existed just end here
+    size_t numSubCircuits = grid.subCircuits.size();
+    ofstream.write(reinterpret_cast<const char*>(&numSubCircuits), sizeof(size_t));
+    for(const auto& [name, subCircuit] : grid.subCircuits) {
+        size_t nameSize = name.size();
+        ofstream.write(reinterpret_cast<const char*>(&nameSize), sizeof(size_t));
+        ofstream.write(reinterpret_cast<const char*>(name.data()), nameSize * sizeof(wchar_t));
+        uint32_t blockSize[] = {subCircuit->block.width, subCircuit->block.height};
+        ofstream.write(reinterpret_cast<const char*>(blockSize), sizeof(blockSize));
+        size_t numCells = subCircuit->block.cells.size();
+        ofstream.write(reinterpret_cast<const char*>(&numCells), sizeof(size_t));
+        for(auto pair : subCircuit->block.cells) {
+            ofstream.write(reinterpret_cast<const char *>(&pair.first), sizeof(uint64_t));
+            pair.second.save(ofstream);
+        }
+    }
+    //Then plain wires as the runs along each row and then each column, files from before they existed end here
+    for(const GridVersion::Lines* lines : {&grid.gridMap.rowRuns(), &grid.gridMap.columnRuns()}) {
+        size_t numLines = lines->size();
+        ofstream.write(reinterpret_cast<const char*>(&numLines), sizeof(size_t));
+        for(const auto& [at, runs] : *lines) {
+            size_t numRuns = runs->size();
+            ofstream.write(reinterpret_cast<const char*>(&at), sizeof(uint32_t));
+            ofstream.write(reinterpret_cast<const char*>(&numRuns), sizeof(size_t));
+            for(auto [first, second] : *runs) {
+                uint32_t run[] = {first, second};
+                ofstream.write(reinterpret_cast<const char*>(run), sizeof(run));
+            }
+        }
+    }
 }
 
-WindowGrid::LoadStruct WindowGrid::load(std::ifstream& ifstream) {
+//Callers catch std::runtime_error alone, so anything else reading throws, on this thread or the pool's, becomes one
+WindowGrid::LoadStruct WindowGrid::load(std::ifstream& ifstream, unsigned threads) {
+    profiler::Scope scope{"load"};
+    try {
+        return readFile(ifstream, threads);
+    } catch(std::runtime_error&) {
+        throw;
+    } catch(std::bad_alloc&) {
+        throw std::runtime_error{"File too large to load"};
+    } catch(std::exception& e) { //such as Item::Value's std::length_error once the value table is full
+        throw std::runtime_error{e.what()};
+    }
+}
+
+//The file is read into memory first, where finding where each item starts takes only its label's length. The items
+//are then read a chunk at a time on every thread, each chunk straight into its own part of cells, and the tiles are
+//made from them on every thread too.
+WindowGrid::LoadStruct WindowGrid::readFile(std::ifstream& ifstream, unsigned threads) {
+    Reader reader = readRest(ifstream);
     char str[10];
-    ifstream.read(str, 10);
-    if(std::string{str} != "schematic") {
+    for(char& c : str) {
+        c = reader.read<char>();
+    }
+    if(std::string{str, 9} != "schematic" || str[9] != 0) {
         throw std::runtime_error{"File invalid"};
     }
     uint32_t readArr[6];
-    ifstream.read(reinterpret_cast<char *>(readArr), sizeof(readArr));
-    uint8_t boolOptions;
-    ifstream.read(reinterpret_cast<char *>(&boolOptions), sizeof(uint8_t));
-    size_t numElements;
-    ifstream.read(reinterpret_cast<char *>(&numElements), sizeof(size_t));
-    std::unordered_map<uint64_t, Item> gridMap{numElements};
-    for (size_t i = 0; i < numElements; i++) {
-        std::pair<uint64_t, Item> pair{};
-        ifstream.read(reinterpret_cast<char *>(&pair.first), sizeof(uint64_t));
-        pair.second = Item{ifstream};
-        gridMap.insert(pair);
-    }
-    Grid grid{readArr[4], readArr[5], gridMap};
+    for(uint32_t& value : readArr) {
+        value = reader.read<uint32_t>();
+    }
+    auto boolOptions = reader.read<uint8_t>();
+    auto numElements = reader.read<size_t>();
+    constexpr size_t CHUNK = 16384; //items read by one task
+    std::vector<const char*> chunks{};
+    for(size_t i = 0; i < numElements; i++) {
+        if(i % CHUNK == 0) chunks.push_back(reader.at);
+        size_t size = static_cast<size_t>(reader.end - reader.at) < sizeof(uint64_t) ? 0 : Item::savedSize(reader.at + sizeof(uint64_t), reader.end);
+        if(size == 0) {
+            throw std::runtime_error{"File invalid"};
+        }
+        reader.at += sizeof(uint64_t) + size;
+    }
+    ThreadPool pool{std::max(1u, std::min(threads, static_cast<unsigned>(chunks.size())))};
+    std::vector<std::pair<uint64_t, Item>> cells(numElements);
+    std::vector<std::exception_ptr> failures(chunks.size());
+    for(size_t chunk = 0; chunk < chunks.size(); chunk++) {
+        pool.submit([&, chunk] {
+            try {
+                const char* at = chunks[chunk];
+                for(size_t i = chunk * CHUNK; i < std::min(numElements, (chunk + 1) * CHUNK); i++) {
+                    std::memcpy(&cells[i].first, at, sizeof(uint64_t));
+                    at += sizeof(uint64_t);
+                    cells[i].second = Item{at, reader.end};
+                }
+            } catch(...) {
+                failures[chunk] = std::current_exception();
+            }
+        });
+    }
+    pool.wait();
+    for(const std::exception_ptr& failure : failures) {
+        if(failure) std::rethrow_exception(failure);
+    }
+    std::map<std::wstring, std::shared_ptr<const SubCircuit>> subCircuits{};
+    size_t numSubCircuits = reader.at != reader.end ? reader.read<size_t>() : 0;
+    for (size_t i = 0; i < numSubCircuits; i++) {
+        auto subCircuit = std::make_shared<SubCircuit>();
+        subCircuit->name = reader.readString();
+        subCircuit->block.width = reader.read<uint32_t>();
+        subCircuit->block.height = reader.read<uint32_t>();
+        auto numCells = reader.read<size_t>();
+        for (size_t j = 0; j < numCells; j++) {
+            auto key = reader.read<uint64_t>();
+            subCircuit->block.cells.emplace_back(key, Item{reader.at, reader.end});
+        }
+        subCircuits[subCircuit->name] = std::move(subCircuit);
+    }
+    GridVersion runs{};
+    if(reader.at != reader.end) {
+        std::vector<std::pair<uint32_t, GridVersion::Runs>> rows = readLines(reader);
+        std::vector<std::pair<uint32_t, GridVersion::Runs>> columns = readLines(reader);
+        try {
+            runs = GridVersion::ofRuns(std::move(rows), std::move(columns), readArr[4], readArr[5]);
+        } catch(std::invalid_argument&) {
+            throw std::runtime_error{"File invalid"};
+        }
+    }
+    Grid grid{readArr[4], readArr[5], runs.with(std::move(cells), pool)};
+    grid.subCircuits = std::move(subCircuits);
     return WindowGrid::LoadStruct{grid, static_cast<int>(readArr[0]), static_cast<int>(readArr[1]), static_cast<int>(readArr[2]), static_cast<int>(readArr[3]), (boolOptions & 1) == 1, (boolOptions & 2) == 2};
 }
 
@@ -389,24 +1345,226 @@ int WindowGrid::getDotSize() const {
 
 void WindowGrid::setDotSize(int size) {
     dotSize = size;
+    instanceBitmaps.clear();
     dirty = true;
     Refresh();
 }
 
 void WindowGrid::undo() {
+    GridVersion before = grid.gridMap;
     if(grid.undo()) {
+        gridReplaced();
         dirty = true;
-        Refresh();
+        refreshChanged(before);
     }
 }
 
 void WindowGrid::redo() {
+    GridVersion before = grid.gridMap;
     if(grid.redo()) {
+        gridReplaced();
         dirty = true;
+        refreshChanged(before);
+    }
+}
+
+void WindowGrid::refreshChanged(const GridVersion& before) {
+    wxRect changed{};
+    bool instances = false; //which draw over more than their own cell
+    before.diff(grid.gridMap, [&changed, &instances](uint64_t key, const Item* was, const Item* is) {
+        wxRect cell{static_cast<int>(static_cast<uint32_t>(key)), static_cast<int>(key >> 32), 1, 1};
+        changed = changed.IsEmpty() ? cell : changed.Union(cell);
+        instances = instances || (was && was->type == Item::ItemType::instance) || (is && is->type == Item::ItemType::instance);
+    });
+    if(instances) {
         Refresh();
+    } else if(!changed.IsEmpty()) {
+        int cellSize = 128 + 16 * zoomLevels;
+        RefreshRect(wxRect{CalcScrolledPosition(cellSize * changed.GetPosition()) - wxPoint{5, 5}, cellSize * changed.GetSize() + wxSize{10, 10}});
+    }
+}
+
+void WindowGrid::simulate() {
+    live.reset();
+    auto start = std::chrono::steady_clock::now();
+    try {
+        simulation = std::make_unique<Simulation>(grid, backend, nullptr, tolerance);
+    } catch(std::runtime_error& e) {
+        clearSimulation();
+        wxMessageDialog(this, e.what(), "Simulation failed", wxOK | wxCENTRE | wxICON_WARNING).ShowModal();
+        return;
+    }
+    refreshOverlay();
+    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    const IterativeSolver::Statistics* statistics = simulation->getStatistics();
+    if(statistics) {
+        wxLogStatus("Solved %u nodes, %u components in %.1f ms (%d iterations, residual %.2g%s)", simulation->getNetlist().nodeCount(),
+                    static_cast<unsigned>(simulation->getNetlist().elements.size()), time.count(), statistics->iterations, statistics->residual,
+                    statistics->converged ? "" : ", did not converge");
+    } else {
+        wxLogStatus("Solved %u nodes, %u components in %.1f ms", simulation->getNetlist().nodeCount(), static_cast<unsigned>(simulation->getNetlist().elements.size()), time.count());
+    }
+}
+
+void WindowGrid::toggleIterativeSolver() {
+    backend = backend == Simulation::Backend::direct ? Simulation::Backend::iterative : Simulation::Backend::direct;
+    if(live) {
+        live.reset();
+        toggleLiveSimulation();
+    } else if(simulation) {
+        simulate();
+    } else {
+        wxLogStatus(backend == Simulation::Backend::direct ? "Using direct solver" : "Using iterative solver");
     }
 }
 
+void WindowGrid::chooseTolerance() {
+    wxTextEntryDialog dialog{this, "Residual to stop at, relative to the sources:", "Iterative Solver Tolerance", wxString::Format("%g", tolerance)};
+    if(dialog.ShowModal() != wxID_OK) return;
+    double value;
+    if(!dialog.GetValue().ToCDouble(&value) || !(value > 0 && value < 1)) {
+        wxLogStatus("Tolerance must be a number between 0 and 1");
+        return;
+    }
+    tolerance = value;
+    if(backend != Simulation::Backend::iterative) {
+        wxLogStatus("Tolerance %g, used once the iterative solver is", tolerance);
+    } else if(live) {
+        live.reset();
+        toggleLiveSimulation();
+    } else if(simulation) {
+        simulate();
+    }
+}
+
+void WindowGrid::clearSimulation() {
+    if(simulation || live) {
+        simulation.reset();
+        live.reset();
+        wxLogStatus("");
+    }
+    refreshOverlay();
+}
+
+void WindowGrid::toggleLiveSimulation() {
+    if(live) {
+        clearSimulation();
+        return;
+    }
+    simulation.reset();
+    overlay.reset();
+    //Called on the solver thread, CallAfter hands the result over to the UI thread
+    live = std::make_unique<LiveSimulation>(grid, backend, tolerance, [this] {CallAfter(&WindowGrid::liveResult);});
+    wxLogStatus("Live simulation started");
+}
+
+bool WindowGrid::isLiveSimulation() const {
+    return live != nullptr;
+}
+
+void WindowGrid::liveResult() {
+    std::shared_ptr<const LiveSimulation::Snapshot> snapshot = live ? live->getSnapshot() : nullptr;
+    if(!snapshot) return;
+    if(!snapshot->error.empty()) {
+        wxLogStatus("Live simulation: %s", snapshot->error);
+    } else if(snapshot->incremental) {
+        wxLogStatus("Live simulation: updated in %.2f ms", snapshot->milliseconds);
+    } else {
+        wxLogStatus("Live simulation: solved %u nodes, %u components in %.1f ms", snapshot->nodeCount, static_cast<unsigned>(snapshot->elementCount), snapshot->milliseconds);
+    }
+    repaint();
+    updateProbe();
+}
+
+//After undo, redo or loading, results for the old grid no longer apply
+void WindowGrid::gridReplaced() {
+    if(live) {
+        live->reset(grid);
+    } else {
+        clearSimulation();
+    }
+}
+
+void WindowGrid::refreshOverlay() {
+    if(simulation) {
+        overlay = std::make_unique<Overlay>(simulation->getNetlist(), simulation->getSolution());
+        repaint();
+    } else if(overlay) {
+        overlay.reset();
+        repaint();
+    }
+    updateProbe();
+}
+
+//The netlist is unchanged, so the overlay's tiles are kept and only the values that moved are written. A result is
+//drawn a little past its cell, the current labels by up to a cell.
+void WindowGrid::updateOverlay() {
+    if(!overlay) {
+        refreshOverlay();
+        return;
+    }
+    std::vector<uint64_t> changed{};
+    if(!overlay->update(simulation->getNetlist(), simulation->getSolution(), changed)) {
+        repaint();
+    } else {
+        int cellSize = 128 + 16 * zoomLevels;
+        wxRect view{CalcUnscrolledPosition(wxPoint{0, 0}), GetClientSize()};
+        for(uint64_t key : changed) {
+            wxRect cell{cellSize * static_cast<int>(static_cast<uint32_t>(key)), cellSize * static_cast<int>(key >> 32), cellSize, cellSize};
+            cell.Inflate(overlay->find(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key))->kind == Overlay::Kind::current ? cellSize : 5);
+            if(!cell.Intersects(view)) continue;
+            wxRect shown{CalcScrolledPosition(cell.GetPosition()), cell.GetSize()};
+            wxScrolledCanvas::Refresh(false, &shown); //the cells under the results are unchanged in the backing store
+        }
+    }
+    updateProbe();
+}
+
+void WindowGrid::updateProbe() {
+    std::shared_ptr<const LiveSimulation::Snapshot> snapshot = live ? live->getSnapshot() : nullptr;
+    const Overlay* results = snapshot ? snapshot->overlay.get() : overlay.get();
+    const Overlay::Cell* cell = results && currentCell != wxPoint{-1, -1} ? results->find(currentCell.y, currentCell.x) : nullptr;
+    if(cell == nullptr) {
+        UnsetToolTip();
+    } else if(cell->kind == Overlay::Kind::voltage) {
+        const std::wstring& name = results->getNodeName(cell->index);
+        wxString node = name.empty() ? wxString::Format("Node %u", cell->index) : wxString{name};
+        SetToolTip(wxString::Format("%s: %.9g V", node, cell->value));
+    } else {
+        SetToolTip(wxString::Format("Current: %.9g A", cell->value));
+    }
+}
+
+//Keeps a displayed solution in step with an edit: value and switch changes are solved incrementally, anything that
+//rewires the circuit drops the solution, and so does an edit that cannot be solved, saying why in the status bar
+//rather than with a dialog on every edit
+void WindowGrid::cellChanged(wxPoint cell, const Item& item) {
+    if(live) {
+        live->edit(cell.y, cell.x, item);
+        return;
+    }
+    if(!simulation) return;
+    auto start = std::chrono::steady_clock::now();
+    try {
+        if(simulation->update(cell.y, cell.x, item)) {
+            std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+            const IterativeSolver::Statistics* statistics = simulation->getStatistics();
+            if(statistics) {
+                wxLogStatus("Updated solution in %.2f ms (%d iterations, residual %.2g)", time.count(), statistics->iterations, statistics->residual);
+            } else {
+                wxLogStatus("Updated solution in %.2f ms (%u pending updates)", time.count(), static_cast<unsigned>(simulation->getUpdateCount()));
+            }
+            updateOverlay();
+            return;
+        }
+    } catch(std::runtime_error& e) {
+        clearSimulation();
+        wxLogStatus("Simulation failed: %s", e.what());
+        return;
+    }
+    clearSimulation();
+}
+
 void WindowGrid::toggleRotatedText() {
     rotatedText = !rotatedText;
     dirty = true;
@@ -419,6 +1577,18 @@ void WindowGrid::toggleShadedBackground() {
     refreshAll();
 }
 
+void WindowGrid::toggleSoftwareRendering() {
+    renderer = renderer == Renderer::software ? Renderer::batched : Renderer::software;
+    if(renderer != Renderer::software) {
+        //Let go of the frame buffer and sprites, they are remade when switched back
+        compositor = Compositor{};
+        glyphSprites.clear();
+        spriteCellSize = 0;
+        frame = wxBitmap{};
+    }
+    Refresh();
+}
+
 WindowGrid::LoadStruct::LoadStruct(Grid grid, int zoom, int xScroll, int yScroll, int dotSize, bool rotatedText, bool shadedBackground) : grid{std::move(grid)}, zoom{zoom}, xScroll{xScroll}, yScroll{yScroll}, dotSize{dotSize}, rotatedText{rotatedText}, shadedBackground{shadedBackground} {}
 
 namespace {
@@ -430,7 +1600,7 @@ namespace {
             ss << currentItem.value;
             valueStr = ss.str();
         } else {
-            valueStr = currentItem.extraData;
+            valueStr = currentItem.extraData.str();
         }
         wxTextEntryDialog dialog{nullptr, "Value:", "Set Value", valueStr};
         if (dialog.ShowModal() == wxID_OK) {
@@ -460,6 +1630,55 @@ namespace {
         }
         return shape;
     }
+
+    Reader readRest(std::ifstream& ifstream) {
+        std::streampos start = ifstream.tellg();
+        ifstream.seekg(0, std::ios_base::end);
+        std::streamoff size = ifstream.tellg() - start;
+        ifstream.seekg(start);
+        if(!ifstream || size < 0) {
+            throw std::runtime_error{"File invalid"};
+        }
+        Reader reader{std::vector<char>(static_cast<size_t>(size)), nullptr, nullptr};
+        ifstream.read(reader.data.data(), size);
+        if(ifstream.gcount() != size) {
+            throw std::runtime_error{"File invalid"};
+        }
+        reader.at = reader.data.data();
+        reader.end = reader.at + reader.data.size();
+        return reader;
+    }
+
+    std::wstring Reader::readString() {
+        auto size = read<size_t>();
+        if(size > static_cast<size_t>(end - at) / sizeof(wchar_t)) {
+            throw std::runtime_error{"File invalid"};
+        }
+        std::wstring text(size, 0); //using () to avoid initializer-list constructor
+        std::memcpy(text.data(), at, size * sizeof(wchar_t));
+        at += size * sizeof(wchar_t);
+        return text;
+    }
+
+    //Lines of runs as save wrote them, one way
+    std::vector<std::pair<uint32_t, GridVersion::Runs>> readLines(Reader& reader) {
+        std::vector<std::pair<uint32_t, GridVersion::Runs>> lines{};
+        auto numLines = reader.read<size_t>();
+        for(size_t i = 0; i < numLines; i++) {
+            auto at = reader.read<uint32_t>();
+            auto numRuns = reader.read<size_t>();
+            if(numRuns > static_cast<size_t>(reader.end - reader.at) / (2 * sizeof(uint32_t))) {
+                throw std::runtime_error{"File invalid"};
+            }
+            GridVersion::Runs runs(numRuns);
+            for(GridVersion::Run& run : runs) {
+                run.first = reader.read<uint32_t>();
+                run.second = reader.read<uint32_t>();
+            }
+            lines.emplace_back(at, std::move(runs));
+        }
+        return lines;
+    }
     int flip(int direction) {
         switch(direction) {
             case Item::UP: return Item::DOWN;
@@ -487,4 +1706,11 @@ namespace {
             default: throw std::invalid_argument("Bad direction");
         }
     }
+    //Blue for the lowest voltage through green to red for the highest
+    wxColour voltageColour(double fraction) {
+        if(fraction < 0.5) {
+            return wxColour{0, static_cast<unsigned char>(510 * fraction), static_cast<unsigned char>(255 - 510 * fraction)};
+        }
+        return wxColour{static_cast<unsigned char>(510 * (fraction - 0.5)), static_cast<unsigned char>(255 - 510 * (fraction - 0.5)), 0};
+    }
 }
\ No newline at end of file
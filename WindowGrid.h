@@ -1,6 +1,15 @@
 #pragma once
 #include <wx/wx.h>
+#include <memory>
+#include <map>
+#include <unordered_map>
+#include <thread>
 #include "Grid.h"
+#include "Simulation.h"
+#include "Overlay.h"
+#include "LiveSimulation.h"
+#include "Compositor.h"
+#include "Resources.h"
 
 class WindowGrid : public wxScrolledCanvas {
 public:
@@ -15,23 +24,112 @@ public:
     Item::ItemType selectedTool{Item::ItemType::wire};
     int zoomLevels = 0;
     bool dirty = false;
+    bool readOnly = false; //mouse edits are ignored, for the other side of a comparison
+    uint64_t framesDrawn = 0; //OnDraw calls, so a replay can tell which events caused a paint
+    enum class Renderer {
+        per_cell, //Item::draw for each cell in turn
+        batched, //the same wxDC calls grouped by kind, see batchCells
+        software //cells composited in memory and shown with one blit, labels still by wxDC
+    };
+    Renderer renderer{Renderer::batched};
     void save(std::ofstream& ofstream);
+    //Writes a schematic file without a window, for the command line tools
+    static void save(std::ofstream& ofstream, const Grid& grid, int zoom, int xScroll, int yScroll, int dotSize, bool rotatedText, bool shadedBackground);
     void reload(const LoadStruct& load);
-    static LoadStruct load(std::ifstream& ifstream);
+    //Reads the file on up to threads threads. Throws std::runtime_error if it is not a schematic, or cannot be held.
+    static LoadStruct load(std::ifstream& ifstream, unsigned threads = std::thread::hardware_concurrency());
     int getDotSize() const;
     void setDotSize(int size);
     void toggleRotatedText();
     void toggleShadedBackground();
+    //Switches between the batched and software renderers
+    void toggleSoftwareRendering();
     void undo();
     void redo();
+    void simulate();
+    void clearSimulation();
+    void toggleIterativeSolver();
+    //Asks for the iterative solver's tolerance and solves again with it if that solver is in use
+    void chooseTolerance();
+    void toggleLiveSimulation();
+    bool isLiveSimulation() const;
+    void copySelection();
+    void cutSelection();
+    void deleteSelection();
+    //Pastes with its top left corner at the cell under the mouse
+    void paste();
+    void clearSelection();
+    void replicateSelection();
+    const Grid& getGrid() const;
+    //Scrolls the cell to the middle of the window and selects it
+    void showCell(uint32_t row, uint32_t col);
+    //Saves the selection as a named sub-circuit and replaces it with an instance of it
+    void makeSubCircuit();
+    void placeSubCircuit();
+    //Writes the whole grid as a PNG, or SVG if svg is set, at cellSize pixels per cell. Throws std::runtime_error on failure.
+    void exportImage(std::ostream& ostream, bool svg, int cellSize) const;
+    //Times frames and shows them over the grid, see Profiler.h
+    void toggleProfiling();
+    memory::Report memoryUsage() const;
+    //Zooms and scrolls to viewStart, in pixels
+    void setView(int zoom, wxPoint viewStart);
+    //Marks the area under rect, or the whole window, to be drawn again into the backing store as well as on screen
+    void Refresh(bool eraseBackground = true, const wxRect* rect = nullptr) override;
+    //Shows this grid beside other's, outlining the cells added, removed and changed going from the older of the two to
+    //the newer, and keeps the two at the same zoom and scroll position. Null other stops comparing.
+    void compare(WindowGrid* other, bool older);
 private:
+    //load, throwing whatever reading threw on any thread
+    static LoadStruct readFile(std::ifstream& ifstream, unsigned threads);
     void OnDraw(wxDC& dc) override;
+    void ScrollWindow(int dx, int dy, const wxRect* rect = nullptr) override;
+    //Paints the window again from the backing store, for what is drawn over the cells: selection, results and profile
+    void repaint();
+    void updateBacking(int cellSize);
+    void drawArea(wxDC& dc, wxPoint origin, int cellSize, const wxRect& area);
+    void onScrollLine(wxScrollWinEvent& event);
     void onScroll(wxMouseEvent& event);
     void onMotion(wxMouseEvent& event);
     void onLeftDown(wxMouseEvent& event);
     void onRightDown(wxMouseEvent& event);
+    void onLeftUp(wxMouseEvent& event);
+    void finishDrag();
+    void moveSelection(wxPoint offset);
+    void blockChanged();
     void refreshAll(int xPos = -1, int yPos = -1);
     void placePartial(wxPoint cell, const Item& item);
+    void cellChanged(wxPoint cell, const Item& item);
+    void refreshOverlay();
+    //After an incremental solve, draws again only the cells in view whose results changed
+    void updateOverlay();
+    //Cells in view sorted by what draws them, in logical coordinates
+    struct CellBatch {
+        std::vector<wxPoint> dots; //centres of empty cells
+        std::vector<std::pair<const wxBitmap*, wxPoint>> glyphs; //top left corners, in order of bitmap
+        std::vector<wxPoint> lines; //pairs of ends, each line horizontal or vertical
+        std::vector<wxPoint> junctions;
+        std::vector<std::pair<const Item*, wxPoint>> labels;
+    };
+    CellBatch batchCells(int cellSize, int rowBegin, int rowEnd, int colBegin, int colEnd);
+    void drawCells(wxDC& dc, wxPoint origin, int cellSize, const CellBatch& batch);
+    void composeCells(wxDC& dc, wxPoint origin, int cellSize, const CellBatch& batch, const wxRect& area);
+    void drawLabels(wxDC& dc, wxPoint origin, int cellSize, const CellBatch& batch);
+    void drawInstances(wxDC& dc, wxPoint origin, int cellSize, const wxRect& visible);
+    const wxBitmap* instanceBitmap(const Item& instance, wxSize size, int cellSize);
+    //Instances whose bounds overlap visible, each once, from instanceTiles
+    std::vector<std::pair<uint64_t, wxRect>> instancesIn(const wxRect& visible);
+    const std::vector<std::pair<uint64_t, Item>>& instanceCells(const Item& instance);
+    void clearInstanceCaches();
+    void drawOverlay(wxDC& dc, const Overlay& results, wxPoint origin, int cellSize, int rowBegin, int rowEnd, int colBegin, int colEnd);
+    void drawProfile(wxDC& dc, int64_t frameTime, const int64_t* counts);
+    void drawDifferences(wxDC& dc, wxPoint origin, int cellSize, int rowBegin, int rowEnd, int colBegin, int colEnd);
+    void updateDifferences();
+    void viewMoved();
+    //Draws again only where the grid differs from before, after undo or redo
+    void refreshChanged(const GridVersion& before);
+    void updateProbe();
+    void gridReplaced();
+    void liveResult();
     Grid grid;
     wxFont font;
     wxPoint lastCell{-1,-1};
@@ -41,11 +139,50 @@ private:
     wxMenu wireMenu{};
     wxMenu fourWayMenu{};
     wxMenu switchMenu{};
-    wxBitmap resistorBitmaps[2];
-    wxBitmap voltSourceBitmaps[8];
-    wxBitmap ampSourceBitmaps[8];
-    wxBitmap capacitorBitmaps[2];
-    wxBitmap switchBitmaps[4];
+    wxMenu instanceMenu{};
+    resources::Glyphs glyphs{};
+    std::map<std::pair<std::wstring, int>, wxBitmap> instanceBitmaps; //by sub-circuit and turns, for the current zoom
+    //Cells of sub-circuits too big for instanceBitmaps, relative to the instance and sorted by key, by sub-circuit and turns
+    std::map<std::pair<std::wstring, int>, std::vector<std::pair<uint64_t, Item>>> instanceCellCache;
+    //Instance keys and bounds, and for each INSTANCE_TILE square of cells the instances overlapping it, keyed like cells
+    std::vector<std::pair<uint64_t, wxRect>> instanceBounds;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> instanceTiles;
+    uint64_t instanceTilesStamp{~0ull}; //GridIndex::getInstanceStamp when instanceTiles was built, ~0 to rebuild
+    std::unique_ptr<Simulation> simulation{};
+    Simulation::Backend backend{Simulation::Backend::direct};
+    double tolerance{IterativeSolver::Options{}.tolerance}; //of the iterative backend
+    std::unique_ptr<Overlay> overlay{};
+    std::unique_ptr<LiveSimulation> live{};
+    wxRect selection{}; //in cells, empty when nothing is selected
+    bool selecting{false};
+    bool moving{false};
+    wxPoint dragStart{-1, -1};
+    Block clipboard{};
+    double averageFrameTime{0}; //microseconds, while profiling
+    //For the software renderer
+    Compositor compositor{};
+    std::unordered_map<const wxBitmap*, Compositor::Sprite> glyphSprites{}; //of glyphs, at spriteCellSize
+    Compositor::Sprite dotSprite{};
+    Compositor::Sprite junctionSprite{};
+    int spriteCellSize{0};
+    int spriteDotSize{0};
+    wxBitmap frame{}; //what the compositor drew last, as shown
+    //Cells and instances as last drawn for the whole window, so a paint only draws what has changed or come into view
+    wxBitmap backing{};
+    wxBitmap backingSpare{}; //what backing is shifted into when the window scrolls, then swapped with it
+    wxRect backingArea{}; //logical area backing holds
+    wxRegion stale{}; //logical area to draw again at the next paint
+    bool backingValid{false};
+    int backingCellSize{0};
+    //When comparing
+    enum class Difference : uint8_t {
+        added, removed, changed
+    };
+    WindowGrid* counterpart{nullptr};
+    bool older{false}; //this grid is the one changed from
+    std::vector<std::pair<uint64_t, Difference>> differences{}; //by key
+    std::pair<uint64_t, uint64_t> differencesOf{}; //digests of this grid and the counterpart's that differences are for
+    bool following{false}; //moving the counterpart's view to match this one
     int dotSize;
     bool rotatedText;
     bool shadedBackground;
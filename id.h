@@ -5,12 +5,7 @@
 namespace id {
     enum id {
         tool_wire = wxID_HIGHEST + 1,
-        tool_resistor,
-        tool_volt_source,
-        tool_amp_source,
         tool_bin,
-        tool_capacitor,
-        tool_switch,
         rotate,
         rotate_cw,
         rotate_ccw,
@@ -29,6 +24,25 @@ namespace id {
         view_dot_size,
         view_rotated_text,
         view_shaded_background,
-        dot_size_slider
+        view_software_rendering,
+        view_profiling,
+        view_save_trace,
+        view_memory,
+        view_record_input,
+        simulate_run,
+        simulate_clear,
+        simulate_iterative,
+        simulate_tolerance,
+        simulate_live,
+        edit_replicate,
+        edit_find,
+        edit_make_block,
+        edit_place_block,
+        file_export_spice,
+        file_export_image,
+        file_compare,
+        file_close_comparison,
+        dot_size_slider,
+        tool_part //then one more for each of components::all(), so last
     };
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "Overlay.h"
+#include "Simulation.h"
+#include <iostream>
+
+//A value edit solved incrementally must leave the overlay as one built from scratch would be, and report every cell
+//whose result moved. The circuit is a source driving two resistors in series around a loop of wires.
+int main() {
+    Grid grid{3, 3};
+    grid.apply({
+        {0, Item{Item::ItemType::wire, Item::RIGHT | Item::DOWN, 0}},
+        {1, Item{Item::ItemType::resistor, 0, 1000}},
+        {2, Item{Item::ItemType::wire, Item::LEFT | Item::DOWN, 0}},
+        {1ull << 32, Item{Item::ItemType::volt_source, Item::UP, 5}},
+        {(1ull << 32) | 2, Item{Item::ItemType::resistor, Item::VERTICAL, 1000}},
+        {2ull << 32, Item{Item::ItemType::wire, Item::UP | Item::RIGHT, 0}},
+        {(2ull << 32) | 1, Item{Item::ItemType::wire, Item::LEFT | Item::RIGHT, 0}},
+        {(2ull << 32) | 2, Item{Item::ItemType::wire, Item::LEFT | Item::UP, 0}},
+    });
+    Simulation simulation{grid};
+    Overlay overlay{simulation.getNetlist(), simulation.getSolution()};
+    Item edited{Item::ItemType::resistor, 0, 3000};
+    grid.set(0, 1, edited);
+    if(!simulation.update(0, 1, edited)) {
+        std::cerr << "A value edit was taken for a change of wiring\n";
+        return 1;
+    }
+    std::vector<uint64_t> changed{};
+    overlay.update(simulation.getNetlist(), simulation.getSolution(), changed);
+    Overlay fresh{simulation.getNetlist(), simulation.getSolution()};
+    for(uint32_t row = 0; row < 3; row ++) {
+        for(uint32_t col = 0; col < 3; col ++) {
+            const Overlay::Cell* a = overlay.find(row, col);
+            const Overlay::Cell* b = fresh.find(row, col);
+            if((a == nullptr) != (b == nullptr) || (a && a->value != b->value)) {
+                std::cerr << "Cell " << row << "," << col << " differs from a fresh overlay\n";
+                return 1;
+            }
+        }
+    }
+    //The current through both resistors and the voltage between them moved
+    if(changed.size() < 3 || overlay.getMinVoltage() != fresh.getMinVoltage() || overlay.getMaxVoltage() != fresh.getMaxVoltage()) {
+        std::cerr << "Expected the changed cells and range of a fresh overlay, " << changed.size() << " cells changed\n";
+        return 1;
+    }
+    return 0;
+}
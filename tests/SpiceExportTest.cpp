@@ -0,0 +1,42 @@
+#include "SpiceExport.h"
+#include <sstream>
+#include <iostream>
+#include <set>
+#include <algorithm>
+
+//Labels that clean up to the same SPICE name, or differ only in case, must still be different nodes in the deck.
+//Each row is a resistor between two labelled wires, the last one grounded so no other net is taken for ground.
+int main() {
+    const std::wstring names[][2] = {{L"A B", L"A_B"}, {L"A.B", L"a_b"}, {L"GND", L"gnd"}};
+    Grid grid{3, 3};
+    std::vector<std::pair<uint64_t, Item>> cells{};
+    for(uint64_t row = 0; row < 3; row ++) {
+        cells.emplace_back(row << 32, Item{Item::ItemType::wire, Item::RIGHT, 0, names[row][0]});
+        cells.emplace_back((row << 32) | 1, Item{Item::ItemType::resistor, 0, 1000});
+        cells.emplace_back((row << 32) | 2, Item{Item::ItemType::wire, Item::LEFT, 0, names[row][1]});
+    }
+    grid.apply(cells);
+    std::ostringstream deck{};
+    spice::write(deck, Netlist{grid}, "labels");
+
+    std::istringstream lines{deck.str()};
+    std::set<std::string> nodes{};
+    int resistors = 0;
+    for(std::string line; std::getline(lines, line);) {
+        if(line.empty() || line[0] != 'R') continue;
+        std::istringstream fields{line};
+        std::string name, first, second;
+        fields >> name >> first >> second;
+        for(std::string node : {first, second}) {
+            std::transform(node.begin(), node.end(), node.begin(), [](char c) {return static_cast<char>(std::tolower(c));});
+            nodes.insert(node);
+        }
+        resistors ++;
+    }
+    //Four labelled nets and ground
+    if(resistors != 3 || nodes.size() != 5 || !nodes.contains("0")) {
+        std::cerr << "Expected 3 resistors between 4 distinct labelled nodes and ground, got:\n" << deck.str();
+        return 1;
+    }
+    return 0;
+}